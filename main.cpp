@@ -1,11 +1,24 @@
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
 
 #include "applicationTest.hpp"
+#include "headlessApplication.hpp"
 
-int main(int argc[[maybe_unused]], char* argv[[maybe_unused]][]){
+int main(int argc, char* argv[]){
 
-    Application app{};
+    if(HeadlessApplication::isRequested(argc, argv)){
+        HeadlessApplication headlessApp{};
+        exit(headlessApp.run(argc, argv));
+    }
+
+    // the gui takes the same --scene option as the headless mode
+    std::string sceneFile = Application::DEFAULT_SCENE_FILE;
+    for(int i=1; i<argc-1; i++){
+        if(strcmp(argv[i], "--scene") == 0) sceneFile = SceneDescription::resolvePath(argv[i+1]);
+    }
+    Application app{sceneFile};
 
     app.run();
 
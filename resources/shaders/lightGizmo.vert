@@ -0,0 +1,21 @@
+#version 450
+
+// unit sphere
+layout(location = 0) in vec3 inPosition;
+
+// one instance per light, w holds the scale
+layout(location = 1) in vec4 inPositionScale;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(push_constant) uniform Push {
+    mat4 proj;
+    mat4 view;
+} push;
+
+void main(){
+    vec3 worldPosition = inPositionScale.xyz + inPositionScale.w * inPosition;
+    gl_Position = push.proj * push.view * vec4(worldPosition, 1.0);
+    fragColor = inColor.rgb;
+}
\ No newline at end of file
@@ -1,7 +1,24 @@
 #include "applicationTest.hpp"
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
+#include <future>
 #include "keyboardInput.hpp"
+#include "startupTimeline.hpp"
+
+const std::string Application::DEFAULT_SCENE_FILE = "resources/scenes/dragon.scene";
+
+static be::Vector3 toVector3(const Vec3& v){
+    return be::Vector3(v.x, v.y, v.z);
+}
+
+static Vec3 toVec3(const be::Vector3& v){
+    return Vec3(v.x(), v.y(), v.z());
+}
+
+
 
 /********************************************************************/
 /************************** INIT FUNCTIONS **************************/
@@ -49,178 +66,79 @@ void Application::initGameObjectsRayTracingViewRectangle(){
     );
     _GameObjects.push_back(object);
 }
-void Application::initGameObjectsRoom(){
-    // create the room by hand for faster raytracing
-    be::ModelPtr floorModel = be::ModelPtr(
-        new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveRectangle(
-            1.f, 1.f, {0.f, 1.f, 0.f, 1.f}
-        ))
-    );
-    be::TransformPtr floorTransform = be::TransformPtr(new be::Transform());
-    floorTransform->_Scale = {15.f, 15.f, 1.f};
-    floorTransform->_Rotation = {be::radians(-90.f), 0.f, 0.f};
-    floorTransform->_Position = {0.f, -7.5f, 0.f};
-    be::GameObject object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = floorModel},
-        {._Transform = floorTransform}
-    );
-    _GameObjects.push_back(object);
-
-    be::ModelPtr roofModel = be::ModelPtr(
-        new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveRectangle(
-            1.f, 1.f, {1.f, 1.f, 1.f, 1.f}
-        ))
-    );
-    be::TransformPtr roofTransform = be::TransformPtr(new be::Transform());
-    roofTransform->_Scale = {15.f, 15.f, 1.f};
-    roofTransform->_Rotation = {be::radians(90.f), 0.f, 0.f};
-    roofTransform->_Position = {0.f, 7.5f, 0.f};
-    object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = roofModel},
-        {._Transform = roofTransform}
-    );
-    _GameObjects.push_back(object);
-
-    be::ModelPtr frontWallModel = be::ModelPtr(
-        new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveRectangle(
-            1.f, 1.f, {0.01f, 0.01f, 0.01f, 1.f}
-        ))
-    );
-    be::TransformPtr frontWallTransform = be::TransformPtr(new be::Transform());
-    frontWallTransform->_Scale = {15.f, 15.f, 1.f};
-    frontWallTransform->_Rotation = {0.f, be::radians(180.f), 0.f};
-    frontWallTransform->_Position = {0.f, 0.f, 7.5f};
-    object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = frontWallModel},
-        {._Transform = frontWallTransform}
-    );
-    _GameObjects.push_back(object);
-
-    be::ModelPtr backWallModel = be::ModelPtr(
-        new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveRectangle(
-            1.f, 1.f, {0.01f, 0.01f, 0.01f, 1.f}
-        ))
-    );
-    be::TransformPtr backWallTransform = be::TransformPtr(new be::Transform());
-    backWallTransform->_Scale = {15.f, 15.f, 1.f};
-    backWallTransform->_Rotation = {0.f, 0.f, 0.f};
-    backWallTransform->_Position = {0.f, 0.f, -7.5f};
-    object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = backWallModel},
-        {._Transform = backWallTransform}
-    );
-    _GameObjects.push_back(object);
-
-    be::ModelPtr leftWallModel = be::ModelPtr(
-        new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveRectangle(
-            1.f, 1.f, {1.f, 0.f, 0.f, 1.f}
-        ))
-    );
-    be::TransformPtr leftWallTransform = be::TransformPtr(new be::Transform());
-    leftWallTransform->_Scale = {15.f, 15.f, 1.f};
-    leftWallTransform->_Rotation = {0.f, be::radians(90.f), 0.f};
-    leftWallTransform->_Position = {-7.5f, 0.f, 0.f};
-    object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = leftWallModel},
-        {._Transform = leftWallTransform}
-    );
-    _GameObjects.push_back(object);
-
-    be::ModelPtr rightWallModel = be::ModelPtr(
-        new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveRectangle(
-            1.f, 1.f, {0.f, 0.f, 1.f, 1.f}
-        ))
-    );
-    be::TransformPtr rightWallTransform = be::TransformPtr(new be::Transform());
-    rightWallTransform->_Scale = {15.f, 15.f, 1.f};
-    rightWallTransform->_Rotation = {0.f, be::radians(-90.f), 0.f};
-    rightWallTransform->_Position = {7.5f, 0.f, 0.f};
-    object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = rightWallModel},
-        {._Transform = rightWallTransform}
+void Application::initSceneDescription(){
+    auto start = std::chrono::high_resolution_clock::now();
+    if(!SceneDescription::load(_SceneFile, _SceneDescription)){
+        be::ErrorHandler::handle(__FILE__, __LINE__, 
+            be::ErrorCode::IO_ERROR, 
+            "Failed to load the scene " + _SceneFile + "!\n"
+        );
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    fprintf(stdout, "Scene %s parsed in %fs\n", 
+        _SceneFile.c_str(), 
+        std::chrono::duration<float, std::chrono::seconds::period>(end - start).count()
     );
-    _GameObjects.push_back(object);
 }
-void Application::initDragonScene(){
-    // load dragon model
-    be::ModelPtr dragonModel = be::ModelPtr(
-        new be::Model(_VulkanApp, "resources/models/dragon.off")
-    );
-
+void Application::initGameObjectsEntities(){
+    uint32_t materialId = 1;
+    for(uint32_t meshId=0; meshId<_SceneDescription._Meshes.size(); meshId++){
+        const auto& mesh = _SceneDescription._Meshes[meshId];
+        be::ModelPtr model = nullptr;
+        switch(mesh._Type){
+            case MESH_RECTANGLE:
+                model = be::ModelPtr(
+                    new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveRectangle(
+                        mesh._Width, mesh._Height, be::Vector4(toVector3(mesh._Color), 1.f)
+                    ))
+                );
+                break;
+            case MESH_SPHERE:
+                model = be::ModelPtr(
+                    new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveSphere(
+                        mesh._NbSegments, toVector3(mesh._Color)
+                    ))
+                );
+                break;
+            case MESH_MODEL:
+                model = be::ModelPtr(new be::Model(_VulkanApp, mesh._Path));
+                break;
+        }
 
-    be::TransformPtr dragonTransform = be::TransformPtr(
-        new be::Transform()
-    );
-    dragonTransform->_Scale = {10.f, 10.f, 10.f};
-    be::MaterialPtr sphereMaterial = be::MaterialPtr(
-        new be::Material(
-            {
-                ._Metallic = 0.788f,
-                ._Subsurface = 0.603f,
-                ._Specular = 0.301f,
-                ._Roughness = 0.180f,
-                ._SpecularTint = 0.042f,
-                ._Anisotropic = 0.199f,
-                ._Sheen = 0.564f,
-                ._SheenTint = 0.795f,
-                ._Clearcoat = 0.269f,
-                ._ClearcoatGloss = 0.737f
+        be::TransformPtr transform = be::TransformPtr(new be::Transform());
+        transform->_Scale = toVector3(mesh._Transform._Scale);
+        transform->_Rotation = toVector3(mesh._Transform._Rotation);
+        transform->_Position = toVector3(mesh._Transform._Position);
+
+        be::GameObject object;
+        bool isFirstMaterial = mesh._Material._IsDefined && !_EditedMaterialObject.has_value();
+        if(mesh._Material._IsDefined){
+            // unset parameters keep their default value
+            be::MaterialPtr material = be::MaterialPtr(new be::Material());
+            for(uint32_t i=0; i<MaterialDescription::NB_PARAMETERS; i++){
+                if(mesh._Material._IsSet[i]){
+                    material->get(i) = mesh._Material._Parameters[i];
+                }
             }
-        )
-    );
-
-    be::GameObject object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = dragonModel}, 
-        {._Transform = dragonTransform},
-        {._Material = sphereMaterial, ._MaterialId = 1}
-    );
-    _GameObjects.push_back(object);
-}
-void Application::initSpheresScene(){
-    // load sphere model
-    be::ModelPtr sphereModel = be::ModelPtr(
-        new be::Model(_VulkanApp, be::VertexDataBuilder::primitiveSphere(16, 
-            {54.f/255.f, 112.f/255.f, 131.f/255.f})
-        )
-    );
-
-
-    be::TransformPtr sphereTransform = be::TransformPtr(
-        new be::Transform()
-    );
-    sphereTransform->_Scale = {2.f, 2.f, 2.f};
-    be::MaterialPtr sphereMaterial = be::MaterialPtr(new be::Material());
-
-    be::GameObject object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = sphereModel}, 
-        {._Transform = sphereTransform},
-        {._Material = sphereMaterial, ._MaterialId = 1}
-    );
-    _GameObjects.push_back(object);
-    
-    be::TransformPtr sphereTransform2 = be::TransformPtr(
-        new be::Transform()
-    );
-    sphereTransform2->_Scale = {2.f, 2.f, 2.f};
-    sphereTransform2->_Position = {3.f, 3.f, 0.f};
-    object = be::RenderSystem::createRenderableObject(
-        {._RenderSubSystem = _BRDFRenderSubSystem},
-        {._Model = sphereModel}, 
-        {._Transform = sphereTransform2}
-    );
-    _GameObjects.push_back(object);
-}
-void Application::initGameObjectsEntities(){
-    initDragonScene();
-    // initSpheresScene();
+            object = be::RenderSystem::createRenderableObject(
+                {._RenderSubSystem = _BRDFRenderSubSystem},
+                {._Model = model}, 
+                {._Transform = transform},
+                {._Material = material, ._MaterialId = materialId++}
+            );
+        } else {
+            object = be::RenderSystem::createRenderableObject(
+                {._RenderSubSystem = _BRDFRenderSubSystem},
+                {._Model = model}, 
+                {._Transform = transform}
+            );
+        }
+        _GameObjects.push_back(object);
+        if(isFirstMaterial){
+            _EditedMaterialObject = object;
+            _EditedMaterialMesh = meshId;
+        }
+    }
 }
 void Application::initGameObjects(){
     if(_VulkanApp == nullptr){
@@ -232,7 +150,6 @@ void Application::initGameObjects(){
     initGameObjectsFrame();
     initGameObjectsRayTracingViewRectangle();
     initGameObjectsEntities();
-    initGameObjectsRoom();
 
     // _Scene->addGameObject(0);
     // add all objects except the frame and the raytracing view rectangle
@@ -240,184 +157,63 @@ void Application::initGameObjects(){
         _Scene->addGameObject(_GameObjects[i]);
     }
 }
-void Application::initLightsBasic(){
-    // build the lights
-    _Scene->addGamePointLight(
-        {0.f, 7.f, -1.f}, 
-        {1.f, 1.f, 1.f},
-        1.f 
-    );
-    _Scene->addGamePointLight(
-        {0.f, 7.f, 1.f}, 
-        {1.f, 1.f, 1.f},
-        1.f 
-    );
-    _Scene->addGamePointLight(
-        {7.f, 0.f, -1.f}, 
-        {1.f, 1.f, 1.f},
-        1.f 
-    );
-    _Scene->addGamePointLight(
-        {7.f, 0.f, 1.f}, 
-        {1.f, 1.f, 1.f},
-        1.f 
-    );
-
-    // make the lights visible
+void Application::initLightsGizmos(){
+    // make the lights visible, a single instanced draw for all of them
+    std::vector<LightGizmoInstance> gizmos{};
     for(auto light: _Scene->getPointLights()){
-        be::ModelPtr lightModel = be::ModelPtr(
-            new be::Model(_VulkanApp, 
-                be::VertexDataBuilder::primitiveSphere(16, 
-                    be::Vector4(light->getColor(), 1.f)
-                )
-            )
-        );
-        be::TransformPtr lightTransform = be::TransformPtr(
-            new be::Transform()
-        );
-        lightTransform->_Scale = {0.1f, 0.1f, 0.1f};
-        lightTransform->_Position = light->_Position.xyz();
-        be::GameObject object = be::RenderSystem::createRenderableObject(
-            {._RenderSubSystem = _RenderSubSystem},
-            {._Model = lightModel}, 
-            {._Transform = lightTransform},
-            {},
-            {._IsLight = true}
+        gizmos.push_back({
+            ._PositionScale = be::Vector4(light->_Position.xyz(), 0.1f),
+            ._Color = be::Vector4(light->getColor(), 1.f)
+        });
+    }
+    _RenderSubSystem->setLightGizmos(gizmos);
+}
+void Application::initLightsCubes(){
+    // cubes carry their own geometry, no gizmos needed
+    for(const auto& cube : _SceneDescription._LightCubes){
+        auto object = _Scene->addCubeOfLight(
+            _RenderSubSystem, 
+            toVector3(cube._Center),
+            toVector3(cube._Scale), 
+            toVector3(cube._Color),
+            cube._Intensity,
+            toVector3(cube._Rotation),
+            toVector3(cube._Steps)
         );
         _GameObjects.push_back(object);
-        _Scene->addGameObject(object);
     }
 }
-void Application::initLightsCircle(){
-    // light in a circle
-    float r = 7.f;
-    int nbLights = 36;
-    float step = be::radians(360.f / nbLights);
-    float curAngle = 0.f;
-    for(int i=0; i<nbLights; i++){
-        be::Vector3 pos = {r*std::cos(curAngle), -3.f, r*std::sin(curAngle)};
-        be::Vector3 col = be::Vector3::random(0.f, 1.f);
-        // be::Vector3 col = {1.f, 1.f, 1.f};
-        float intensity = 5.f;
+void Application::initLights(){
+    for(const auto& light : _SceneDescription._PointLights){
         _Scene->addGamePointLight(
-            pos,
-            col,
-            intensity
+            toVector3(light._Position), 
+            toVector3(light._Color),
+            light._Intensity 
         );
-        curAngle += step;
     }
-
-
-
-    // make the lights visible
-    for(auto light: _Scene->getPointLights()){
-        be::ModelPtr lightModel = be::ModelPtr(
-            new be::Model(_VulkanApp, 
-                be::VertexDataBuilder::primitiveSphere(16, 
-                    be::Vector4(light->getColor(), 1.f)
-                )
-            )
+    initLightsGizmos();
+    initLightsCubes();
+    for(const auto& light : _SceneDescription._DirectionalLights){
+        _Scene->addGameDirectionalLight(
+            toVector3(light._Direction), 
+            toVector3(light._Color),
+            light._Intensity 
         );
-        be::TransformPtr lightTransform = be::TransformPtr(
-            new be::Transform()
-        );
-        lightTransform->_Scale = {0.1f, 0.1f, 0.1f};
-        lightTransform->_Position = light->_Position.xyz();
-        be::GameObject object = be::RenderSystem::createRenderableObject(
-            {._RenderSubSystem = _RenderSubSystem},
-            {._Model = lightModel}, 
-            {._Transform = lightTransform},
-            {},
-            {._IsLight = true}
-        );
-        _GameObjects.push_back(object);
-        _Scene->addGameObject(object);
     }
 }
-void Application::initLightsBoxes(){
-    float roomHalfSize = 7.5;
-
-    float lightSteps = 0.5;
-
-    // bottom right cube
-    float cube1Length = 4.f;
-    be::Vector3 cube1Center = be::Vector3(5.f, -roomHalfSize+cube1Length/2.f, -5.f);
-    be::Vector3 cube1Rotation = be::Vector3(0.f, be::radians(-15.f), 0.f);
-    be::Vector3 cube1Color = be::Vector3(1.f, 1.f, 0.5f);
-    // be::Vector3 cube1Color = be::Color::WHITE;
-    float cube1Intensity = 0.8f;
-    auto object = _Scene->addCubeOfLight(
-        _RenderSubSystem, 
-        cube1Center,
-        cube1Length, 
-        cube1Color,
-        cube1Intensity,
-        cube1Rotation,
-        lightSteps
-    );
-    _GameObjects.push_back(object);
-
-    // tiny bottom right cube
-    float cube2Length = 2.f;
-    be::Vector3 cube2Center = be::Vector3(4.f, -roomHalfSize+cube2Length/2.f, 3.f);
-    be::Vector3 cube2Rotation = be::Vector3(0.f, be::radians(45.f), 0.f);
-    be::Vector3 cube2Color = be::Vector3(73.f/255.f, 116.f/255.f, 165.f/255.f);
-    // be::Vector3 cube2Color = be::Color::WHITE;
-    float cube2Intensity = 0.2f;
-    object = _Scene->addCubeOfLight(
-        _RenderSubSystem, 
-        cube2Center,
-        cube2Length, 
-        cube2Color,
-        cube2Intensity,
-        cube2Rotation,
-        lightSteps
-    );
-    _GameObjects.push_back(object);
-
-    // bottom left cube
-    float cube3Length = 3.f;
-    be::Vector3 cube3Center = be::Vector3(-5.2f, -roomHalfSize+cube3Length/2.f, 1.5f);
-    be::Vector3 cube3Rotation = be::Vector3(0.f, be::radians(30.f), 0.f);
-    be::Vector3 cube3Color = be::Vector3(122.f/255.f, 73.f/255.f, 165.f/255.f);
-    // be::Vector3 cube3Color = be::Color::WHITE;
-    float cube3Intensity = 0.6f;
-    object = _Scene->addCubeOfLight(
-        _RenderSubSystem, 
-        cube3Center,
-        cube3Length, 
-        cube3Color,
-        cube3Intensity,
-        cube3Rotation,
-        lightSteps
-    );
-    _GameObjects.push_back(object);
-
-
-    // top light
-    be::Vector3 cube4Scale = be::Vector3(6.f, 0.3f, 6.f);
-    be::Vector3 cube4Center = be::Vector3(0.f, roomHalfSize-cube4Scale.y()/2.f, 0.f);
-    be::Vector3 cube4Color = be::Color::WHITE;
-    float cube4Intensity = 5.f;
-    object = _Scene->addCubeOfLight(
-        _RenderSubSystem, 
-        cube4Center,
-        cube4Scale, 
-        cube4Color,
-        cube4Intensity,
-        be::Vector3::zeros(),
-        be::Vector3(lightSteps, 0.1f, lightSteps)
-    );
-    _GameObjects.push_back(object);
-}
-void Application::initLights(){
-    // initLightsBasic();
-    initLightsCircle();
-    initLightsBoxes();
-}
 void Application::initCamera(){
-    _Camera = be::CameraPtr(new be::Camera(be::Vector3(0.f, 0.f, 20.f)));
-    // _Camera = be::CameraPtr(new be::Camera(be::Vector3(0.f, 0.f, 15.f)));
+    const CameraDescription& description = _SceneDescription._Camera;
+    // the engine camera is oriented by its yaw and pitch in degrees, a yaw of -90 looks toward -z
+    Vec3 front = normalize(description._At - description._Eye);
+    float yaw = std::atan2(front.z, front.x) * 180.f / CPU_PI;
+    float pitch = std::asin(std::clamp(front.y, -1.f, 1.f)) * 180.f / CPU_PI;
+    _Camera = be::CameraPtr(new be::Camera(
+        toVector3(description._Eye), 
+        toVector3(normalize(description._Up)), 
+        yaw, 
+        pitch
+    ));
+    _Camera->setFov(description._Fov);
 }
 void Application::initRenderer(){
     if(_Window == nullptr){
@@ -454,11 +250,15 @@ void Application::initRenderSubSystems(){
             "Can't create a render subsystem without a camera!\n"
         );
     }
+    _PipelineCache = PipelineCachePtr(new PipelineCache(_VulkanApp));
+    _MemoryPool = DeviceMemoryPoolPtr(new DeviceMemoryPool(_VulkanApp));
     _RenderSubSystem = FrameRenderSubSystemPtr(
                         new FrameRenderSubSystem(
                             _VulkanApp, 
                             _Renderer->getSwapChainRenderPass(),
-                            _GlobalPool
+                            _GlobalPool,
+                            _MemoryPool,
+                            _PipelineCache->getCache()
                             )
                         );
 
@@ -474,7 +274,8 @@ void Application::initRenderSubSystems(){
                         new RaytracingRenderSubSystem(
                             _VulkanApp, 
                             _Renderer->getSwapChainRenderPass(),
-                            _GlobalPoolTmp
+                            _GlobalPoolTmp,
+                            _MemoryPool
                             )
                         );
 }
@@ -497,14 +298,45 @@ void Application::initScene(){
     _Scene = be::ScenePtr(new be::Scene(_VulkanApp));
     _BRDFRenderSubSystem->setScene(_Scene);
 }
-void Application::initRaytracer(){
-    _RayTracer = be::RayTracerPtr(
-        new be::RayTracer(
-            _Scene, 
-            _Renderer->getSwapChain()->getWidth(), 
-            _Renderer->getSwapChain()->getHeight()
+void Application::initRayTracingScene(){
+    // same scene file as the rasterizer, without the light gizmos
+    _RayTracingScene = CpuScene::createFromDescription(_SceneDescription, CpuRayTracer::DEFAULT_CACHE_DIRECTORY);
+    if(_RayTracingScene == nullptr) return;
+    // the resolution is set once the swap chain exists
+    _RayTracer = CpuRayTracerPtr(
+        new CpuRayTracer(
+            _RayTracingScene, 
+            WINDOW_WIDTH, 
+            WINDOW_HEIGHT
         )
     );
+    const RayTracerDescription& settings = _SceneDescription._RayTracer;
+    _RayTracer->_SamplesPerPixels = settings._SamplesPerPixels;
+    _RayTracer->_MaxBounces = settings._MaxBounces;
+    _RayTracer->_SamplesPerBounces = settings._SamplesPerBounces;
+    _RayTracer->_ShadingFactor = settings._ShadingFactor;
+    _RayTracer->_UseLightCuts = settings._UseLightCuts;
+    _RayTracer->_LightcutsErrorThreshold = settings._LightcutsErrorThreshold;
+    _RayTracer->_LightcutsMaxClusters = settings._LightcutsMaxClusters;
+    _RayTracer->_CacheDirectory = CpuRayTracer::DEFAULT_CACHE_DIRECTORY;
+}
+void Application::initRayTracingStructures(){
+    // built here instead of at the first render
+    if(_RayTracer == nullptr) return;
+    _RayTracer->initAccelerationStructure();
+    _RayTracer->initLights();
+}
+void Application::initRaytracer(){
+    if(_RayTracer == nullptr){
+        be::ErrorHandler::handle(__FILE__, __LINE__, 
+            be::ErrorCode::IO_ERROR, 
+            "Failed to create the ray tracing scene!\n"
+        );
+    }
+    _RayTracer->setResolution(
+        _Renderer->getSwapChain()->getWidth(), 
+        _Renderer->getSwapChain()->getHeight()
+    );
 }
 void Application::initGUI(){
     MouseInput::setMouseCallback(_Camera, _Window);
@@ -519,6 +351,10 @@ void Application::initGUI(){
 /*******************************************************************/
 /************************ CLEANUP FUNCTIONS ************************/
 /*******************************************************************/
+void Application::cleanUpRaytracer(){
+    // join the worker before destroying what it renders into
+    _RenderJob = nullptr;
+}
 void Application::cleanUpGUI(){
     be::BeImgui::cleanUp(_VulkanApp);
 }
@@ -535,6 +371,9 @@ void Application::cleanUpRenderSubSystems(){
     _RenderSubSystem->cleanUp();
     _BRDFRenderSubSystem->cleanUp();
     _RaytracingRenderSubSystem->cleanUp();
+    _PipelineCache->save();
+    _PipelineCache->cleanUp();
+    _MemoryPool->cleanUp();
 }
 void Application::cleanUpDescriptors(){
     _GlobalPool->cleanUp();
@@ -576,34 +415,97 @@ void Application::switchRenderingMode(){
     }
 }
 void Application::runRaytracer(){
-    if(_RenderingMode == RAY_TRACING && !_Hasrun){
-        be::Vector3 backgroundColor = be::Color::toSRGB({0.383f, 0.632f, 0.800f});
-        // to match brdf render sub system
-        switch(_BRDFRenderSubSystem->getBRDFModel()){
-            case COLOR_BRDF:
-                _RayTracer->enableColorBRDF();
-                break;
-            case NORMAL_BRDF:
-                _RayTracer->enableNormalBRDF();
-                break;
-            case LAMBERT_BRDF:
-                _RayTracer->enableLambertBRDF();
-                break;
-            case MICROFACET_BRDF:
-                _RayTracer->enableGgxBRDF();
-                break;
-            default:
-                break;
+    if(_RenderingMode != RAY_TRACING || _Hasrun) return;
+    if(_RenderJob != nullptr && !_RenderJob->isDone()) return;
+
+    // to match brdf render sub system
+    switch(_BRDFRenderSubSystem->getBRDFModel()){
+        case COLOR_BRDF:
+            _RayTracer->enableColorBRDF();
+            break;
+        case NORMAL_BRDF:
+            _RayTracer->enableNormalBRDF();
+            break;
+        case LAMBERT_BRDF:
+            _RayTracer->enableLambertBRDF();
+            break;
+        case MICROFACET_BRDF:
+            _RayTracer->enableGgxBRDF();
+            break;
+        default:
+            break;
+    }
+
+    // the material of the window only reaches the ray tracer between two renders
+    if(_IsRayTracingMaterialDirty){
+        const auto& material = be::GameCoordinator::getComponent<be::ComponentMaterial>(
+            *_EditedMaterialObject
+        );
+        std::array<float, MaterialDescription::NB_PARAMETERS> parameters{};
+        for(uint32_t i=0; i<MaterialDescription::NB_PARAMETERS; i++){
+            parameters[i] = material._Material->get(i);
         }
+        CpuMaterial rayTracingMaterial = _RayTracingScene->getMaterials()[_EditedMaterialMesh];
+        rayTracingMaterial.setParameters(parameters.data());
+        _RayTracingScene->setMaterial(_EditedMaterialMesh, rayTracingMaterial);
+        _IsRayTracingMaterialDirty = false;
+    }
+
+    // render from the current point of view
+    CpuCamera camera = _RayTracingScene->getCamera();
+    camera._Eye = toVec3(_Camera->getPosition());
+    camera._At = camera._Eye + toVec3(_Camera->getFront());
+    camera._Up = toVec3(_Camera->getUp());
+    _RayTracingScene->setCamera(camera);
+
+    // the texture is only recreated if the resolution changed
+    _RaytracingRenderSubSystem->setRenderPass(_Renderer->getSwapChainRenderPass());
+    _RaytracingRenderSubSystem->resize(_RayTracer->getImage()->getWidth(), _RayTracer->getImage()->getHeight());
+
+    Vec3 backgroundColor = toVec3(be::Color::toSRGB({0.383f, 0.632f, 0.800f}));
+    _RenderJob = CpuRenderJobPtr(new CpuRenderJob(_RayTracer, backgroundColor, _IsLightTreeDirty));
+    _IsLightTreeDirty = false;
+    _Hasrun = true;
+}
+void Application::cancelRaytracer(){
+    if(_RenderJob != nullptr && !_RenderJob->isDone()){
+        _RenderJob->cancel();
+        fprintf(stdout, "\nRay tracing cancelled\n");
+    }
+}
+void Application::updateRaytracingImage(){
+    if(_RenderJob == nullptr) return;
+
+    // read before taking the tiles so the last ones are not missed
+    bool isDone = _RenderJob->isDone();
+    std::vector<CpuTile> tiles = _RenderJob->takeFinishedTiles();
 
-        _RayTracer->run(_CurrentFrame, backgroundColor);
-        if(_SaveImage){
-            _RayTracer->getImage()->savePPM();
+    // only the finished tiles are copied, during the next frame
+    CpuImagePtr image = _RayTracer->getImage();
+    if(!tiles.empty()){
+        _RaytracingRenderSubSystem->updateRegions(image, tiles);
+    }
+
+    // every tile was published before the job was flagged as done
+    if(isDone){
+        _RenderJob->wait();
+        if(_SaveImage && !_RenderJob->isCancelled()){
+            image->savePPM("ray_tracer.ppm");
         }
-        _RaytracingRenderSubSystem->setRenderPass(_Renderer->getSwapChainRenderPass());
-        _RaytracingRenderSubSystem->updateImage(_RayTracer->getImage());
-        _Hasrun = true;
+        _RayTracer->getStats().print();
+        _RenderJob = nullptr;
+    }
+}
+void Application::resizeRaytracer(uint32_t width, uint32_t height){
+    CpuImagePtr image = _RayTracer->getImage();
+    if(image->getWidth() == width && image->getHeight() == height) return;
+    // the image can't be reallocated under the worker
+    if(_RenderJob != nullptr){
+        _RenderJob->cancel();
+        _RenderJob = nullptr;
+        _Hasrun = false;
     }
+    _RayTracer->setResolution(width, height);
 }
 
 
@@ -614,28 +516,47 @@ void Application::runRaytracer(){
 void Application::run(){
     static const uint32_t SEED = 4242;
     srand(SEED);
+    _StartTime = std::chrono::high_resolution_clock::now();
     init();
     mainLoop();
     cleanUp();
 }
 
 void Application::init() {
-    initWindow();
-    initVulkan();
-    initCamera();
-    be::Components::registerComponents();
-    initRenderer();
-    initDescriptors();
-    initSystems();
-    initRenderSubSystems();
-    initScene();
-    initRaytracer();
-    initGameObjects();
-    initLights();
-    initGUI();
+    StartupTimeline timeline{};
+    timeline.run("scene description", "main", [this](){initSceneDescription();});
+
+    // the models of the ray tracer are decoded and its structures built while vulkan starts
+    std::future<void> rayTracingLoader = std::async(std::launch::async, [this, &timeline](){
+        timeline.run("ray tracing scene", "loader", [this](){initRayTracingScene();}, {"scene description"});
+        timeline.run("ray tracing structures", "loader", [this](){initRayTracingStructures();});
+    });
+
+    timeline.run("window", "main", [this](){initWindow();});
+    timeline.run("vulkan", "main", [this](){initVulkan();});
+    timeline.run("renderer", "main", [this](){
+        initCamera();
+        be::Components::registerComponents();
+        initRenderer();
+        initDescriptors();
+        initSystems();
+    });
+    timeline.run("render subsystems", "main", [this](){initRenderSubSystems();});
+    timeline.run("game objects", "main", [this](){
+        initScene();
+        initGameObjects();
+    });
+    timeline.run("lights", "main", [this](){initLights();});
+    timeline.run("gui", "main", [this](){initGUI();});
+    // the stage starts once the loader is done so the critical path goes through the one that finished last
+    rayTracingLoader.get();
+    timeline.run("ray tracer", "main", [this](){initRaytracer();}, {"ray tracing structures"});
+    timeline.print();
+    _MemoryPool->printStats();
 }
 
 void Application::cleanUp(){
+    cleanUpRaytracer();
     cleanUpGUI();
     cleanUpGameObjects();
     cleanUpRenderSubSystems();
@@ -648,6 +569,7 @@ void Application::cleanUp(){
 void Application::renderRayTracing(float frameTime){
     _Camera->lock();
     KeyboardInput::runRaytracer(_Window, this);
+    updateRaytracingImage();
     // IMGUI
     {
         // Start the Dear ImGui frame
@@ -659,6 +581,17 @@ void Application::renderRayTracing(float frameTime){
         ImGui::Begin("Render commands");
         ImGui::Text("Switch to Rasterizing: TAB");
         ImGui::Text("Run ray tracer: SPACE");
+        ImGui::Text("Cancel ray tracer: C");
+        bool isRendering = _RenderJob != nullptr && !_RenderJob->isDone();
+        if(_RenderJob != nullptr){
+            ImGui::Text("Progress: %u/%u tiles%s", 
+                _RenderJob->getNbTilesDone(), 
+                _RenderJob->getNbTiles(),
+                _RenderJob->isCancelled() ? " (cancelled)" : ""
+            );
+        }
+        // the parameters are read by the render threads
+        ImGui::BeginDisabled(isRendering);
 
         ImGui::Checkbox(
             "Save result image", 
@@ -716,6 +649,29 @@ void Application::renderRayTracing(float frameTime){
             200
         );
 
+        ImGui::Checkbox(
+            "Start from the cut of the previous pixel", 
+            &_RayTracer->_UseCutCoherence
+        );
+
+        ImGui::Checkbox(
+            "Multidimensional lightcuts for bounces", 
+            &_RayTracer->_UseMultidimensionalLightcuts
+        );
+
+        ImGui::Checkbox(
+            "Reconstruction cuts", 
+            &_RayTracer->_UseReconstructionCuts
+        );
+
+        // the light tree is rebuilt with or without the virtual point lights by the next render
+        if(ImGui::Checkbox(
+            "Virtual point lights", 
+            &_RayTracer->_UseVpls
+        )){
+            _IsLightTreeDirty = true;
+        }
+        ImGui::EndDisabled();
 
         ImGui::End();
     }
@@ -731,6 +687,9 @@ void Application::renderRayTracing(float frameTime){
         _CurrentFrame._CommandBuffer = commandBuffer;
         _CurrentFrame._Camera = _Camera;
 
+        // transfers can't be recorded inside the render pass
+        _RaytracingRenderSubSystem->recordUploads(commandBuffer, _CurrentFrame._FrameIndex);
+
         _Renderer->beginSwapChainRenderPass(commandBuffer);
         if(_RaytracingRenderSubSystem->isInit()){
             _RaytracingRenderSubSystem->renderGameObjects(_CurrentFrame);
@@ -742,6 +701,7 @@ void Application::renderRayTracing(float frameTime){
     }
 }
 void Application::renderRasterizer(float frameTime){
+    cancelRaytracer();
     _Hasrun = false;
     _Camera->unlock();
     KeyboardInput::switchPipeline(_Window, _BRDFRenderSubSystem);
@@ -761,17 +721,25 @@ void Application::renderRasterizer(float frameTime){
         ImGui::Text("Switch Pipeline: P (current %s)", 
             BrdfRenderSubSystem::_PIPELINE_NAMES[_BRDFRenderSubSystem->getBRDFModel()].c_str());
         ImGui::Text("Toogle Wireframe: F1");
-        ImGui::Text("\nMaterial Properties:\n");
-        auto& material = be::GameCoordinator::getComponent<be::ComponentMaterial>(
-            _GameObjects[2]
-        );
-        for(uint32_t i=0; i<be::Material::COMPONENT_MATERIAL_NB_ELEMENTS; i++){
-            ImGui::SliderFloat(
-                be::Material::COMPONENT_MATERIAL_NAMES[i].c_str(),
-                &material._Material->get(i),
-                be::Material::COMPONENT_MATERIAL_MIN_VALUES[i],
-                be::Material::COMPONENT_MATERIAL_MAX_VALUES[i]
+        // the first mesh of the scene with a material, if any
+        if(_EditedMaterialObject.has_value()){
+            ImGui::Text("\nMaterial Properties:\n");
+            auto& material = be::GameCoordinator::getComponent<be::ComponentMaterial>(
+                *_EditedMaterialObject
             );
+            bool isMaterialModified = false;
+            for(uint32_t i=0; i<be::Material::COMPONENT_MATERIAL_NB_ELEMENTS; i++){
+                isMaterialModified |= ImGui::SliderFloat(
+                    be::Material::COMPONENT_MATERIAL_NAMES[i].c_str(),
+                    &material._Material->get(i),
+                    be::Material::COMPONENT_MATERIAL_MIN_VALUES[i],
+                    be::Material::COMPONENT_MATERIAL_MAX_VALUES[i]
+                );
+            }
+            if(isMaterialModified){
+                _BRDFRenderSubSystem->setMaterialsDirty();
+                _IsRayTracingMaterialDirty = true;
+            }
         }
         ImGui::End();
     }
@@ -801,6 +769,7 @@ void Application::renderRasterizer(float frameTime){
 void Application::mainLoop(){
 
     auto curTime = std::chrono::high_resolution_clock::now();
+    bool isFirstFrame = true;
 
     while(!_Window->shouldClose()){
         glfwPollEvents();
@@ -811,14 +780,14 @@ void Application::mainLoop(){
 
         float height = _Renderer->getSwapChain()->getHeight();
         float width = _Renderer->getSwapChain()->getWidth();
-        _RayTracer->setResolution(width, height);
+        resizeRaytracer(width, height);
         _Camera->setAspectRatio(width, height);
         _Camera->setDt(frameTime);
 
         KeyboardInput::updateMouseMode(_Window);
         KeyboardInput::switchRenderingMode(_Window, this);
         if(_Window->wasWindowResized()){
-            _RayTracer->setResolution(_Renderer->getSwapChain()->getWidth(), _Renderer->getSwapChain()->getHeight());
+            resizeRaytracer(_Renderer->getSwapChain()->getWidth(), _Renderer->getSwapChain()->getHeight());
         }
 
         switch(_RenderingMode){
@@ -829,6 +798,14 @@ void Application::mainLoop(){
                 renderRasterizer(frameTime);
                 break;
         }
+
+        if(isFirstFrame){
+            isFirstFrame = false;
+            auto firstFrameTime = std::chrono::high_resolution_clock::now();
+            fprintf(stdout, "First frame in %fs\n", 
+                std::chrono::duration<float, std::chrono::seconds::period>(firstFrameTime - _StartTime).count()
+            );
+        }
     }
     vkDeviceWaitIdle(_VulkanApp->getDevice());
 }
\ No newline at end of file
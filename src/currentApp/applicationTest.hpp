@@ -1,12 +1,17 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include <BigoudiEngine.hpp>
 
+#include "cpuRenderJob.hpp"
 #include "renderSubSystems.hpp" // IWYU pragma: keep
+#include "sceneDescription.hpp"
 
 
 class Application;
@@ -22,26 +27,45 @@ class Application : public be::IApplication{
     public:
         static const uint32_t WINDOW_WIDTH = 1280;
         static const uint32_t WINDOW_HEIGHT = 720;
+        static const std::string DEFAULT_SCENE_FILE;
 
     private:
         be::DescriptorPoolPtr _GlobalPool = nullptr;
         be::DescriptorPoolPtr _GlobalPoolTmp = nullptr;
 
         std::vector<be::GameObject> _GameObjects = {};
+        // edited by the ImGui window, the first mesh of the scene with a material
+        std::optional<be::GameObject> _EditedMaterialObject{};
+        // index of its mesh in the scene description, and of its material in the ray tracing scene
+        uint32_t _EditedMaterialMesh = 0;
         be::CameraPtr _Camera = nullptr;
 
         FrameRenderSubSystemPtr _RenderSubSystem = nullptr;
         BrdfRenderSubSystemPtr _BRDFRenderSubSystem = nullptr;
         RaytracingRenderSubSystemPtr _RaytracingRenderSubSystem = nullptr;
+        PipelineCachePtr _PipelineCache = nullptr;
+        // vertex, index, staging buffers and textures created outside of the engine
+        DeviceMemoryPoolPtr _MemoryPool = nullptr;
 
         be::ScenePtr _Scene = nullptr;
         bool _IsSwitchRenderingModeKeyPressed = false;
         RenderingMode _RenderingMode = RASTERIZING;
-        be::RayTracerPtr _RayTracer = nullptr;
+        // the ray tracer runs on the cpu in the background while the window keeps refreshing
+        CpuScenePtr _RayTracingScene = nullptr;
+        CpuRayTracerPtr _RayTracer = nullptr;
+        CpuRenderJobPtr _RenderJob = nullptr;
+        // edits of the window applied by the next render, the ray tracer can't change during one
+        bool _IsRayTracingMaterialDirty = false;
+        bool _IsLightTreeDirty = false;
         be::FrameInfo _CurrentFrame = {};
         bool _Hasrun = false;
         bool _SaveImage = true;
 
+        std::string _SceneFile = DEFAULT_SCENE_FILE;
+        // time to first frame is measured from the start of run
+        std::chrono::high_resolution_clock::time_point _StartTime{};
+        SceneDescription _SceneDescription{};
+
         
 
     private:
@@ -54,23 +78,24 @@ class Application : public be::IApplication{
         void initSystems();
         void initRenderSubSystems();
         void initScene();
+        void initSceneDescription();
+        // cpu side of the ray tracer, only reads the scene description so it can run on another thread
+        void initRayTracingScene();
+        void initRayTracingStructures();
         void initRaytracer();
 
         // init objects
         void initGameObjectsFrame();
         void initGameObjectsRayTracingViewRectangle();
-        void initGameObjectsRoom();
-        void initDragonScene();
-        void initSpheresScene();
         void initGameObjectsEntities();
         void initGameObjects();
-        void initLightsBasic();
-        void initLightsCircle();
-        void initLightsBoxes();
+        void initLightsGizmos();
+        void initLightsCubes();
         void initLights();
         void initGUI();
 
         // clean ups
+        void cleanUpRaytracer();
         void cleanUpGUI();
         void cleanUpGameObjects();
         void cleanUpRenderSubSystems();
@@ -93,11 +118,15 @@ class Application : public be::IApplication{
         void resetSwitchRenderingModeKey();
         void switchRenderingMode();
         void runRaytracer();
+        void cancelRaytracer();
+        void updateRaytracingImage();
+        void resizeRaytracer(uint32_t width, uint32_t height);
 
 
     // public main functions
     public:
         Application(){};
+        Application(const std::string& sceneFile) : _SceneFile(sceneFile){};
         void run() override;
 
 };
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include "cpuMath.hpp"
+#include "cpuScene.hpp"
+
+// brdf of a shading point, a lambert term with an optional ggx specular lobe
+// a constant vector converts to a lambert brdf
+struct CpuBrdf{
+    // the roughness is squared, this keeps the peak of the lobe finite
+    static constexpr float MIN_ALPHA = 1e-3f;
+
+    Vec3 _Diffuse{0.f};
+    // reflectance at normal incidence, null without specular lobe
+    Vec3 _F0{0.f};
+    float _Alpha = 1.f;
+    Vec3 _Normal{};
+    Vec3 _ToEye{};
+    float _CosEye = 1.f;
+    bool _HasSpecular = false;
+
+    CpuBrdf(){};
+    CpuBrdf(const Vec3& diffuse) : _Diffuse(diffuse){};
+
+    // metallic, specular and roughness follow the disney conventions of be::Material
+    static CpuBrdf ggx(const CpuMaterial& material, const Vec3& normal, const Vec3& toEye){
+        CpuBrdf brdf(material._Albedo * ((1.f - material._Metallic) / CPU_PI));
+        Vec3 dielectric = Vec3(0.08f * material._Specular);
+        brdf._F0 = dielectric + (material._Albedo - dielectric) * material._Metallic;
+        brdf._Alpha = std::max(material._Roughness * material._Roughness, MIN_ALPHA);
+        brdf._Normal = normal;
+        brdf._ToEye = toEye;
+        brdf._CosEye = std::max(dot(normal, toEye), 1e-4f);
+        brdf._HasSpecular = true;
+        return brdf;
+    }
+
+    // toLight does not need to be normalized
+    Vec3 evaluate(const Vec3& toLight) const {
+        if(!_HasSpecular) return _Diffuse;
+        Vec3 l = normalize(toLight);
+        float cosLight = dot(_Normal, l);
+        if(cosLight <= 0.f) return _Diffuse;
+        Vec3 h = normalize(l + _ToEye);
+        float cosHalf = std::max(dot(_Normal, h), 0.f);
+        float alpha2 = _Alpha * _Alpha;
+        float d = cosHalf * cosHalf * (alpha2 - 1.f) + 1.f;
+        float distribution = alpha2 / (CPU_PI * d * d);
+        // height correlated smith visibility, includes the 1 / (4 cos cos) of the microfacet model
+        float visibility = 0.5f / (
+            cosLight * std::sqrt(_CosEye * _CosEye * (1.f - alpha2) + alpha2)
+            + _CosEye * std::sqrt(cosLight * cosLight * (1.f - alpha2) + alpha2)
+        );
+        float fresnel = std::pow(1.f - std::max(dot(l, h), 0.f), 5.f);
+        Vec3 f = _F0 + (Vec3(1.f) - _F0) * fresnel;
+        return _Diffuse + f * (distribution * visibility);
+    }
+
+    // max over every direction, the distribution peaks at 1 / (pi alpha^2)
+    // and the visibility is below 1 / (2 alpha cos eye)
+    float getUpperBound() const {
+        if(!_HasSpecular) return maxComponent(_Diffuse);
+        return maxComponent(_Diffuse) + 0.5f / (CPU_PI * _Alpha * _Alpha * _Alpha * _CosEye);
+    }
+};
\ No newline at end of file
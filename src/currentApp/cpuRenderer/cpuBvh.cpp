@@ -0,0 +1,174 @@
+#include "cpuBvh.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+CpuBvhPtr CpuBvh::build(const std::vector<CpuTriangle>& triangles){
+    std::vector<Aabb> boxes(triangles.size());
+    #pragma omp parallel for
+    for(size_t i=0; i<triangles.size(); i++){
+        boxes[i].extend(triangles[i]._V0);
+        boxes[i].extend(triangles[i]._V1);
+        boxes[i].extend(triangles[i]._V2);
+    }
+    return build(boxes);
+}
+
+CpuBvhPtr CpuBvh::build(const std::vector<Aabb>& primitiveBoxes){
+    CpuBvhPtr bvh = CpuBvhPtr(new CpuBvh());
+    uint32_t nbPrimitives = static_cast<uint32_t>(primitiveBoxes.size());
+    if(nbPrimitives == 0) return bvh;
+
+    std::vector<Vec3> centroids(nbPrimitives);
+    for(uint32_t i=0; i<nbPrimitives; i++){
+        centroids[i] = primitiveBoxes[i].getCenter();
+    }
+    bvh->_PrimitiveIndices.resize(nbPrimitives);
+    std::iota(bvh->_PrimitiveIndices.begin(), bvh->_PrimitiveIndices.end(), 0);
+
+    // a binary tree with at least one primitive per leaf
+    bvh->_Nodes.reserve(2*nbPrimitives - 1);
+    bvh->_Nodes.push_back({._Offset = 0, ._NbPrimitives = nbPrimitives});
+    bvh->subdivide(0, 0, primitiveBoxes, centroids);
+    bvh->_Nodes.shrink_to_fit();
+    return bvh;
+}
+
+void CpuBvh::addToCache(CpuCacheWriter& writer) const {
+    writer.addSection(_Nodes);
+    writer.addSection(_PrimitiveIndices);
+}
+
+CpuBvhPtr CpuBvh::loadFromCache(const CpuCacheReader& reader, uint32_t firstSection, uint32_t nbPrimitives){
+    CpuBvhPtr bvh = CpuBvhPtr(new CpuBvh());
+    if(!reader.readSection(firstSection, bvh->_Nodes) || !reader.readSection(firstSection + 1, bvh->_PrimitiveIndices)){
+        return nullptr;
+    }
+    if(bvh->_PrimitiveIndices.size() != nbPrimitives || (nbPrimitives > 0 && bvh->_Nodes.empty())){
+        return nullptr;
+    }
+    return bvh;
+}
+
+uint64_t CpuBvh::getCacheKey(const std::vector<CpuTriangle>& triangles, uint64_t seed){
+    const uint64_t parameters[] = {sizeof(CpuBvhNode), sizeof(CpuTriangle), NB_BINS, MAX_LEAF_SIZE, MAX_DEPTH};
+    return hashVector(triangles, hashBytes(parameters, sizeof(parameters), seed));
+}
+
+void CpuBvh::refit(const std::vector<Aabb>& primitiveBoxes){
+    // children are always stored after their parent
+    for(size_t i=_Nodes.size(); i-->0;){
+        CpuBvhNode& node = _Nodes[i];
+        Aabb boundingBox{};
+        if(node.isLeaf()){
+            for(uint32_t j=node._Offset; j<node._Offset+node._NbPrimitives; j++){
+                boundingBox.extend(primitiveBoxes[_PrimitiveIndices[j]]);
+            }
+        } else {
+            boundingBox.extend(_Nodes[node._Offset]._BoundingBox);
+            boundingBox.extend(_Nodes[node._Offset+1]._BoundingBox);
+        }
+        node._BoundingBox = boundingBox;
+    }
+}
+
+namespace{
+
+struct Bin{
+    Aabb _BoundingBox{};
+    uint32_t _NbPrimitives = 0;
+};
+
+}
+
+void CpuBvh::subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<Aabb>& boxes, const std::vector<Vec3>& centroids){
+    uint32_t first = _Nodes[nodeIndex]._Offset;
+    uint32_t nbPrimitives = _Nodes[nodeIndex]._NbPrimitives;
+
+    Aabb boundingBox{};
+    Aabb centroidBox{};
+    for(uint32_t i=first; i<first+nbPrimitives; i++){
+        boundingBox.extend(boxes[_PrimitiveIndices[i]]._Min);
+        boundingBox.extend(boxes[_PrimitiveIndices[i]]._Max);
+        centroidBox.extend(centroids[_PrimitiveIndices[i]]);
+    }
+    _Nodes[nodeIndex]._BoundingBox = boundingBox;
+    if(nbPrimitives == 1 || depth + 1 >= MAX_DEPTH) return;
+
+    // sweep the bins of every axis to find the cheapest split
+    float bestCost = CPU_INFINITY;
+    uint32_t bestAxis = 0;
+    uint32_t bestSplit = 0;
+    Vec3 extent = centroidBox.getDiagonal();
+    for(uint32_t axis=0; axis<3; axis++){
+        if(extent[axis] <= 0.f) continue;
+        float scale = NB_BINS / extent[axis];
+        Bin bins[NB_BINS];
+        for(uint32_t i=first; i<first+nbPrimitives; i++){
+            uint32_t primitive = _PrimitiveIndices[i];
+            uint32_t bin = std::min(NB_BINS-1, static_cast<uint32_t>((centroids[primitive][axis] - centroidBox._Min[axis]) * scale));
+            bins[bin]._NbPrimitives++;
+            bins[bin]._BoundingBox.extend(boxes[primitive]._Min);
+            bins[bin]._BoundingBox.extend(boxes[primitive]._Max);
+        }
+
+        float leftAreas[NB_BINS-1];
+        uint32_t leftCounts[NB_BINS-1];
+        Aabb leftBox{};
+        uint32_t leftCount = 0;
+        for(uint32_t i=0; i<NB_BINS-1; i++){
+            leftCount += bins[i]._NbPrimitives;
+            if(bins[i]._NbPrimitives > 0){
+                leftBox.extend(bins[i]._BoundingBox._Min);
+                leftBox.extend(bins[i]._BoundingBox._Max);
+            }
+            leftCounts[i] = leftCount;
+            leftAreas[i] = leftBox.isEmpty() ? 0.f : leftBox.getHalfArea();
+        }
+        Aabb rightBox{};
+        uint32_t rightCount = 0;
+        for(uint32_t i=NB_BINS-1; i>0; i--){
+            rightCount += bins[i]._NbPrimitives;
+            if(bins[i]._NbPrimitives > 0){
+                rightBox.extend(bins[i]._BoundingBox._Min);
+                rightBox.extend(bins[i]._BoundingBox._Max);
+            }
+            if(leftCounts[i-1] == 0 || rightCount == 0) continue;
+            float cost = leftAreas[i-1] * leftCounts[i-1] + rightBox.getHalfArea() * rightCount;
+            if(cost < bestCost){
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    float leafCost = static_cast<float>(nbPrimitives);
+    float splitCost = TRAVERSAL_COST + bestCost / boundingBox.getHalfArea();
+    if(splitCost >= leafCost && nbPrimitives <= MAX_LEAF_SIZE) return;
+
+    uint32_t* begin = _PrimitiveIndices.data() + first;
+    uint32_t* end = begin + nbPrimitives;
+    uint32_t* middle = begin + nbPrimitives / 2;
+    if(bestCost < CPU_INFINITY){
+        float scale = NB_BINS / extent[bestAxis];
+        middle = std::partition(begin, end, [&](uint32_t primitive){
+            uint32_t bin = std::min(NB_BINS-1, static_cast<uint32_t>((centroids[primitive][bestAxis] - centroidBox._Min[bestAxis]) * scale));
+            return bin < bestSplit;
+        });
+    }
+    // every centroid is at the same place, split in the middle of the range
+    uint32_t nbLeft = static_cast<uint32_t>(middle - begin);
+    if(nbLeft == 0 || nbLeft == nbPrimitives){
+        nbLeft = nbPrimitives / 2;
+    }
+
+    uint32_t left = static_cast<uint32_t>(_Nodes.size());
+    _Nodes.push_back({._Offset = first, ._NbPrimitives = nbLeft});
+    _Nodes.push_back({._Offset = first + nbLeft, ._NbPrimitives = nbPrimitives - nbLeft});
+    _Nodes[nodeIndex]._Offset = left;
+    _Nodes[nodeIndex]._NbPrimitives = 0;
+
+    subdivide(left, depth+1, boxes, centroids);
+    subdivide(left+1, depth+1, boxes, centroids);
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "cpuCacheFile.hpp"
+#include "cpuMath.hpp"
+#include "cpuScene.hpp"
+
+class CpuBvh;
+using CpuBvhPtr = std::shared_ptr<CpuBvh>;
+
+struct CpuBvhNode{
+    Aabb _BoundingBox{};
+    // first child for inner nodes, the second one is right after it
+    // first primitive index for leaves
+    uint32_t _Offset = 0;
+    uint32_t _NbPrimitives = 0;
+
+    bool isLeaf() const {return _NbPrimitives > 0;}
+};
+
+// slab test, tNear is the entry distance along the ray
+inline bool intersectBox(const Aabb& box, const Ray& ray, const Vec3& invDirection, float& tNear){
+    float t0 = ray._TMin;
+    float t1 = ray._TMax;
+    for(uint32_t axis=0; axis<3; axis++){
+        float tA = (box._Min[axis] - ray._Origin[axis]) * invDirection[axis];
+        float tB = (box._Max[axis] - ray._Origin[axis]) * invDirection[axis];
+        if(tA > tB) std::swap(tA, tB);
+        t0 = tA > t0 ? tA : t0;
+        t1 = tB < t1 ? tB : t1;
+        // conservative exit distance so rays grazing flat boxes are not lost
+        if(t0 > t1 * 1.0000004f) return false;
+    }
+    tNear = t0;
+    return true;
+}
+
+// bounding volume hierarchy over any kind of primitive given by its bounding box
+class CpuBvh{
+
+    public:
+        static const uint32_t NB_BINS = 16;
+        static const uint32_t MAX_LEAF_SIZE = 4;
+        static const uint32_t MAX_DEPTH = 64;
+        // cost of a box test relative to a primitive test
+        static constexpr float TRAVERSAL_COST = 1.f;
+
+    private:
+        std::vector<CpuBvhNode> _Nodes{};
+        // primitives sorted so that every leaf references a contiguous range
+        std::vector<uint32_t> _PrimitiveIndices{};
+
+    public:
+        CpuBvh(){};
+
+        const std::vector<CpuBvhNode>& getNodes() const {return _Nodes;}
+        const std::vector<uint32_t>& getPrimitiveIndices() const {return _PrimitiveIndices;}
+        uint32_t getNbNodes() const {return static_cast<uint32_t>(_Nodes.size());}
+
+        // update the bounding boxes after the primitives moved, the topology is kept
+        void refit(const std::vector<Aabb>& primitiveBoxes);
+
+        // two sections: the nodes and the primitive indices
+        void addToCache(CpuCacheWriter& writer) const;
+        // nullptr if the sections do not hold a bvh over nbPrimitives primitives
+        static CpuBvhPtr loadFromCache(const CpuCacheReader& reader, uint32_t firstSection, uint32_t nbPrimitives);
+        // triangles and build parameters, chained with the seed to key several bvhs at once
+        static uint64_t getCacheKey(const std::vector<CpuTriangle>& triangles, uint64_t seed = 0);
+
+        // intersectPrimitive(primitiveIndex, ray) returns true on a hit and shortens ray._TMax
+        // return true if any primitive was hit, ray._TMax is then the closest hit distance
+        template<typename Intersector>
+        bool traverse(Ray& ray, Intersector&& intersectPrimitive, uint64_t& nbNodesVisited) const;
+        // occlusion only, stop at the first primitive for which isPrimitiveHit(primitiveIndex, ray) is true
+        // children are not sorted since any hit will do
+        template<typename Intersector>
+        bool traverseAny(const Ray& ray, Intersector&& isPrimitiveHit, uint64_t& nbNodesVisited) const;
+
+    public:
+        // binned surface area heuristic
+        static CpuBvhPtr build(const std::vector<Aabb>& primitiveBoxes);
+        static CpuBvhPtr build(const std::vector<CpuTriangle>& triangles);
+
+    private:
+        void subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<Aabb>& boxes, const std::vector<Vec3>& centroids);
+};
+
+template<typename Intersector>
+bool CpuBvh::traverse(Ray& ray, Intersector&& intersectPrimitive, uint64_t& nbNodesVisited) const {
+    if(_Nodes.empty()) return false;
+    Vec3 invDirection = {1.f / ray._Direction.x, 1.f / ray._Direction.y, 1.f / ray._Direction.z};
+
+    struct StackEntry{
+        uint32_t _Node;
+        float _TNear;
+    };
+    StackEntry stack[MAX_DEPTH];
+    uint32_t stackSize = 0;
+
+    float tNear = 0.f;
+    if(!intersectBox(_Nodes[0]._BoundingBox, ray, invDirection, tNear)) return false;
+    stack[stackSize++] = {0, tNear};
+
+    bool isHit = false;
+    while(stackSize > 0){
+        StackEntry entry = stack[--stackSize];
+        // a closer hit was found since the node was pushed
+        if(entry._TNear > ray._TMax) continue;
+
+        nbNodesVisited++;
+        const CpuBvhNode& node = _Nodes[entry._Node];
+        if(node.isLeaf()){
+            for(uint32_t i=0; i<node._NbPrimitives; i++){
+                if(intersectPrimitive(_PrimitiveIndices[node._Offset + i], ray)) isHit = true;
+            }
+            continue;
+        }
+
+        uint32_t near = node._Offset;
+        uint32_t far = node._Offset + 1;
+        float tNearChild = 0.f, tFarChild = 0.f;
+        bool isNearHit = intersectBox(_Nodes[near]._BoundingBox, ray, invDirection, tNearChild);
+        bool isFarHit = intersectBox(_Nodes[far]._BoundingBox, ray, invDirection, tFarChild);
+        if(isNearHit && isFarHit && tFarChild < tNearChild){
+            std::swap(near, far);
+            std::swap(tNearChild, tFarChild);
+        } else if(!isNearHit){
+            near = far;
+            tNearChild = tFarChild;
+            isNearHit = isFarHit;
+            isFarHit = false;
+        }
+        // the nearest child is pushed last to be visited first
+        if(isFarHit) stack[stackSize++] = {far, tFarChild};
+        if(isNearHit) stack[stackSize++] = {near, tNearChild};
+    }
+    return isHit;
+}
+
+template<typename Intersector>
+bool CpuBvh::traverseAny(const Ray& ray, Intersector&& isPrimitiveHit, uint64_t& nbNodesVisited) const {
+    if(_Nodes.empty()) return false;
+    Vec3 invDirection = {1.f / ray._Direction.x, 1.f / ray._Direction.y, 1.f / ray._Direction.z};
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t stackSize = 0;
+    float tNear = 0.f;
+    if(!intersectBox(_Nodes[0]._BoundingBox, ray, invDirection, tNear)) return false;
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0){
+        nbNodesVisited++;
+        const CpuBvhNode& node = _Nodes[stack[--stackSize]];
+        if(node.isLeaf()){
+            for(uint32_t i=0; i<node._NbPrimitives; i++){
+                if(isPrimitiveHit(_PrimitiveIndices[node._Offset + i], ray)) return true;
+            }
+            continue;
+        }
+        if(intersectBox(_Nodes[node._Offset+1]._BoundingBox, ray, invDirection, tNear)){
+            stack[stackSize++] = node._Offset + 1;
+        }
+        if(intersectBox(_Nodes[node._Offset]._BoundingBox, ray, invDirection, tNear)){
+            stack[stackSize++] = node._Offset;
+        }
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "cpuCacheFile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define CPU_CACHE_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace{
+
+// bumped every time the layout of the header or of a cached structure changes
+const uint32_t CACHE_VERSION = 1;
+const char CACHE_MAGIC[8] = {'L', 'C', 'U', 'T', 'C', 'A', 'C', 'H'};
+const uint64_t SECTION_ALIGNMENT = 64;
+
+struct CacheHeader{
+    char _Magic[8];
+    uint32_t _Version;
+    uint32_t _Type;
+    uint64_t _Key;
+    // hash of everything after the header
+    uint64_t _Checksum;
+    uint64_t _FileSize;
+    uint32_t _NbSections;
+    uint32_t _Padding;
+};
+
+// followed by the sections, each one starts on an aligned offset
+struct SectionEntry{
+    uint64_t _Offset;
+    uint64_t _Size;
+};
+
+uint64_t align(uint64_t offset){
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+bool isCacheFile(const std::filesystem::path& path){
+    std::string extension = path.extension().string();
+    return extension == ".lighttree" || extension == ".bvh" || extension == ".mesh";
+}
+
+// the modification time of the files is their last use, set by the writer and the reader
+void evictCacheFiles(const std::filesystem::path& directory, const std::filesystem::path& written, uint64_t maxSize){
+    std::error_code error{};
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files{};
+    uint64_t totalSize = 0;
+    for(const auto& entry : std::filesystem::directory_iterator(directory, error)){
+        if(!entry.is_regular_file(error) || !isCacheFile(entry.path())) continue;
+        uint64_t size = entry.file_size(error);
+        if(error) continue;
+        totalSize += size;
+        if(entry.path() != written){
+            files.push_back({entry.last_write_time(error), entry.path()});
+        }
+    }
+    if(totalSize <= maxSize) return;
+
+    std::sort(files.begin(), files.end());
+    for(const auto& file : files){
+        uint64_t size = std::filesystem::file_size(file.second, error);
+        if(error || !std::filesystem::remove(file.second, error)) continue;
+        totalSize -= size;
+        if(totalSize <= maxSize) return;
+    }
+}
+
+uint64_t mix(uint64_t h){
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed){
+    // four independent lanes of 8 bytes words so the multiplications overlap
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+    uint64_t lanes[4] = {seed, seed ^ prime, seed + prime, seed - prime};
+    size_t i = 0;
+    for(; i + 32 <= size; i += 32){
+        for(uint32_t l=0; l<4; l++){
+            uint64_t word;
+            std::memcpy(&word, bytes + i + 8*l, 8);
+            lanes[l] = (lanes[l] ^ (word * prime)) * 0xbf58476d1ce4e5b9ULL;
+            lanes[l] ^= lanes[l] >> 31;
+        }
+    }
+    uint64_t h = mix(lanes[0]) ^ mix(lanes[1] + 1) ^ mix(lanes[2] + 2) ^ mix(lanes[3] + 3);
+    for(; i < size; i++){
+        h = (h ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return mix(h ^ size);
+}
+
+std::string getCachePath(const std::string& directory, CpuCacheType type, uint64_t key){
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    std::string extension = "";
+    switch(type){
+        case CPU_CACHE_LIGHT_TREE:
+            extension = ".lighttree";
+            break;
+        case CPU_CACHE_BVH:
+            extension = ".bvh";
+            break;
+        case CPU_CACHE_MESH:
+            extension = ".mesh";
+            break;
+    }
+    return (std::filesystem::path(directory) / (std::string(name) + extension)).string();
+}
+
+
+
+/********************************************************************/
+/***************************** WRITER *******************************/
+/********************************************************************/
+bool CpuCacheWriter::write(const std::string& path, CpuCacheType type, uint64_t key, uint64_t maxDirectorySize) const {
+    CacheHeader header{};
+    std::memcpy(header._Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header._Version = CACHE_VERSION;
+    header._Type = type;
+    header._Key = key;
+    header._NbSections = static_cast<uint32_t>(_Sections.size());
+
+    // everything after the header is laid out in memory to compute the checksum
+    std::vector<SectionEntry> entries(_Sections.size());
+    uint64_t offset = align(sizeof(CacheHeader) + entries.size() * sizeof(SectionEntry));
+    for(size_t i=0; i<_Sections.size(); i++){
+        entries[i] = {offset, _Sections[i].second};
+        offset = align(offset + _Sections[i].second);
+    }
+    header._FileSize = offset;
+    std::vector<uint8_t> body(offset - sizeof(CacheHeader), 0);
+    std::memcpy(body.data(), entries.data(), entries.size() * sizeof(SectionEntry));
+    for(size_t i=0; i<_Sections.size(); i++){
+        if(_Sections[i].second > 0){
+            std::memcpy(body.data() + entries[i]._Offset - sizeof(CacheHeader), _Sections[i].first, _Sections[i].second);
+        }
+    }
+    header._Checksum = hashBytes(body.data(), body.size());
+
+    std::error_code error{};
+    std::filesystem::path target(path);
+    if(target.has_parent_path()){
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if(!file){
+            fprintf(stderr, "Failed to open the cache file %s for writing!\n", temporaryPath.c_str());
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(body.data()), static_cast<std::streamsize>(body.size()));
+        if(!file){
+            fprintf(stderr, "Failed to write the cache file %s!\n", temporaryPath.c_str());
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if(error){
+        fprintf(stderr, "Failed to write the cache file %s!\n", path.c_str());
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    if(maxDirectorySize > 0){
+        evictCacheFiles(target.has_parent_path() ? target.parent_path() : std::filesystem::path("."), target, maxDirectorySize);
+    }
+    return true;
+}
+
+
+
+/********************************************************************/
+/***************************** READER *******************************/
+/********************************************************************/
+CpuCacheReader::~CpuCacheReader(){
+    close();
+}
+
+void CpuCacheReader::close(){
+    #if defined(CPU_CACHE_MMAP)
+        if(_Data != nullptr && _Buffer.empty()){
+            munmap(const_cast<uint8_t*>(_Data), _Size);
+        }
+    #endif
+    _Data = nullptr;
+    _Size = 0;
+    _Buffer.clear();
+    _Sections.clear();
+}
+
+bool CpuCacheReader::open(const std::string& path, CpuCacheType type, uint64_t key){
+    close();
+    #if defined(CPU_CACHE_MMAP)
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if(descriptor < 0) return false;
+        struct stat status{};
+        if(fstat(descriptor, &status) == 0 && status.st_size > 0){
+            void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(data != MAP_FAILED){
+                _Data = static_cast<const uint8_t*>(data);
+                _Size = static_cast<size_t>(status.st_size);
+            }
+        }
+        ::close(descriptor);
+        if(_Data == nullptr) return false;
+    #else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if(!file) return false;
+        _Buffer.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        if(_Buffer.empty() || !file.read(reinterpret_cast<char*>(_Buffer.data()), static_cast<std::streamsize>(_Buffer.size()))){
+            _Buffer.clear();
+            return false;
+        }
+        _Data = _Buffer.data();
+        _Size = _Buffer.size();
+    #endif
+
+    // files from another version or another scene are silently replaced
+    CacheHeader header{};
+    if(_Size < sizeof(CacheHeader)){
+        fprintf(stderr, "The cache file %s is truncated, it will be rebuilt\n", path.c_str());
+        close();
+        return false;
+    }
+    std::memcpy(&header, _Data, sizeof(header));
+    if(std::memcmp(header._Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || header._Version != CACHE_VERSION
+        || header._Type != type
+        || header._Key != key){
+        close();
+        return false;
+    }
+    uint64_t tableEnd = sizeof(CacheHeader) + static_cast<uint64_t>(header._NbSections) * sizeof(SectionEntry);
+    if(header._FileSize != _Size || tableEnd > _Size
+        || hashBytes(_Data + sizeof(CacheHeader), _Size - sizeof(CacheHeader)) != header._Checksum){
+        fprintf(stderr, "The cache file %s is corrupt, it will be rebuilt\n", path.c_str());
+        close();
+        return false;
+    }
+
+    _Sections.resize(header._NbSections);
+    for(uint32_t i=0; i<header._NbSections; i++){
+        SectionEntry entry{};
+        std::memcpy(&entry, _Data + sizeof(CacheHeader) + i * sizeof(SectionEntry), sizeof(entry));
+        if(entry._Offset < tableEnd || entry._Offset > _Size || entry._Size > _Size - entry._Offset){
+            fprintf(stderr, "The cache file %s is corrupt, it will be rebuilt\n", path.c_str());
+            close();
+            return false;
+        }
+        _Sections[i] = {entry._Offset, entry._Size};
+    }
+    // the writers evict the least recently used files first
+    std::error_code error{};
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
\ No newline at end of file
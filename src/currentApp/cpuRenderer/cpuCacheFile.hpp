@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+// 64 bits hash of raw bytes, used for the keys of the cached structures and the checksums of the files
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+template<typename T>
+uint64_t hashVector(const std::vector<T>& values, uint64_t seed = 0){
+    return hashBytes(values.data(), values.size() * sizeof(T), seed);
+}
+
+enum CpuCacheType : uint32_t{
+    CPU_CACHE_LIGHT_TREE = 1,
+    CPU_CACHE_BVH = 2,
+    CPU_CACHE_MESH = 3,
+};
+
+// file name of a cached structure in the directory
+std::string getCachePath(const std::string& directory, CpuCacheType type, uint64_t key);
+
+// binary file made of 64 bytes aligned sections behind a versioned header
+class CpuCacheWriter{
+
+    private:
+        // the sections only reference the data, it must live until the file is written
+        std::vector<std::pair<const void*, uint64_t>> _Sections{};
+        // copies of the small values
+        std::deque<std::vector<uint8_t>> _Values{};
+
+    public:
+        // size of the cache directory kept by default after a write
+        static const uint64_t DEFAULT_MAX_DIRECTORY_SIZE = 1ull << 30;
+
+        CpuCacheWriter(){};
+
+        void addSection(const void* data, uint64_t size){_Sections.push_back({data, size});}
+        template<typename T>
+        void addSection(const std::vector<T>& values){addSection(values.data(), values.size() * sizeof(T));}
+        template<typename T>
+        void addValue(const T& value){
+            _Values.emplace_back(sizeof(T));
+            std::memcpy(_Values.back().data(), &value, sizeof(T));
+            addSection(_Values.back().data(), sizeof(T));
+        }
+
+        // written next to the path and renamed so that a reader never sees a partial file
+        // the directory is created if needed, then its least recently used cache files are removed
+        // until it fits in maxDirectorySize, 0 keeps every file
+        bool write(const std::string& path, CpuCacheType type, uint64_t key, uint64_t maxDirectorySize = DEFAULT_MAX_DIRECTORY_SIZE) const;
+};
+
+// memory mapped cache file
+class CpuCacheReader{
+
+    private:
+        const uint8_t* _Data = nullptr;
+        size_t _Size = 0;
+        // whole file when it can't be mapped
+        std::vector<uint8_t> _Buffer{};
+        // offset and size of the sections in the file
+        std::vector<std::pair<uint64_t, uint64_t>> _Sections{};
+
+    public:
+        CpuCacheReader(){};
+        ~CpuCacheReader();
+        CpuCacheReader(const CpuCacheReader&) = delete;
+        CpuCacheReader& operator=(const CpuCacheReader&) = delete;
+
+        // return false if the file is missing, from another version or another key, truncated or corrupt
+        // a valid file is marked as used for the eviction of the writer
+        bool open(const std::string& path, CpuCacheType type, uint64_t key);
+        void close();
+
+        uint32_t getNbSections() const {return static_cast<uint32_t>(_Sections.size());}
+        const void* getSection(uint32_t id) const {return _Data + _Sections[id].first;}
+        uint64_t getSectionSize(uint32_t id) const {return _Sections[id].second;}
+
+        // return false if the size of the section is not a multiple of the size of T
+        template<typename T>
+        bool readSection(uint32_t id, std::vector<T>& values) const {
+            if(id >= _Sections.size() || getSectionSize(id) % sizeof(T) != 0) return false;
+            values.resize(getSectionSize(id) / sizeof(T));
+            std::memcpy(values.data(), getSection(id), getSectionSize(id));
+            return true;
+        }
+        template<typename T>
+        bool readValue(uint32_t id, T& value) const {
+            if(id >= _Sections.size() || getSectionSize(id) != sizeof(T)) return false;
+            std::memcpy(&value, getSection(id), sizeof(T));
+            return true;
+        }
+};
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include "cpuClusterBounds.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define CPU_BOUNDS_X86
+    #include <immintrin.h>
+#endif
+
+// the avx2 kernel is compiled for its own target and only called after the runtime check
+#if defined(CPU_BOUNDS_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define CPU_BOUNDS_AVX2
+    #define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/********************************************************************/
+/***************************** DISPATCH *****************************/
+/********************************************************************/
+CpuSimdLevel getSupportedSimdLevel(){
+    static const CpuSimdLevel supportedLevel = [](){
+        #if defined(CPU_BOUNDS_AVX2)
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2")) return CPU_SIMD_AVX2;
+        #endif
+        #if defined(CPU_BOUNDS_X86)
+            // part of x86-64
+            return CPU_SIMD_SSE;
+        #else
+            return CPU_SIMD_SCALAR;
+        #endif
+    }();
+    return supportedLevel;
+}
+
+static std::atomic<CpuSimdLevel> simdLevel{getSupportedSimdLevel()};
+
+CpuSimdLevel getSimdLevel(){
+    return simdLevel;
+}
+
+void setSimdLevel(CpuSimdLevel level){
+    simdLevel = std::min(level, getSupportedSimdLevel());
+}
+
+const char* getSimdLevelName(CpuSimdLevel level){
+    switch(level){
+        case CPU_SIMD_SCALAR:
+            return "scalar";
+        case CPU_SIMD_SSE:
+            return "sse";
+        case CPU_SIMD_AVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+
+
+/********************************************************************/
+/****************************** KERNELS *****************************/
+/********************************************************************/
+// highest cosine at the lights of the box toward the point, the directions from the box to the
+// point lie within an angle asin(radius / distance) of the direction from its center
+// cos(angleToAxis - coneAngle - boxAngle) is expanded so the simd kernels only need square roots
+static float emitterCosineBound(const Cone& cone, const Vec3& center, const Vec3& halfExtent){
+    if(cone.isFull()) return 1.f;
+    float distance = length(center);
+    float radius = length(halfExtent);
+    if(distance <= radius) return 1.f;
+    float sinBox = radius / distance;
+    float cosBox = std::sqrt(1.f - sinBox*sinBox);
+    float cosCone = cone._Cosine;
+    float sinCone = std::sqrt(std::max(0.f, 1.f - cosCone*cosCone));
+    // both angles add up to more than pi
+    if(cosCone + cosBox < 0.f) return 1.f;
+    float cosSpread = cosCone * cosBox - sinCone * sinBox;
+    float sinSpread = sinCone * cosBox + cosCone * sinBox;
+    // the center is seen from the point, the lights emit the other way
+    float cosAxis = -dot(cone._Axis, center) / distance;
+    if(cosAxis >= cosSpread) return 1.f;
+    float sinAxis = std::sqrt(std::max(0.f, 1.f - cosAxis*cosAxis));
+    return std::max(0.f, cosAxis * cosSpread + sinAxis * sinSpread);
+}
+
+// the box projected on an axis a covers a.center +- |a|.halfExtent, so the
+// cosine bound needs no corner and every kernel follows the same steps
+static float clusterErrorBoundScalar(const CpuLightTreeNode& node, const CpuBoundQuery& query){
+    if(node.isLeaf()) return 0.f;
+    const Aabb& box = node._BoundingBox;
+    float dist2 = box.distance2(query._Position);
+    if(dist2 <= 0.f) return CPU_INFINITY;
+
+    Vec3 center = box.getCenter() - query._Position;
+    Vec3 halfExtent = box.getDiagonal() * 0.5f;
+    auto project = [&](const Vec3& axis, float& value, float& extent){
+        value = dot(center, axis);
+        extent = dot(halfExtent, Vec3(std::abs(axis.x), std::abs(axis.y), std::abs(axis.z)));
+    };
+    float x, y, z, hx, hy, hz;
+    project(query._Tangent, x, hx);
+    project(query._Bitangent, y, hy);
+    project(query._Normal, z, hz);
+
+    float maxZ = z + hz;
+    if(maxZ <= 0.f) return 0.f;
+    // closest point of the projected box to the normal axis
+    float minX = std::max(std::abs(x) - hx, 0.f);
+    float minY = std::max(std::abs(y) - hy, 0.f);
+    float length = std::sqrt(minX*minX + minY*minY + maxZ*maxZ);
+    float bound = maxComponent(node._Intensity) * query._MaterialBound * maxZ / (length * dist2);
+    return bound * emitterCosineBound(node._NormalCone, center, halfExtent);
+}
+
+#if defined(CPU_BOUNDS_X86)
+// the kernels read the nodes as rows of 4 floats and transpose them:
+// [min.xyz max.x] [max.yz intensity.xy] [intensity.z representative firstChild axis.x] [axis.yz cosine -]
+static_assert(offsetof(CpuLightTreeNode, _BoundingBox) == 0 && offsetof(Aabb, _Max) == 3*sizeof(float));
+static_assert(offsetof(CpuLightTreeNode, _Intensity) == 6*sizeof(float));
+static_assert(offsetof(CpuLightTreeNode, _FirstChild) == 10*sizeof(float));
+static_assert(offsetof(CpuLightTreeNode, _NormalCone) == 11*sizeof(float) && offsetof(Cone, _Cosine) == 3*sizeof(float));
+static_assert(sizeof(Vec3) == 3*sizeof(float) && sizeof(CpuLightTreeNode) >= 16*sizeof(float));
+
+static void clusterErrorBoundsSse(const float* const rows[4], uint32_t nbNodes, const CpuBoundQuery& query, float* bounds){
+    __m128 minX = _mm_loadu_ps(rows[0]), minY = _mm_loadu_ps(rows[1]), minZ = _mm_loadu_ps(rows[2]), maxX = _mm_loadu_ps(rows[3]);
+    __m128 maxY = _mm_loadu_ps(rows[0]+4), maxZ = _mm_loadu_ps(rows[1]+4), intensityX = _mm_loadu_ps(rows[2]+4), intensityY = _mm_loadu_ps(rows[3]+4);
+    __m128 intensityZ = _mm_loadu_ps(rows[0]+8), representative = _mm_loadu_ps(rows[1]+8), firstChild = _mm_loadu_ps(rows[2]+8), axisX = _mm_loadu_ps(rows[3]+8);
+    __m128 axisY = _mm_loadu_ps(rows[0]+12), axisZ = _mm_loadu_ps(rows[1]+12), cosCone = _mm_loadu_ps(rows[2]+12), unused = _mm_loadu_ps(rows[3]+12);
+    _MM_TRANSPOSE4_PS(minX, minY, minZ, maxX);
+    _MM_TRANSPOSE4_PS(maxY, maxZ, intensityX, intensityY);
+    _MM_TRANSPOSE4_PS(intensityZ, representative, firstChild, axisX);
+    _MM_TRANSPOSE4_PS(axisY, axisZ, cosCone, unused);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    auto abs = [&](__m128 v){return _mm_andnot_ps(signMask, v);};
+    auto select = [](__m128 mask, __m128 a, __m128 b){return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));};
+    __m128 px = _mm_set1_ps(query._Position.x), py = _mm_set1_ps(query._Position.y), pz = _mm_set1_ps(query._Position.z);
+
+    // distance to the box
+    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, px), _mm_sub_ps(px, maxX)), zero);
+    __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, py), _mm_sub_ps(py, maxY)), zero);
+    __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, pz), _mm_sub_ps(pz, maxZ)), zero);
+    __m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+    __m128 cx = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(minX, maxX), half), px);
+    __m128 cy = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(minY, maxY), half), py);
+    __m128 cz = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(minZ, maxZ), half), pz);
+    __m128 hx = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+    __m128 hy = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+    __m128 hz = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+    auto project = [&](const Vec3& axis, __m128& value, __m128& extent){
+        __m128 ax = _mm_set1_ps(axis.x), ay = _mm_set1_ps(axis.y), az = _mm_set1_ps(axis.z);
+        value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, ax), _mm_mul_ps(cy, ay)), _mm_mul_ps(cz, az));
+        extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, abs(ax)), _mm_mul_ps(hy, abs(ay))), _mm_mul_ps(hz, abs(az)));
+    };
+    __m128 x, y, z, ex, ey, ez;
+    project(query._Tangent, x, ex);
+    project(query._Bitangent, y, ey);
+    project(query._Normal, z, ez);
+
+    __m128 localMaxZ = _mm_add_ps(z, ez);
+    __m128 localMinX = _mm_max_ps(_mm_sub_ps(abs(x), ex), zero);
+    __m128 localMinY = _mm_max_ps(_mm_sub_ps(abs(y), ey), zero);
+    __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(localMinX, localMinX), _mm_mul_ps(localMinY, localMinY)), _mm_mul_ps(localMaxZ, localMaxZ));
+    __m128 intensity = _mm_max_ps(intensityX, _mm_max_ps(intensityY, intensityZ));
+    __m128 bound = _mm_mul_ps(_mm_mul_ps(intensity, _mm_set1_ps(query._MaterialBound)), localMaxZ);
+    bound = _mm_div_ps(bound, _mm_mul_ps(_mm_sqrt_ps(length2), dist2));
+
+    // cosine at the lights, see emitterCosineBound, skipped when no light of the batch is oriented
+    const __m128 one = _mm_set1_ps(1.f);
+    __m128 isFullCone = _mm_cmple_ps(cosCone, _mm_set1_ps(-1.f));
+    if(_mm_movemask_ps(isFullCone) != 0xf){
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz)));
+        __m128 radius = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, hx), _mm_mul_ps(hy, hy)), _mm_mul_ps(hz, hz)));
+        __m128 sinBox = _mm_div_ps(radius, distance);
+        __m128 cosBox = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(sinBox, sinBox)), zero));
+        __m128 sinCone = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(cosCone, cosCone)), zero));
+        __m128 cosSpread = _mm_sub_ps(_mm_mul_ps(cosCone, cosBox), _mm_mul_ps(sinCone, sinBox));
+        __m128 sinSpread = _mm_add_ps(_mm_mul_ps(sinCone, cosBox), _mm_mul_ps(cosCone, sinBox));
+        __m128 cosAxis = _mm_div_ps(_mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(axisX, cx), _mm_mul_ps(axisY, cy)), _mm_mul_ps(axisZ, cz))), distance);
+        __m128 sinAxis = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(cosAxis, cosAxis)), zero));
+        __m128 emitter = _mm_max_ps(_mm_add_ps(_mm_mul_ps(cosAxis, cosSpread), _mm_mul_ps(sinAxis, sinSpread)), zero);
+        __m128 isInsideCone = _mm_or_ps(
+            _mm_or_ps(isFullCone, _mm_cmple_ps(distance, radius)),
+            _mm_or_ps(_mm_cmplt_ps(_mm_add_ps(cosCone, cosBox), zero), _mm_cmpge_ps(cosAxis, cosSpread))
+        );
+        bound = _mm_mul_ps(bound, select(isInsideCone, one, emitter));
+    }
+
+    // same priorities as the scalar kernel, the last select wins
+    __m128 isLeaf = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_castps_si128(firstChild), _mm_setzero_si128()));
+    bound = select(_mm_cmple_ps(localMaxZ, zero), zero, bound);
+    bound = select(_mm_cmple_ps(dist2, zero), _mm_set1_ps(CPU_INFINITY), bound);
+    bound = select(isLeaf, zero, bound);
+
+    if(nbNodes == 4){
+        _mm_storeu_ps(bounds, bound);
+    } else {
+        alignas(16) float result[4];
+        _mm_store_ps(result, bound);
+        std::copy(result, result + nbNodes, bounds);
+    }
+}
+#endif
+
+#if defined(CPU_BOUNDS_AVX2)
+// 4x4 transposes inside each half, the low half holds the 4 first nodes
+#define CPU_TRANSPOSE4_PS256(row0, row1, row2, row3) { \
+    __m256 t0 = _mm256_unpacklo_ps(row0, row1), t1 = _mm256_unpacklo_ps(row2, row3); \
+    __m256 t2 = _mm256_unpackhi_ps(row0, row1), t3 = _mm256_unpackhi_ps(row2, row3); \
+    row0 = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t1))); \
+    row1 = _mm256_castpd_ps(_mm256_unpackhi_pd(_mm256_castps_pd(t0), _mm256_castps_pd(t1))); \
+    row2 = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(t2), _mm256_castps_pd(t3))); \
+    row3 = _mm256_castpd_ps(_mm256_unpackhi_pd(_mm256_castps_pd(t2), _mm256_castps_pd(t3))); \
+}
+
+CPU_TARGET_AVX2
+static void clusterErrorBoundsAvx2(const float* const rows[8], uint32_t nbNodes, const CpuBoundQuery& query, float* bounds){
+    auto load = [&](uint32_t node, uint32_t offset) CPU_TARGET_AVX2 {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(rows[node] + offset)), _mm_loadu_ps(rows[node+4] + offset), 1);
+    };
+    __m256 minX = load(0, 0), minY = load(1, 0), minZ = load(2, 0), maxX = load(3, 0);
+    __m256 maxY = load(0, 4), maxZ = load(1, 4), intensityX = load(2, 4), intensityY = load(3, 4);
+    __m256 intensityZ = load(0, 8), representative = load(1, 8), firstChild = load(2, 8), axisX = load(3, 8);
+    __m256 axisY = load(0, 12), axisZ = load(1, 12), cosCone = load(2, 12), unused = load(3, 12);
+    CPU_TRANSPOSE4_PS256(minX, minY, minZ, maxX);
+    CPU_TRANSPOSE4_PS256(maxY, maxZ, intensityX, intensityY);
+    CPU_TRANSPOSE4_PS256(intensityZ, representative, firstChild, axisX);
+    CPU_TRANSPOSE4_PS256(axisY, axisZ, cosCone, unused);
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+    auto abs = [&](__m256 v) CPU_TARGET_AVX2 {return _mm256_andnot_ps(signMask, v);};
+    __m256 px = _mm256_set1_ps(query._Position.x), py = _mm256_set1_ps(query._Position.y), pz = _mm256_set1_ps(query._Position.z);
+
+    // distance to the box
+    __m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minX, px), _mm256_sub_ps(px, maxX)), zero);
+    __m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minY, py), _mm256_sub_ps(py, maxY)), zero);
+    __m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minZ, pz), _mm256_sub_ps(pz, maxZ)), zero);
+    __m256 dist2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+    __m256 cx = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(minX, maxX), half), px);
+    __m256 cy = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(minY, maxY), half), py);
+    __m256 cz = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(minZ, maxZ), half), pz);
+    __m256 hx = _mm256_mul_ps(_mm256_sub_ps(maxX, minX), half);
+    __m256 hy = _mm256_mul_ps(_mm256_sub_ps(maxY, minY), half);
+    __m256 hz = _mm256_mul_ps(_mm256_sub_ps(maxZ, minZ), half);
+    auto project = [&](const Vec3& axis, __m256& value, __m256& extent) CPU_TARGET_AVX2 {
+        __m256 ax = _mm256_set1_ps(axis.x), ay = _mm256_set1_ps(axis.y), az = _mm256_set1_ps(axis.z);
+        value = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, ax), _mm256_mul_ps(cy, ay)), _mm256_mul_ps(cz, az));
+        extent = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, abs(ax)), _mm256_mul_ps(hy, abs(ay))), _mm256_mul_ps(hz, abs(az)));
+    };
+    __m256 x, y, z, ex, ey, ez;
+    project(query._Tangent, x, ex);
+    project(query._Bitangent, y, ey);
+    project(query._Normal, z, ez);
+
+    __m256 localMaxZ = _mm256_add_ps(z, ez);
+    __m256 localMinX = _mm256_max_ps(_mm256_sub_ps(abs(x), ex), zero);
+    __m256 localMinY = _mm256_max_ps(_mm256_sub_ps(abs(y), ey), zero);
+    __m256 length2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(localMinX, localMinX), _mm256_mul_ps(localMinY, localMinY)), _mm256_mul_ps(localMaxZ, localMaxZ));
+    __m256 intensity = _mm256_max_ps(intensityX, _mm256_max_ps(intensityY, intensityZ));
+    __m256 bound = _mm256_mul_ps(_mm256_mul_ps(intensity, _mm256_set1_ps(query._MaterialBound)), localMaxZ);
+    bound = _mm256_div_ps(bound, _mm256_mul_ps(_mm256_sqrt_ps(length2), dist2));
+
+    // cosine at the lights, see emitterCosineBound, skipped when no light of the batch is oriented
+    const __m256 one = _mm256_set1_ps(1.f);
+    __m256 isFullCone = _mm256_cmp_ps(cosCone, _mm256_set1_ps(-1.f), _CMP_LE_OQ);
+    if(_mm256_movemask_ps(isFullCone) != 0xff){
+        __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)), _mm256_mul_ps(cz, cz)));
+        __m256 radius = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(hx, hx), _mm256_mul_ps(hy, hy)), _mm256_mul_ps(hz, hz)));
+        __m256 sinBox = _mm256_div_ps(radius, distance);
+        __m256 cosBox = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(one, _mm256_mul_ps(sinBox, sinBox)), zero));
+        __m256 sinCone = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(one, _mm256_mul_ps(cosCone, cosCone)), zero));
+        __m256 cosSpread = _mm256_sub_ps(_mm256_mul_ps(cosCone, cosBox), _mm256_mul_ps(sinCone, sinBox));
+        __m256 sinSpread = _mm256_add_ps(_mm256_mul_ps(sinCone, cosBox), _mm256_mul_ps(cosCone, sinBox));
+        __m256 cosAxis = _mm256_div_ps(_mm256_sub_ps(zero, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(axisX, cx), _mm256_mul_ps(axisY, cy)), _mm256_mul_ps(axisZ, cz))), distance);
+        __m256 sinAxis = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(one, _mm256_mul_ps(cosAxis, cosAxis)), zero));
+        __m256 emitter = _mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(cosAxis, cosSpread), _mm256_mul_ps(sinAxis, sinSpread)), zero);
+        __m256 isInsideCone = _mm256_or_ps(
+            _mm256_or_ps(isFullCone, _mm256_cmp_ps(distance, radius, _CMP_LE_OQ)),
+            _mm256_or_ps(_mm256_cmp_ps(_mm256_add_ps(cosCone, cosBox), zero, _CMP_LT_OQ), _mm256_cmp_ps(cosAxis, cosSpread, _CMP_GE_OQ))
+        );
+        bound = _mm256_mul_ps(bound, _mm256_blendv_ps(emitter, one, isInsideCone));
+    }
+
+    // same priorities as the scalar kernel, the last blend wins
+    __m256 isLeaf = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_castps_si256(firstChild), _mm256_setzero_si256()));
+    bound = _mm256_blendv_ps(bound, zero, _mm256_cmp_ps(localMaxZ, zero, _CMP_LE_OQ));
+    bound = _mm256_blendv_ps(bound, _mm256_set1_ps(CPU_INFINITY), _mm256_cmp_ps(dist2, zero, _CMP_LE_OQ));
+    bound = _mm256_blendv_ps(bound, zero, isLeaf);
+
+    if(nbNodes == 8){
+        _mm256_storeu_ps(bounds, bound);
+    } else {
+        alignas(32) float result[8];
+        _mm256_store_ps(result, bound);
+        std::copy(result, result + nbNodes, bounds);
+    }
+}
+#endif
+
+// getNode(i) returns the i-th node of the batch
+template<typename GetNode>
+static void dispatchClusterErrorBounds(const GetNode& getNode, uint32_t nbNodes, const CpuBoundQuery& query, float* bounds){
+    CpuSimdLevel level = getSimdLevel();
+    uint32_t i = 0;
+    #if defined(CPU_BOUNDS_X86)
+        // missing nodes of a partial batch repeat the last one
+        auto getRows = [&](uint32_t first, uint32_t nbRows, const float** rows){
+            for(uint32_t r=0; r<nbRows; r++){
+                rows[r] = reinterpret_cast<const float*>(&getNode(std::min(first + r, nbNodes - 1)));
+            }
+        };
+    #endif
+    #if defined(CPU_BOUNDS_AVX2)
+        if(level >= CPU_SIMD_AVX2){
+            for(; i+4<nbNodes; i+=8){
+                const float* rows[8];
+                getRows(i, 8, rows);
+                clusterErrorBoundsAvx2(rows, std::min(8u, nbNodes - i), query, bounds + i);
+            }
+        }
+    #endif
+    #if defined(CPU_BOUNDS_X86)
+        // a pair of siblings is cheaper in scalar than in a half empty register
+        if(level >= CPU_SIMD_SSE){
+            for(; i+2<nbNodes; i+=4){
+                const float* rows[4];
+                getRows(i, 4, rows);
+                clusterErrorBoundsSse(rows, std::min(4u, nbNodes - i), query, bounds + i);
+            }
+        }
+    #endif
+    for(; i<nbNodes; i++){
+        bounds[i] = clusterErrorBoundScalar(getNode(i), query);
+    }
+}
+
+void clusterErrorBounds(const CpuLightTreeNode* nodes, uint32_t nbNodes, const CpuBoundQuery& query, float* bounds){
+    dispatchClusterErrorBounds([nodes](uint32_t i) -> const CpuLightTreeNode& {return nodes[i];}, nbNodes, query, bounds);
+}
+
+void clusterErrorBounds(const CpuLightTreeNode* const* nodes, uint32_t nbNodes, const CpuBoundQuery& query, float* bounds){
+    dispatchClusterErrorBounds([nodes](uint32_t i) -> const CpuLightTreeNode& {return *nodes[i];}, nbNodes, query, bounds);
+}
\ No newline at end of file
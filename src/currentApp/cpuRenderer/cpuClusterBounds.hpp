@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include "cpuLightTree.hpp"
+#include "cpuMath.hpp"
+
+enum CpuSimdLevel{
+    CPU_SIMD_SCALAR,
+    // 4 clusters per pass
+    CPU_SIMD_SSE,
+    // 8 clusters per pass
+    CPU_SIMD_AVX2,
+};
+
+// shading point seen by the error bounds, built once per cut
+struct CpuBoundQuery{
+    Vec3 _Position{};
+    // frame around the normal, the cosine bound is computed in it
+    Vec3 _Tangent{};
+    Vec3 _Bitangent{};
+    Vec3 _Normal{};
+    // max component of the brdf over every direction
+    float _MaterialBound = 0.f;
+
+    CpuBoundQuery(){};
+    CpuBoundQuery(const Vec3& position, const Vec3& normal, const Vec3& brdf)
+        : _Position(position), _Normal(normal), _MaterialBound(maxComponent(brdf)){
+        orthonormalBasis(normal, _Tangent, _Bitangent);
+    }
+    CpuBoundQuery(const Vec3& position, const Vec3& normal, float materialBound)
+        : _Position(position), _Normal(normal), _MaterialBound(materialBound){
+        orthonormalBasis(normal, _Tangent, _Bitangent);
+    }
+};
+
+// highest level supported by the cpu, detected once
+CpuSimdLevel getSupportedSimdLevel();
+CpuSimdLevel getSimdLevel();
+// clamped to the supported level, used to compare the kernels
+void setSimdLevel(CpuSimdLevel level);
+const char* getSimdLevelName(CpuSimdLevel level);
+
+// upper bound of the contribution of each cluster: intensity times material, cosine and distance bounds
+// leaves are evaluated exactly and get 0, clusters containing the point get an infinite bound
+void clusterErrorBounds(const CpuLightTreeNode* nodes, uint32_t nbNodes, const CpuBoundQuery& query, float* bounds);
+// same for nodes scattered in the tree
+void clusterErrorBounds(const CpuLightTreeNode* const* nodes, uint32_t nbNodes, const CpuBoundQuery& query, float* bounds);
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "cpuGatherTree.hpp"
+
+#include <algorithm>
+
+void CpuGatherTree::reserve(uint32_t nbPoints){
+    _Points.reserve(nbPoints);
+    _Indices.reserve(nbPoints);
+    _Nodes.reserve(std::max(1u, 2*nbPoints - 1));
+}
+
+void CpuGatherTree::clear(){
+    _Points.clear();
+    _Nodes.clear();
+    _Indices.clear();
+}
+
+void CpuGatherTree::build(){
+    _Nodes.clear();
+    _Indices.clear();
+    if(_Points.empty()) return;
+    for(uint32_t i=0; i<_Points.size(); i++){
+        _Indices.push_back(i);
+    }
+    _Nodes.emplace_back();
+    buildNode(0, 0, getNbPoints());
+}
+
+void CpuGatherTree::buildNode(uint32_t nodeId, uint32_t first, uint32_t last){
+    CpuGatherNode node{};
+    for(uint32_t i=first; i<last; i++){
+        const CpuGatherPoint& point = _Points[_Indices[i]];
+        node._BoundingBox.extend(point._Position);
+        node._Strength += point._Strength;
+    }
+    if(last - first == 1){
+        node._RepresentativePoint = _Indices[first];
+        _Nodes[nodeId] = node;
+        return;
+    }
+
+    Vec3 diagonal = node._BoundingBox.getDiagonal();
+    uint32_t axis = (diagonal.x >= diagonal.y && diagonal.x >= diagonal.z) ? 0 : (diagonal.y >= diagonal.z ? 1 : 2);
+    uint32_t middle = (first + last) / 2;
+    std::nth_element(_Indices.begin() + first, _Indices.begin() + middle, _Indices.begin() + last, [&](uint32_t a, uint32_t b){
+        return _Points[a]._Position[axis] < _Points[b]._Position[axis];
+    });
+
+    node._FirstChild = static_cast<uint32_t>(_Nodes.size());
+    _Nodes.emplace_back();
+    _Nodes.emplace_back();
+    buildNode(node._FirstChild, first, middle);
+    buildNode(node._FirstChild + 1, middle, last);
+    // the strongest child keeps its representative
+    const CpuGatherNode& left = _Nodes[node._FirstChild];
+    const CpuGatherNode& right = _Nodes[node._FirstChild + 1];
+    node._RepresentativePoint = maxComponent(left._Strength) >= maxComponent(right._Strength)
+        ? left._RepresentativePoint
+        : right._RepresentativePoint;
+    _Nodes[nodeId] = node;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "cpuMath.hpp"
+
+// bounce hit of a camera hit, the receiver side of a multidimensional cut
+struct CpuGatherPoint{
+    Vec3 _Position{};
+    Vec3 _Normal{};
+    // path throughput times brdf, only the geometric term and the light intensity are missing
+    Vec3 _Strength{0.f};
+};
+
+struct CpuGatherNode{
+    Aabb _BoundingBox{};
+    // sum of the strengths of the gather points in the cluster
+    Vec3 _Strength{0.f};
+    uint32_t _RepresentativePoint = 0;
+    // the right child follows the left one, 0 marks the leaves
+    uint32_t _FirstChild = 0;
+
+    bool isLeaf() const {return _FirstChild == 0;}
+};
+
+// binary tree over the gather points of a camera hit, the root is the first node
+// a tree is kept per thread and rebuilt in place for every camera hit
+class CpuGatherTree{
+
+    private:
+        std::vector<CpuGatherPoint> _Points{};
+        std::vector<CpuGatherNode> _Nodes{};
+        std::vector<uint32_t> _Indices{};
+
+    public:
+        CpuGatherTree(){};
+
+        void reserve(uint32_t nbPoints);
+        void clear();
+        void addPoint(const CpuGatherPoint& point){_Points.push_back(point);}
+        // median splits along the largest axis, there are few points per camera hit
+        void build();
+
+        bool empty() const {return _Nodes.empty();}
+        const CpuGatherNode& getNode(uint32_t id) const {return _Nodes[id];}
+        const CpuGatherPoint& getPoint(uint32_t id) const {return _Points[id];}
+        const CpuGatherPoint& getRepresentative(const CpuGatherNode& node) const {return _Points[node._RepresentativePoint];}
+        uint32_t getNbPoints() const {return static_cast<uint32_t>(_Points.size());}
+        // grows with any of the arrays
+        size_t getCapacity() const {return _Points.capacity() + _Nodes.capacity() + _Indices.capacity();}
+
+    private:
+        void buildNode(uint32_t nodeId, uint32_t first, uint32_t last);
+};
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "cpuImage.hpp"
+
+#include <cstdio>
+
+CpuImage::CpuImage(uint32_t width, uint32_t height)
+    : _Width(width), _Height(height), _Pixels(width*height, Vec3(0.f)){}
+
+bool CpuImage::savePPM(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if(file == nullptr){
+        fprintf(stderr, "Failed to open %s for writing!\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", _Width, _Height);
+    std::vector<uint8_t> bytes(_Pixels.size()*3);
+    for(size_t i=0; i<_Pixels.size(); i++){
+        for(uint32_t c=0; c<3; c++){
+            // gamma correct to match the swapchain srgb output
+            float value = std::pow(std::clamp(_Pixels[i][c], 0.f, 1.f), 1.f / 2.2f);
+            bytes[3*i + c] = static_cast<uint8_t>(value * 255.f + 0.5f);
+        }
+    }
+    size_t written = fwrite(bytes.data(), 1, bytes.size(), file);
+    bool success = (written == bytes.size());
+    success = (fclose(file) == 0) && success;
+    if(!success){
+        fprintf(stderr, "Failed to write the image %s!\n", path.c_str());
+    }
+    return success;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpuMath.hpp"
+
+class CpuImage;
+using CpuImagePtr = std::shared_ptr<CpuImage>;
+
+class CpuImage{
+
+    private:
+        uint32_t _Width = 0;
+        uint32_t _Height = 0;
+        std::vector<Vec3> _Pixels{};
+
+    public:
+        CpuImage(uint32_t width, uint32_t height);
+
+        uint32_t getWidth() const {return _Width;}
+        uint32_t getHeight() const {return _Height;}
+
+        const Vec3& getPixel(uint32_t x, uint32_t y) const {return _Pixels[y*_Width + x];}
+        void setPixel(uint32_t x, uint32_t y, const Vec3& color){_Pixels[y*_Width + x] = color;}
+
+        // write a binary ppm, returns false if the file can't be written
+        bool savePPM(const std::string& path) const;
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "cpuLightTree.hpp"
+#include "cpuMath.hpp"
+
+// entries of a cut refined together, the bounds of their 8 children fill one avx2 pass
+static const uint32_t CPU_CUT_REFINE_BATCH = 4;
+
+struct CpuCutEntry{
+    const CpuLightTreeNode* _Node = nullptr;
+    // contribution of the representative light without its intensity
+    Vec3 _RepresentativeContribution{0.f};
+    float _ErrorBound = 0.f;
+    // the shadow ray toward the representative light was blocked
+    bool _IsOccluded = false;
+
+    bool operator<(const CpuCutEntry& other) const {return _ErrorBound < other._ErrorBound;}
+};
+
+struct CpuDirectionalCutEntry{
+    const CpuDirectionalLightNode* _Node = nullptr;
+    // contribution of the representative light without its intensity
+    Vec3 _RepresentativeContribution{0.f};
+    float _ErrorBound = 0.f;
+
+    bool operator<(const CpuDirectionalCutEntry& other) const {return _ErrorBound < other._ErrorBound;}
+};
+
+// cluster of the cut of a sample pixel, read by the reconstruction of its neighbours
+struct CpuReconstructionCluster{
+    const CpuLightTreeNode* _Node = nullptr;
+    bool _IsOccluded = false;
+
+    // sorted on the node to be searched
+    bool operator<(const CpuReconstructionCluster& other) const {return _Node < other._Node;}
+};
+
+// pair of a gather cluster and a light cluster in a multidimensional cut
+struct CpuGatherCutEntry{
+    // in the gather tree of the camera hit
+    uint32_t _GatherNode = 0;
+    const CpuLightTreeNode* _LightNode = nullptr;
+    // geometric term and visibility between both representatives
+    Vec3 _RepresentativeContribution{0.f};
+    float _ErrorBound = 0.f;
+
+    bool operator<(const CpuGatherCutEntry& other) const {return _ErrorBound < other._ErrorBound;}
+};
+
+// max heap of the clusters of a cut on the error bound
+// one heap is kept per thread and cleared for every cut, so that the storage
+// reserved before the render is reused by every pixel
+template<typename Entry>
+class CpuCutHeap{
+
+    private:
+        std::vector<Entry> _Entries{};
+
+    public:
+        CpuCutHeap(){};
+
+        void reserve(size_t capacity){_Entries.reserve(capacity);}
+        void clear(){_Entries.clear();}
+
+        void push(const Entry& entry){
+            _Entries.push_back(entry);
+            std::push_heap(_Entries.begin(), _Entries.end());
+        }
+        void pop(){
+            std::pop_heap(_Entries.begin(), _Entries.end());
+            _Entries.pop_back();
+        }
+        const Entry& top() const {return _Entries.front();}
+
+        size_t size() const {return _Entries.size();}
+        bool empty() const {return _Entries.empty();}
+        size_t capacity() const {return _Entries.capacity();}
+
+        // clusters of the cut in heap order
+        typename std::vector<Entry>::const_iterator begin() const {return _Entries.begin();}
+        typename std::vector<Entry>::const_iterator end() const {return _Entries.end();}
+};
\ No newline at end of file
@@ -0,0 +1,671 @@
+#include "cpuLightTree.hpp"
+
+#include <algorithm>
+
+#include "cpuSampling.hpp"
+
+namespace{
+
+// node of the tree being built, children are indices in the build nodes
+struct BuildNode{
+    Aabb _BoundingBox{};
+    Vec3 _Intensity{0.f};
+    Cone _NormalCone{};
+    // every light of the cluster is oriented
+    bool _IsOriented = false;
+    uint32_t _RepresentativeLight = 0;
+    uint32_t _Left = UINT32_MAX;
+    uint32_t _Right = UINT32_MAX;
+};
+
+struct DirectionalBuildNode{
+    Vec3 _Intensity{0.f};
+    Cone _DirectionCone{};
+    uint32_t _RepresentativeLight = 0;
+    uint32_t _Left = UINT32_MAX;
+    uint32_t _Right = UINT32_MAX;
+};
+
+struct Cluster{
+    uint32_t _Node = 0;
+    bool _IsAlive = true;
+    uint32_t _BestPartner = 0;
+    float _BestCost = CPU_INFINITY;
+};
+
+// the orientation only enters the metric of oriented lights so that the trees
+// of scenes without them stay the same, mixed clusters get a full cone
+float mergeCost(const BuildNode& a, const BuildNode& b, float sceneDiagonal2){
+    Aabb box = a._BoundingBox;
+    box.extend(b._BoundingBox);
+    Vec3 intensity = a._Intensity + b._Intensity;
+    if(!a._IsOriented && !b._IsOriented) return CpuLightTree::clusterMetric(box, intensity);
+    Cone cone = (a._IsOriented && b._IsOriented) ? Cone::merge(a._NormalCone, b._NormalCone) : Cone{};
+    return CpuLightTree::clusterMetric(box, intensity, cone, sceneDiagonal2);
+}
+
+float mergeCost(const DirectionalBuildNode& a, const DirectionalBuildNode& b){
+    return CpuDirectionalLightTree::clusterMetric(Cone::merge(a._DirectionCone, b._DirectionCone), a._Intensity + b._Intensity);
+}
+
+template<typename Node, typename GetCost>
+void findBestPartner(const std::vector<Node>& nodes, std::vector<Cluster>& clusters, uint32_t id, const GetCost& getCost){
+    Cluster& cluster = clusters[id];
+    cluster._BestCost = CPU_INFINITY;
+    for(uint32_t i=0; i<clusters.size(); i++){
+        if(i == id || !clusters[i]._IsAlive) continue;
+        float cost = getCost(nodes[cluster._Node], nodes[clusters[i]._Node]);
+        if(cost < cluster._BestCost){
+            cluster._BestCost = cost;
+            cluster._BestPartner = i;
+        }
+    }
+}
+
+// greedy agglomerative clustering of the leaves at the start of nodes, returns the root
+template<typename Node, typename GetCost, typename MakeParent>
+uint32_t clusterGreedy(std::vector<Node>& nodes, const GetCost& getCost, const MakeParent& makeParent){
+    uint32_t nbLeaves = static_cast<uint32_t>(nodes.size());
+    nodes.reserve(2*nbLeaves - 1);
+    std::vector<Cluster> clusters(nbLeaves);
+    for(uint32_t i=0; i<nbLeaves; i++){
+        clusters[i]._Node = i;
+    }
+    for(uint32_t i=0; i<clusters.size(); i++){
+        findBestPartner(nodes, clusters, i, getCost);
+    }
+
+    uint32_t nbAlive = nbLeaves;
+    while(nbAlive > 1){
+        // cheapest pair
+        uint32_t a = 0;
+        float bestCost = CPU_INFINITY;
+        for(uint32_t i=0; i<clusters.size(); i++){
+            if(clusters[i]._IsAlive && clusters[i]._BestCost <= bestCost){
+                bestCost = clusters[i]._BestCost;
+                a = i;
+            }
+        }
+        uint32_t b = clusters[a]._BestPartner;
+
+        uint32_t parent = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(makeParent(nodes, clusters[a]._Node, clusters[b]._Node));
+
+        clusters[a]._Node = parent;
+        clusters[b]._IsAlive = false;
+        nbAlive--;
+        if(nbAlive == 1) break;
+
+        // update the nearest neighbour cache
+        findBestPartner(nodes, clusters, a, getCost);
+        for(uint32_t i=0; i<clusters.size(); i++){
+            if(i == a || !clusters[i]._IsAlive) continue;
+            if(clusters[i]._BestPartner == a || clusters[i]._BestPartner == b){
+                findBestPartner(nodes, clusters, i, getCost);
+                continue;
+            }
+            float cost = getCost(nodes[clusters[i]._Node], nodes[parent]);
+            if(cost < clusters[i]._BestCost){
+                clusters[i]._BestCost = cost;
+                clusters[i]._BestPartner = a;
+            }
+        }
+    }
+
+    for(const auto& cluster : clusters){
+        if(cluster._IsAlive) return cluster._Node;
+    }
+    return 0;
+}
+
+BuildNode createLeaf(const CpuPointLight& light, uint32_t id){
+    BuildNode leaf{};
+    leaf._BoundingBox.extend(light._Position);
+    leaf._Intensity = light.getIntensity();
+    leaf._IsOriented = light.isOriented();
+    if(leaf._IsOriented){
+        leaf._NormalCone._Axis = light._Normal;
+        leaf._NormalCone._Cosine = 1.f;
+    }
+    leaf._RepresentativeLight = id;
+    return leaf;
+}
+
+BuildNode createParent(const std::vector<BuildNode>& nodes, uint32_t left, uint32_t right, CpuRandom& rng){
+    BuildNode parent{};
+    parent._Left = left;
+    parent._Right = right;
+    parent._BoundingBox = nodes[left]._BoundingBox;
+    parent._BoundingBox.extend(nodes[right]._BoundingBox);
+    parent._Intensity = nodes[left]._Intensity + nodes[right]._Intensity;
+    parent._NormalCone = Cone::merge(nodes[left]._NormalCone, nodes[right]._NormalCone);
+    parent._IsOriented = nodes[left]._IsOriented && nodes[right]._IsOriented;
+    // representative picked with a probability proportional to the intensity
+    float leftWeight = maxComponent(nodes[left]._Intensity);
+    float totalWeight = leftWeight + maxComponent(nodes[right]._Intensity);
+    parent._RepresentativeLight = (rng.nextFloat() * totalWeight < leftWeight)
+        ? nodes[left]._RepresentativeLight
+        : nodes[right]._RepresentativeLight;
+    return parent;
+}
+
+// interleave the 10 lower bits of x, y and z
+uint32_t mortonCode(uint32_t x, uint32_t y, uint32_t z){
+    auto spread = [](uint32_t v){
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+// depth first layout, both children of a node are allocated together
+void flatten(const std::vector<BuildNode>& buildNodes, uint32_t root, 
+    std::vector<CpuLightTreeNode>& nodes, std::vector<CpuLightTreeNodeInfo>& nodesInfo){
+    nodes.clear();
+    nodesInfo.clear();
+    nodes.reserve(buildNodes.size());
+    nodesInfo.reserve(buildNodes.size());
+    nodes.emplace_back();
+    nodesInfo.emplace_back();
+
+    // pairs of build node and flat node
+    std::vector<std::pair<uint32_t, uint32_t>> stack{{root, 0}};
+    while(!stack.empty()){
+        auto [buildId, id] = stack.back();
+        stack.pop_back();
+        const BuildNode& buildNode = buildNodes[buildId];
+        nodes[id]._BoundingBox = buildNode._BoundingBox;
+        nodes[id]._Intensity = buildNode._Intensity;
+        nodes[id]._RepresentativeLight = buildNode._RepresentativeLight;
+        nodes[id]._NormalCone = buildNode._NormalCone;
+        if(buildNode._Left == UINT32_MAX) continue;
+
+        uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+        nodes[id]._FirstChild = firstChild;
+        nodes.resize(firstChild + 2);
+        nodesInfo.resize(firstChild + 2);
+        for(uint32_t i=0; i<2; i++){
+            nodesInfo[firstChild + i]._Parent = id;
+            nodesInfo[firstChild + i]._Depth = nodesInfo[id]._Depth + 1;
+        }
+        // the left subtree is laid out first
+        stack.push_back({buildNode._Right, firstChild + 1});
+        stack.push_back({buildNode._Left, firstChild});
+    }
+
+    // children are always stored after their parent
+    for(uint32_t id=static_cast<uint32_t>(nodes.size()); id-- > 0;){
+        if(nodes[id].isLeaf()) continue;
+        nodesInfo[id]._NbLights = nodesInfo[nodes[id]._FirstChild]._NbLights + nodesInfo[nodes[id]._FirstChild + 1]._NbLights;
+    }
+}
+
+}
+
+const char* CpuLightTree::getBuilderName(CpuLightTreeBuilder builder){
+    switch(builder){
+        case CPU_LIGHT_TREE_GREEDY:
+            return "greedy";
+        case CPU_LIGHT_TREE_LOCALLY_ORDERED:
+            return "locally ordered";
+    }
+    return "unknown";
+}
+
+uint32_t CpuLightTree::getMaxDepth() const {
+    // the freed pairs keep their last depth, which can only overestimate
+    uint32_t maxDepth = 0;
+    for(const auto& info : _NodesInfo){
+        maxDepth = std::max(maxDepth, info._Depth);
+    }
+    return maxDepth;
+}
+
+CpuLightTreePtr CpuLightTree::build(const std::vector<CpuPointLight>& lights, CpuLightTreeBuilder builder, uint64_t seed){
+    switch(builder){
+        case CPU_LIGHT_TREE_GREEDY:
+            return buildGreedy(lights, seed);
+        case CPU_LIGHT_TREE_LOCALLY_ORDERED:
+            return buildLocallyOrdered(lights, DEFAULT_SEARCH_RADIUS, seed);
+    }
+    return buildGreedy(lights, seed);
+}
+
+CpuLightTreePtr CpuLightTree::buildGreedy(const std::vector<CpuPointLight>& lights, uint64_t seed){
+    CpuLightTreePtr tree = CpuLightTreePtr(new CpuLightTree());
+    uint32_t nbLights = static_cast<uint32_t>(lights.size());
+    tree->_NbLights = nbLights;
+    if(lights.empty()){
+        tree->initUpdates(seed);
+        return tree;
+    }
+
+    // one leaf per light
+    std::vector<BuildNode> nodes{};
+    Aabb bounds{};
+    for(uint32_t i=0; i<nbLights; i++){
+        nodes.push_back(createLeaf(lights[i], i));
+        bounds.extend(lights[i]._Position);
+    }
+    float sceneDiagonal2 = bounds.getDiagonalLength2();
+
+    CpuRandom rng(seed);
+    uint32_t root = clusterGreedy(nodes, 
+        [sceneDiagonal2](const BuildNode& a, const BuildNode& b){return mergeCost(a, b, sceneDiagonal2);},
+        [&rng](const std::vector<BuildNode>& buildNodes, uint32_t left, uint32_t right){return createParent(buildNodes, left, right, rng);}
+    );
+    flatten(nodes, root, tree->_Nodes, tree->_NodesInfo);
+    tree->initUpdates(seed);
+    return tree;
+}
+
+CpuLightTreePtr CpuLightTree::buildLocallyOrdered(const std::vector<CpuPointLight>& lights, uint32_t searchRadius, uint64_t seed){
+    CpuLightTreePtr tree = CpuLightTreePtr(new CpuLightTree());
+    uint32_t nbLights = static_cast<uint32_t>(lights.size());
+    tree->_NbLights = nbLights;
+    if(lights.empty()){
+        tree->initUpdates(seed);
+        return tree;
+    }
+    searchRadius = std::max(1u, searchRadius);
+
+    // sort the lights along a morton curve so that neighbours in the array are close in space
+    Aabb bounds{};
+    for(const auto& light : lights){
+        bounds.extend(light._Position);
+    }
+    float sceneDiagonal2 = bounds.getDiagonalLength2();
+    Vec3 extent = bounds.getDiagonal();
+    Vec3 scale = {
+        extent.x > 0.f ? 1023.f / extent.x : 0.f,
+        extent.y > 0.f ? 1023.f / extent.y : 0.f,
+        extent.z > 0.f ? 1023.f / extent.z : 0.f,
+    };
+    std::vector<std::pair<uint32_t, uint32_t>> codes(nbLights);
+    #pragma omp parallel for
+    for(uint32_t i=0; i<nbLights; i++){
+        Vec3 p = (lights[i]._Position - bounds._Min) * scale;
+        codes[i] = {mortonCode(
+            static_cast<uint32_t>(p.x), 
+            static_cast<uint32_t>(p.y), 
+            static_cast<uint32_t>(p.z)
+        ), i};
+    }
+    std::sort(codes.begin(), codes.end());
+
+    // the leaves keep the index of their light, the parents follow
+    std::vector<BuildNode> nodes(2*nbLights - 1);
+    std::vector<uint32_t> clusters(nbLights);
+    #pragma omp parallel for
+    for(uint32_t i=0; i<nbLights; i++){
+        nodes[i] = createLeaf(lights[i], i);
+        clusters[i] = codes[i].second;
+    }
+
+    std::vector<uint32_t> neighbours(nbLights);
+    std::vector<uint32_t> parents(nbLights);
+    uint32_t nbNodes = nbLights;
+    while(clusters.size() > 1){
+        uint32_t nbClusters = static_cast<uint32_t>(clusters.size());
+
+        // cheapest neighbour within the radius, ties go to the lowest index so that
+        // the cheapest pair of the whole pass always agrees and every pass merges
+        #pragma omp parallel for schedule(static)
+        for(uint32_t i=0; i<nbClusters; i++){
+            uint32_t first = i > searchRadius ? i - searchRadius : 0;
+            uint32_t last = std::min(nbClusters - 1, i + searchRadius);
+            float bestCost = CPU_INFINITY;
+            uint32_t best = i;
+            for(uint32_t j=first; j<=last; j++){
+                if(j == i) continue;
+                float cost = mergeCost(nodes[clusters[i]], nodes[clusters[j]], sceneDiagonal2);
+                if(cost < bestCost){
+                    bestCost = cost;
+                    best = j;
+                }
+            }
+            neighbours[i] = best;
+        }
+
+        // mutual neighbours are merged into the slot of the first one
+        for(uint32_t i=0; i<nbClusters; i++){
+            uint32_t j = neighbours[i];
+            parents[i] = (i < j && neighbours[j] == i) ? nbNodes++ : UINT32_MAX;
+        }
+        #pragma omp parallel for schedule(static)
+        for(uint32_t i=0; i<nbClusters; i++){
+            if(parents[i] == UINT32_MAX) continue;
+            uint32_t left = clusters[i];
+            uint32_t right = clusters[neighbours[i]];
+            // seeded by the merged clusters so the tree does not depend on the threads
+            CpuRandom rng(seed ^ (static_cast<uint64_t>(nodes[left]._RepresentativeLight) << 32 | nodes[right]._RepresentativeLight));
+            nodes[parents[i]] = createParent(nodes, left, right, rng);
+        }
+
+        uint32_t nbRemaining = 0;
+        for(uint32_t i=0; i<nbClusters; i++){
+            uint32_t j = neighbours[i];
+            if(parents[i] != UINT32_MAX){
+                clusters[nbRemaining++] = parents[i];
+            } else if(neighbours[j] != i){
+                clusters[nbRemaining++] = clusters[i];
+            }
+        }
+        clusters.resize(nbRemaining);
+    }
+
+    flatten(nodes, clusters[0], tree->_Nodes, tree->_NodesInfo);
+    tree->initUpdates(seed);
+    return tree;
+}
+
+
+
+/********************************************************************/
+/*********************** INCREMENTAL UPDATES ************************/
+/********************************************************************/
+void CpuLightTree::initUpdates(uint64_t seed){
+    _LightLeaves.assign(_NbLights, 0);
+    _FreePairs.clear();
+    _Cost = 0.f;
+    for(uint32_t id=0; id<_Nodes.size(); id++){
+        if(_Nodes[id].isLeaf()){
+            _LightLeaves[_Nodes[id]._RepresentativeLight] = id;
+        } else {
+            _Cost += getNodeCost(id);
+        }
+    }
+    _BuildCost = getNormalizedCost();
+    _NbUpdates = 0;
+    _Rng = CpuRandom(seed);
+    _Seed = seed;
+}
+
+void CpuLightTree::addToCache(CpuCacheWriter& writer) const {
+    writer.addSection(_Nodes);
+    writer.addSection(_NodesInfo);
+    writer.addValue(_NbLights);
+    writer.addValue(_Seed);
+}
+
+CpuLightTreePtr CpuLightTree::loadFromCache(const CpuCacheReader& reader){
+    CpuLightTreePtr tree = CpuLightTreePtr(new CpuLightTree());
+    uint64_t seed = 0;
+    if(!reader.readSection(0, tree->_Nodes) 
+        || !reader.readSection(1, tree->_NodesInfo)
+        || !reader.readValue(2, tree->_NbLights)
+        || !reader.readValue(3, seed)){
+        return nullptr;
+    }
+    // a binary tree with one leaf per light
+    size_t nbNodes = tree->_NbLights > 0 ? 2 * static_cast<size_t>(tree->_NbLights) - 1 : 0;
+    if(tree->_Nodes.size() != nbNodes || tree->_NodesInfo.size() != nbNodes) return nullptr;
+    tree->initUpdates(seed);
+    return tree;
+}
+
+uint64_t CpuLightTree::getCacheKey(const std::vector<CpuPointLight>& lights, CpuLightTreeBuilder builder, uint64_t seed){
+    const uint64_t parameters[] = {
+        sizeof(CpuLightTreeNode), sizeof(CpuLightTreeNodeInfo), sizeof(CpuPointLight), 
+        static_cast<uint64_t>(builder), seed, DEFAULT_SEARCH_RADIUS
+    };
+    return hashVector(lights, hashBytes(parameters, sizeof(parameters)));
+}
+
+float CpuLightTree::getNodeCost(uint32_t id) const {
+    return _Nodes[id].isLeaf() ? 0.f : clusterMetric(_Nodes[id]._BoundingBox, _Nodes[id]._Intensity);
+}
+
+void CpuLightTree::pickRepresentative(uint32_t id){
+    const CpuLightTreeNode& left = getLeft(_Nodes[id]);
+    const CpuLightTreeNode& right = getRight(_Nodes[id]);
+    float leftWeight = maxComponent(left._Intensity);
+    float totalWeight = leftWeight + maxComponent(right._Intensity);
+    _Nodes[id]._RepresentativeLight = (_Rng.nextFloat() * totalWeight < leftWeight)
+        ? left._RepresentativeLight
+        : right._RepresentativeLight;
+}
+
+void CpuLightTree::refitAncestors(uint32_t id, uint32_t removedLight){
+    while(id != UINT32_MAX){
+        CpuLightTreeNode& node = _Nodes[id];
+        const CpuLightTreeNode& left = getLeft(node);
+        const CpuLightTreeNode& right = getRight(node);
+        _Cost -= getNodeCost(id);
+        node._BoundingBox = left._BoundingBox;
+        node._BoundingBox.extend(right._BoundingBox);
+        node._Intensity = left._Intensity + right._Intensity;
+        node._NormalCone = Cone::merge(left._NormalCone, right._NormalCone);
+        if(node._RepresentativeLight == removedLight){
+            pickRepresentative(id);
+        }
+        _Cost += getNodeCost(id);
+        _NodesInfo[id]._NbLights = _NodesInfo[node._FirstChild]._NbLights + _NodesInfo[node._FirstChild + 1]._NbLights;
+        id = _NodesInfo[id]._Parent;
+    }
+}
+
+void CpuLightTree::relinkNode(uint32_t id){
+    const CpuLightTreeNode& node = _Nodes[id];
+    if(node.isLeaf()){
+        _LightLeaves[node._RepresentativeLight] = id;
+        return;
+    }
+    _NodesInfo[node._FirstChild]._Parent = id;
+    _NodesInfo[node._FirstChild + 1]._Parent = id;
+}
+
+void CpuLightTree::shiftDepth(uint32_t id, int32_t offset){
+    std::vector<uint32_t> stack{id};
+    while(!stack.empty()){
+        uint32_t current = stack.back();
+        stack.pop_back();
+        _NodesInfo[current]._Depth += offset;
+        if(_Nodes[current].isLeaf()) continue;
+        stack.push_back(_Nodes[current]._FirstChild);
+        stack.push_back(_Nodes[current]._FirstChild + 1);
+    }
+}
+
+uint32_t CpuLightTree::allocatePair(){
+    if(!_FreePairs.empty()){
+        uint32_t pair = _FreePairs.back();
+        _FreePairs.pop_back();
+        return pair;
+    }
+    uint32_t pair = static_cast<uint32_t>(_Nodes.size());
+    _Nodes.resize(pair + 2);
+    _NodesInfo.resize(pair + 2);
+    return pair;
+}
+
+uint32_t CpuLightTree::insert(const CpuPointLight& light){
+    uint32_t lightId = _NbLights++;
+    _NbUpdates++;
+    CpuLightTreeNode leaf{};
+    leaf._BoundingBox.extend(light._Position);
+    leaf._Intensity = light.getIntensity();
+    if(light.isOriented()){
+        leaf._NormalCone._Axis = light._Normal;
+        leaf._NormalCone._Cosine = 1.f;
+    }
+    leaf._RepresentativeLight = lightId;
+    if(_Nodes.empty()){
+        _Nodes.push_back(leaf);
+        _NodesInfo.emplace_back();
+        _LightLeaves.push_back(0);
+        return lightId;
+    }
+
+    // branch and bound descent, pairing the light with a node costs the metric of the
+    // new cluster plus the growth of every ancestor, which only increases going down
+    auto getMergedCost = [&](const CpuLightTreeNode& node){
+        Aabb box = node._BoundingBox;
+        box.extend(leaf._BoundingBox);
+        return clusterMetric(box, node._Intensity + leaf._Intensity);
+    };
+    uint32_t sibling = 0;
+    float bestCost = getMergedCost(_Nodes[0]);
+    uint32_t current = 0;
+    float inheritedCost = 0.f;
+    while(!_Nodes[current].isLeaf()){
+        inheritedCost += getMergedCost(_Nodes[current]) - getNodeCost(current);
+        if(inheritedCost >= bestCost) break;
+        uint32_t left = _Nodes[current]._FirstChild;
+        float leftCost = getMergedCost(_Nodes[left]) + inheritedCost;
+        float rightCost = getMergedCost(_Nodes[left + 1]) + inheritedCost;
+        current = leftCost <= rightCost ? left : left + 1;
+        float cost = std::min(leftCost, rightCost);
+        if(cost < bestCost){
+            bestCost = cost;
+            sibling = current;
+        }
+    }
+
+    // the sibling moves to a new pair with the light and its slot becomes their parent
+    uint32_t pair = allocatePair();
+    _Nodes[pair] = _Nodes[sibling];
+    _Nodes[pair + 1] = leaf;
+    _NodesInfo[pair] = _NodesInfo[sibling];
+    _NodesInfo[pair]._Parent = sibling;
+    _NodesInfo[pair + 1]._Parent = sibling;
+    _NodesInfo[pair + 1]._Depth = _NodesInfo[sibling]._Depth + 1;
+    _NodesInfo[pair + 1]._NbLights = 1;
+    _LightLeaves.push_back(pair + 1);
+    relinkNode(pair);
+    shiftDepth(pair, 1);
+
+    CpuLightTreeNode& parent = _Nodes[sibling];
+    parent._FirstChild = pair;
+    parent._BoundingBox.extend(leaf._BoundingBox);
+    parent._Intensity = parent._Intensity + leaf._Intensity;
+    parent._NormalCone = Cone::merge(parent._NormalCone, leaf._NormalCone);
+    pickRepresentative(sibling);
+    _NodesInfo[sibling]._NbLights++;
+    _Cost += getNodeCost(sibling);
+    refitAncestors(_NodesInfo[sibling]._Parent);
+    return lightId;
+}
+
+void CpuLightTree::remove(uint32_t lightId){
+    _NbUpdates++;
+    uint32_t leaf = _LightLeaves[lightId];
+    if(leaf == 0){
+        // last light of the tree
+        _Nodes.clear();
+        _NodesInfo.clear();
+        _LightLeaves.clear();
+        _FreePairs.clear();
+        _NbLights = 0;
+        _Cost = 0.f;
+        return;
+    }
+
+    // the sibling takes the place of the parent
+    uint32_t parent = _NodesInfo[leaf]._Parent;
+    uint32_t pair = _Nodes[parent]._FirstChild;
+    uint32_t sibling = (leaf == pair) ? pair + 1 : pair;
+    _Cost -= getNodeCost(parent);
+    _Nodes[parent] = _Nodes[sibling];
+    _NodesInfo[parent]._NbLights = _NodesInfo[sibling]._NbLights;
+    relinkNode(parent);
+    if(!_Nodes[parent].isLeaf()){
+        shiftDepth(_Nodes[parent]._FirstChild, -1);
+        shiftDepth(_Nodes[parent]._FirstChild + 1, -1);
+    }
+    _FreePairs.push_back(pair);
+    refitAncestors(_NodesInfo[parent]._Parent, lightId);
+
+    // the last light takes the id of the removed one
+    uint32_t lastLight = _NbLights - 1;
+    if(lightId != lastLight){
+        uint32_t id = _LightLeaves[lastLight];
+        while(id != UINT32_MAX){
+            if(_Nodes[id]._RepresentativeLight == lastLight){
+                _Nodes[id]._RepresentativeLight = lightId;
+            }
+            id = _NodesInfo[id]._Parent;
+        }
+        _LightLeaves[lightId] = _LightLeaves[lastLight];
+    }
+    _LightLeaves.pop_back();
+    _NbLights--;
+}
+
+void CpuLightTree::update(uint32_t lightId, const CpuPointLight& light){
+    _NbUpdates++;
+    uint32_t leaf = _LightLeaves[lightId];
+    CpuLightTreeNode& node = _Nodes[leaf];
+    node._BoundingBox = Aabb{};
+    node._BoundingBox.extend(light._Position);
+    node._Intensity = light.getIntensity();
+    node._NormalCone = Cone{};
+    if(light.isOriented()){
+        node._NormalCone._Axis = light._Normal;
+        node._NormalCone._Cosine = 1.f;
+    }
+    refitAncestors(_NodesInfo[leaf]._Parent);
+}
+
+
+
+/********************************************************************/
+/************************ DIRECTIONAL LIGHTS ************************/
+/********************************************************************/
+CpuDirectionalLightTreePtr CpuDirectionalLightTree::build(const std::vector<CpuDirectionalLight>& lights, uint64_t seed){
+    CpuDirectionalLightTreePtr tree = CpuDirectionalLightTreePtr(new CpuDirectionalLightTree());
+    uint32_t nbLights = static_cast<uint32_t>(lights.size());
+    tree->_NbLights = nbLights;
+    if(lights.empty()) return tree;
+
+    std::vector<DirectionalBuildNode> nodes(nbLights);
+    for(uint32_t i=0; i<nbLights; i++){
+        nodes[i]._Intensity = lights[i].getIntensity();
+        nodes[i]._DirectionCone._Axis = normalize(lights[i]._Direction);
+        nodes[i]._DirectionCone._Cosine = 1.f;
+        nodes[i]._RepresentativeLight = i;
+    }
+
+    CpuRandom rng(seed);
+    uint32_t root = clusterGreedy(nodes, 
+        [](const DirectionalBuildNode& a, const DirectionalBuildNode& b){return mergeCost(a, b);},
+        [&rng](const std::vector<DirectionalBuildNode>& buildNodes, uint32_t left, uint32_t right){
+            DirectionalBuildNode parent{};
+            parent._Left = left;
+            parent._Right = right;
+            parent._Intensity = buildNodes[left]._Intensity + buildNodes[right]._Intensity;
+            parent._DirectionCone = Cone::merge(buildNodes[left]._DirectionCone, buildNodes[right]._DirectionCone);
+            float leftWeight = maxComponent(buildNodes[left]._Intensity);
+            float totalWeight = leftWeight + maxComponent(buildNodes[right]._Intensity);
+            parent._RepresentativeLight = (rng.nextFloat() * totalWeight < leftWeight)
+                ? buildNodes[left]._RepresentativeLight
+                : buildNodes[right]._RepresentativeLight;
+            return parent;
+        }
+    );
+
+    // same layout as the point light tree, siblings next to each other
+    tree->_Nodes.reserve(nodes.size());
+    tree->_Nodes.emplace_back();
+    std::vector<std::pair<uint32_t, uint32_t>> stack{{root, 0}};
+    while(!stack.empty()){
+        auto [buildId, id] = stack.back();
+        stack.pop_back();
+        const DirectionalBuildNode& buildNode = nodes[buildId];
+        tree->_Nodes[id]._Intensity = buildNode._Intensity;
+        tree->_Nodes[id]._DirectionCone = buildNode._DirectionCone;
+        tree->_Nodes[id]._RepresentativeLight = buildNode._RepresentativeLight;
+        if(buildNode._Left == UINT32_MAX) continue;
+
+        uint32_t firstChild = static_cast<uint32_t>(tree->_Nodes.size());
+        tree->_Nodes[id]._FirstChild = firstChild;
+        tree->_Nodes.resize(firstChild + 2);
+        stack.push_back({buildNode._Right, firstChild + 1});
+        stack.push_back({buildNode._Left, firstChild});
+    }
+    return tree;
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cpuCacheFile.hpp"
+#include "cpuMath.hpp"
+#include "cpuSampling.hpp"
+#include "cpuScene.hpp"
+
+enum CpuLightTreeBuilder{
+    // exact greedy clustering, quadratic in the number of lights
+    CPU_LIGHT_TREE_GREEDY,
+    // parallel locally ordered clustering of the lights sorted along a morton curve
+    CPU_LIGHT_TREE_LOCALLY_ORDERED,
+};
+
+class CpuLightTree;
+using CpuLightTreePtr = std::shared_ptr<CpuLightTree>;
+
+// fields read by the cut refinement, one node per cache line
+struct alignas(64) CpuLightTreeNode{
+    Aabb _BoundingBox{};
+    // sum of the intensities of the lights in the cluster
+    Vec3 _Intensity{0.f};
+    // index of the representative light in the scene point lights
+    uint32_t _RepresentativeLight = 0;
+    // the right child follows the left one, the root is never a child so 0 marks the leaves
+    uint32_t _FirstChild = 0;
+    // normals of the oriented lights, full as soon as one light emits in every direction
+    Cone _NormalCone{};
+
+    bool isLeaf() const {return _FirstChild == 0;}
+};
+
+// fields only needed to inspect or update the tree
+struct CpuLightTreeNodeInfo{
+    uint32_t _Parent = UINT32_MAX;
+    uint32_t _Depth = 0;
+    uint32_t _NbLights = 1;
+};
+
+// nodes are stored depth first with siblings next to each other, the root is the first node
+// after incremental updates siblings stay next to each other but the order is lost
+class CpuLightTree{
+
+    public:
+        // number of neighbours searched on each side along the morton curve
+        static const uint32_t DEFAULT_SEARCH_RADIUS = 16;
+        // the tree should be rebuilt once its cost went past this ratio of the one of its build
+        static constexpr float DEFAULT_REBUILD_THRESHOLD = 1.2f;
+
+    private:
+        std::vector<CpuLightTreeNode> _Nodes{};
+        std::vector<CpuLightTreeNodeInfo> _NodesInfo{};
+        uint32_t _NbLights = 0;
+
+        // leaf of every light
+        std::vector<uint32_t> _LightLeaves{};
+        // first node of the pairs of siblings freed by removals
+        std::vector<uint32_t> _FreePairs{};
+        // sum of the cluster metric of the internal nodes
+        float _Cost = 0.f;
+        // cost per unit of intensity right after the build
+        float _BuildCost = 0.f;
+        uint32_t _NbUpdates = 0;
+        // representatives of the clusters created by insertions
+        CpuRandom _Rng{};
+        uint64_t _Seed = 0;
+
+    public:
+        CpuLightTree(){};
+
+        const CpuLightTreeNode* getRoot() const {return _Nodes.empty() ? nullptr : &_Nodes[0];}
+        const CpuLightTreeNode& getNode(uint32_t id) const {return _Nodes[id];}
+        const CpuLightTreeNode& getLeft(const CpuLightTreeNode& node) const {return _Nodes[node._FirstChild];}
+        const CpuLightTreeNode& getRight(const CpuLightTreeNode& node) const {return _Nodes[node._FirstChild + 1];}
+        const CpuLightTreeNodeInfo& getNodeInfo(uint32_t id) const {return _NodesInfo[id];}
+        uint32_t getNodeId(const CpuLightTreeNode& node) const {return static_cast<uint32_t>(&node - _Nodes.data());}
+        uint32_t getNbLights() const {return _NbLights;}
+        uint32_t getNbNodes() const {return static_cast<uint32_t>(_Nodes.size());}
+        // bounds the stacks of the depth first walks
+        uint32_t getMaxDepth() const;
+        size_t getMemorySize() const {
+            return _Nodes.size() * (sizeof(CpuLightTreeNode) + sizeof(CpuLightTreeNodeInfo));
+        }
+        // lights inserted, removed or updated since the build
+        uint32_t getNbUpdates() const {return _NbUpdates;}
+        // cost per unit of total intensity, adding or brightening lights alone does not change it
+        float getNormalizedCost() const {
+            if(_Nodes.empty()) return 0.f;
+            const Vec3& intensity = _Nodes[0]._Intensity;
+            float totalIntensity = intensity.x + intensity.y + intensity.z;
+            return totalIntensity > 0.f ? _Cost / totalIntensity : 0.f;
+        }
+        // normalized cost of the tree over the one right after its build
+        float getCostRatio() const {
+            float cost = getNormalizedCost();
+            if(_BuildCost > 0.f) return cost / _BuildCost;
+            return cost > 0.f ? CPU_INFINITY : 1.f;
+        }
+
+        // incremental updates, the ids follow the ones of CpuScene: a new light takes the next id and
+        // the last light takes the id of a removed one, the tree must not be read during an update
+        // the new light is paired with the cluster that increases the cost of the tree the least
+        uint32_t insert(const CpuPointLight& light);
+        // the sibling of the light takes the place of their parent
+        void remove(uint32_t lightId);
+        // the light moved or changed, the clusters above it are refitted
+        void update(uint32_t lightId, const CpuPointLight& light);
+
+        // only trees that were not updated since their build are cached
+        void addToCache(CpuCacheWriter& writer) const;
+        // nullptr if the sections do not hold a light tree
+        static CpuLightTreePtr loadFromCache(const CpuCacheReader& reader);
+        // lights, builder and seed
+        static uint64_t getCacheKey(const std::vector<CpuPointLight>& lights, CpuLightTreeBuilder builder, uint64_t seed = 4242);
+
+        static CpuLightTreePtr build(const std::vector<CpuPointLight>& lights, CpuLightTreeBuilder builder, uint64_t seed = 4242);
+        // greedy agglomerative clustering, cheapest pair first
+        static CpuLightTreePtr buildGreedy(const std::vector<CpuPointLight>& lights, uint64_t seed = 4242);
+        // every pass merges in parallel the clusters that are each other's cheapest neighbour within the radius
+        static CpuLightTreePtr buildLocallyOrdered(const std::vector<CpuPointLight>& lights, 
+            uint32_t searchRadius = DEFAULT_SEARCH_RADIUS, 
+            uint64_t seed = 4242
+        );
+
+        static const char* getBuilderName(CpuLightTreeBuilder builder);
+
+    private:
+        // light leaves and cost of a tree that was just built
+        void initUpdates(uint64_t seed);
+        float getNodeCost(uint32_t id) const;
+        // recompute the bounds of id and its ancestors, a representative equal to removedLight is picked again
+        void refitAncestors(uint32_t id, uint32_t removedLight = UINT32_MAX);
+        void pickRepresentative(uint32_t id);
+        // the node moved to the slot id, its children or its light follow it
+        void relinkNode(uint32_t id);
+        void shiftDepth(uint32_t id, int32_t offset);
+        uint32_t allocatePair();
+
+    public:
+
+        // cluster metric from the lightcuts paper: intensity times squared diagonal
+        static float clusterMetric(const Aabb& box, const Vec3& intensity){
+            return (intensity.x + intensity.y + intensity.z) * box.getDiagonalLength2();
+        }
+        // clusters of oriented lights also pay for the spread of their normals, scaled by the size of the scene
+        static float clusterMetric(const Aabb& box, const Vec3& intensity, const Cone& cone, float sceneDiagonal2){
+            float spread = 1.f - cone._Cosine;
+            return (intensity.x + intensity.y + intensity.z) * (box.getDiagonalLength2() + sceneDiagonal2 * spread * spread);
+        }
+};
+
+
+
+class CpuDirectionalLightTree;
+using CpuDirectionalLightTreePtr = std::shared_ptr<CpuDirectionalLightTree>;
+
+struct CpuDirectionalLightNode{
+    // sum of the intensities of the lights in the cluster
+    Vec3 _Intensity{0.f};
+    // directions the lights of the cluster travel toward
+    Cone _DirectionCone{};
+    // index of the representative light in the scene directional lights
+    uint32_t _RepresentativeLight = 0;
+    // the right child follows the left one, 0 marks the leaves
+    uint32_t _FirstChild = 0;
+
+    bool isLeaf() const {return _FirstChild == 0;}
+};
+
+// directional lights have no position, they are clustered by direction only
+// the tree is built greedily, scenes only have a few of them
+class CpuDirectionalLightTree{
+
+    private:
+        std::vector<CpuDirectionalLightNode> _Nodes{};
+        uint32_t _NbLights = 0;
+
+    public:
+        CpuDirectionalLightTree(){};
+
+        const CpuDirectionalLightNode* getRoot() const {return _Nodes.empty() ? nullptr : &_Nodes[0];}
+        const CpuDirectionalLightNode& getLeft(const CpuDirectionalLightNode& node) const {return _Nodes[node._FirstChild];}
+        const CpuDirectionalLightNode& getRight(const CpuDirectionalLightNode& node) const {return _Nodes[node._FirstChild + 1];}
+        uint32_t getNbLights() const {return _NbLights;}
+        uint32_t getNbNodes() const {return static_cast<uint32_t>(_Nodes.size());}
+
+        static CpuDirectionalLightTreePtr build(const std::vector<CpuDirectionalLight>& lights, uint64_t seed = 4242);
+
+        // intensity times the squared sine of the half angle of the cone
+        static float clusterMetric(const Cone& cone, const Vec3& intensity){
+            return (intensity.x + intensity.y + intensity.z) * (1.f - cone._Cosine) * 0.5f;
+        }
+
+        // upper bound of the contribution of a cluster at a point, leaves are evaluated exactly and get 0
+        static float errorBound(const CpuDirectionalLightNode& node, const Vec3& normal, float materialBound){
+            if(node.isLeaf()) return 0.f;
+            // the lights are seen in the opposite direction of the one they travel toward
+            return maxComponent(node._Intensity) * materialBound * node._DirectionCone.maxCosine(-normal);
+        }
+};
\ No newline at end of file
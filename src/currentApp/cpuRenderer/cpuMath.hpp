@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// small math types for the cpu renderer, kept free of the engine
+// so that the headless mode does not need a vulkan device
+
+static const float CPU_PI = 3.14159265358979323846f;
+static const float CPU_INFINITY = std::numeric_limits<float>::infinity();
+
+struct Vec3{
+    float x = 0.f;
+    float y = 0.f;
+    float z = 0.f;
+
+    Vec3(){};
+    Vec3(float v) : x(v), y(v), z(v){};
+    Vec3(float vx, float vy, float vz) : x(vx), y(vy), z(vz){};
+
+    float operator[](uint32_t i) const {return i==0 ? x : (i==1 ? y : z);}
+    float& operator[](uint32_t i){return i==0 ? x : (i==1 ? y : z);}
+
+    Vec3 operator-() const {return {-x, -y, -z};}
+    Vec3& operator+=(const Vec3& v){x+=v.x; y+=v.y; z+=v.z; return *this;}
+    Vec3& operator-=(const Vec3& v){x-=v.x; y-=v.y; z-=v.z; return *this;}
+    Vec3& operator*=(float s){x*=s; y*=s; z*=s; return *this;}
+};
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b){return {a.x+b.x, a.y+b.y, a.z+b.z};}
+inline Vec3 operator-(const Vec3& a, const Vec3& b){return {a.x-b.x, a.y-b.y, a.z-b.z};}
+inline Vec3 operator*(const Vec3& a, const Vec3& b){return {a.x*b.x, a.y*b.y, a.z*b.z};}
+inline Vec3 operator/(const Vec3& a, const Vec3& b){return {a.x/b.x, a.y/b.y, a.z/b.z};}
+inline Vec3 operator*(const Vec3& a, float s){return {a.x*s, a.y*s, a.z*s};}
+inline Vec3 operator*(float s, const Vec3& a){return {a.x*s, a.y*s, a.z*s};}
+inline Vec3 operator/(const Vec3& a, float s){return a * (1.f/s);}
+
+inline float dot(const Vec3& a, const Vec3& b){return a.x*b.x + a.y*b.y + a.z*b.z;}
+inline Vec3 cross(const Vec3& a, const Vec3& b){
+    return {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+}
+inline float length2(const Vec3& a){return dot(a, a);}
+inline float length(const Vec3& a){return std::sqrt(dot(a, a));}
+inline Vec3 normalize(const Vec3& a){
+    float l = length(a);
+    return l > 0.f ? a / l : a;
+}
+inline Vec3 vmin(const Vec3& a, const Vec3& b){
+    return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+inline Vec3 vmax(const Vec3& a, const Vec3& b){
+    return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+inline float maxComponent(const Vec3& a){return std::max(a.x, std::max(a.y, a.z));}
+inline float luminance(const Vec3& a){return 0.2126f*a.x + 0.7152f*a.y + 0.0722f*a.z;}
+
+inline float radians(float degrees){return degrees * CPU_PI / 180.f;}
+
+// build an orthonormal basis around a normalized vector
+inline void orthonormalBasis(const Vec3& n, Vec3& t, Vec3& b){
+    float sign = std::copysign(1.f, n.z);
+    float a = -1.f / (sign + n.z);
+    float c = n.x * n.y * a;
+    t = {1.f + sign * n.x * n.x * a, sign * c, -sign * n.x};
+    b = {c, sign + n.y * n.y * a, -n.y};
+}
+
+
+struct Aabb{
+    Vec3 _Min{CPU_INFINITY};
+    Vec3 _Max{-CPU_INFINITY};
+
+    void extend(const Vec3& p){
+        _Min = vmin(_Min, p);
+        _Max = vmax(_Max, p);
+    }
+    void extend(const Aabb& box){
+        _Min = vmin(_Min, box._Min);
+        _Max = vmax(_Max, box._Max);
+    }
+    bool isEmpty() const {return _Min.x > _Max.x;}
+    Vec3 getDiagonal() const {return _Max - _Min;}
+    Vec3 getCenter() const {return (_Min + _Max) * 0.5f;}
+    float getDiagonalLength2() const {return isEmpty() ? 0.f : length2(getDiagonal());}
+    float getHalfArea() const {
+        if(isEmpty()) return 0.f;
+        Vec3 d = getDiagonal();
+        return d.x*d.y + d.y*d.z + d.z*d.x;
+    }
+
+    // squared distance from a point to the box, 0 if the point is inside
+    float distance2(const Vec3& p) const {
+        Vec3 d = vmax(vmax(_Min - p, p - _Max), Vec3(0.f));
+        return length2(d);
+    }
+    // squared distance between the closest points of two boxes, 0 if they overlap
+    float distance2(const Aabb& box) const {
+        Vec3 d = vmax(vmax(_Min - box._Max, box._Min - _Max), Vec3(0.f));
+        return length2(d);
+    }
+};
+
+
+// directions within an angle of the axis, the cosine of the angle is stored
+// an angle of pi covers every direction and leaves the axis unused
+struct Cone{
+    Vec3 _Axis{0.f};
+    float _Cosine = -1.f;
+
+    bool isFull() const {return _Cosine <= -1.f;}
+
+    // smallest cone around both cones, from "Importance Sampling of Many Lights with Adaptive Tree Splitting"
+    static Cone merge(const Cone& a, const Cone& b){
+        if(a.isFull() || b.isFull()) return Cone{};
+        // a is the widest
+        if(b._Cosine < a._Cosine) return merge(b, a);
+        float angleA = std::acos(std::clamp(a._Cosine, -1.f, 1.f));
+        float angleB = std::acos(std::clamp(b._Cosine, -1.f, 1.f));
+        float angleAxes = std::acos(std::clamp(dot(a._Axis, b._Axis), -1.f, 1.f));
+        if(std::min(angleAxes + angleB, CPU_PI) <= angleA) return a;
+
+        float angle = (angleA + angleAxes + angleB) * 0.5f;
+        if(angle >= CPU_PI) return Cone{};
+        // rotate the axis of a toward the one of b
+        Vec3 ortho = b._Axis - a._Axis * dot(a._Axis, b._Axis);
+        float orthoLength = length(ortho);
+        if(orthoLength <= 0.f) return Cone{};
+        float rotation = angle - angleA;
+        Cone cone{};
+        cone._Axis = normalize(a._Axis * std::cos(rotation) + ortho * (std::sin(rotation) / orthoLength));
+        cone._Cosine = std::cos(angle);
+        return cone;
+    }
+
+    // highest cosine between the axis v and a direction of the cone
+    float maxCosine(const Vec3& v) const {
+        if(isFull()) return 1.f;
+        float cosTheta = dot(_Axis, v);
+        if(cosTheta >= _Cosine) return 1.f;
+        // cos(theta - coneAngle)
+        float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta*cosTheta));
+        float sinCone = std::sqrt(std::max(0.f, 1.f - _Cosine*_Cosine));
+        return std::max(0.f, cosTheta * _Cosine + sinTheta * sinCone);
+    }
+};
+
+
+struct Ray{
+    Vec3 _Origin{};
+    Vec3 _Direction{0.f, 0.f, -1.f};
+    float _TMin = 1e-4f;
+    float _TMax = CPU_INFINITY;
+};
+
+
+// affine transform stored as the three first rows of a 4x4 matrix
+struct Matrix3x4{
+    float _M[3][4] = {
+        {1.f, 0.f, 0.f, 0.f},
+        {0.f, 1.f, 0.f, 0.f},
+        {0.f, 0.f, 1.f, 0.f},
+    };
+
+    Vec3 transformPoint(const Vec3& p) const {
+        return {
+            _M[0][0]*p.x + _M[0][1]*p.y + _M[0][2]*p.z + _M[0][3],
+            _M[1][0]*p.x + _M[1][1]*p.y + _M[1][2]*p.z + _M[1][3],
+            _M[2][0]*p.x + _M[2][1]*p.y + _M[2][2]*p.z + _M[2][3],
+        };
+    }
+
+    Vec3 transformVector(const Vec3& v) const {
+        return {
+            _M[0][0]*v.x + _M[0][1]*v.y + _M[0][2]*v.z,
+            _M[1][0]*v.x + _M[1][1]*v.y + _M[1][2]*v.z,
+            _M[2][0]*v.x + _M[2][1]*v.y + _M[2][2]*v.z,
+        };
+    }
+
+    // multiply by the transposed 3x3 part, used with the inverse model for normals
+    Vec3 transformTransposed(const Vec3& v) const {
+        return {
+            _M[0][0]*v.x + _M[1][0]*v.y + _M[2][0]*v.z,
+            _M[0][1]*v.x + _M[1][1]*v.y + _M[2][1]*v.z,
+            _M[0][2]*v.x + _M[1][2]*v.y + _M[2][2]*v.z,
+        };
+    }
+
+    Matrix3x4 operator*(const Matrix3x4& o) const {
+        Matrix3x4 res{};
+        for(int i=0; i<3; i++){
+            for(int j=0; j<4; j++){
+                res._M[i][j] = _M[i][0]*o._M[0][j] + _M[i][1]*o._M[1][j] + _M[i][2]*o._M[2][j];
+            }
+            res._M[i][3] += _M[i][3];
+        }
+        return res;
+    }
+
+    Matrix3x4 inverse() const {
+        const float (&m)[3][4] = _M;
+        float det =
+            m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+            - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+            + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+        float invDet = det != 0.f ? 1.f / det : 0.f;
+        Matrix3x4 res{};
+        res._M[0][0] =  (m[1][1]*m[2][2] - m[1][2]*m[2][1]) * invDet;
+        res._M[0][1] = -(m[0][1]*m[2][2] - m[0][2]*m[2][1]) * invDet;
+        res._M[0][2] =  (m[0][1]*m[1][2] - m[0][2]*m[1][1]) * invDet;
+        res._M[1][0] = -(m[1][0]*m[2][2] - m[1][2]*m[2][0]) * invDet;
+        res._M[1][1] =  (m[0][0]*m[2][2] - m[0][2]*m[2][0]) * invDet;
+        res._M[1][2] = -(m[0][0]*m[1][2] - m[0][2]*m[1][0]) * invDet;
+        res._M[2][0] =  (m[1][0]*m[2][1] - m[1][1]*m[2][0]) * invDet;
+        res._M[2][1] = -(m[0][0]*m[2][1] - m[0][1]*m[2][0]) * invDet;
+        res._M[2][2] =  (m[0][0]*m[1][1] - m[0][1]*m[1][0]) * invDet;
+        for(int i=0; i<3; i++){
+            res._M[i][3] = -(res._M[i][0]*m[0][3] + res._M[i][1]*m[1][3] + res._M[i][2]*m[2][3]);
+        }
+        return res;
+    }
+
+    static Matrix3x4 translation(const Vec3& t){
+        Matrix3x4 res{};
+        res._M[0][3] = t.x;
+        res._M[1][3] = t.y;
+        res._M[2][3] = t.z;
+        return res;
+    }
+
+    static Matrix3x4 scale(const Vec3& s){
+        Matrix3x4 res{};
+        res._M[0][0] = s.x;
+        res._M[1][1] = s.y;
+        res._M[2][2] = s.z;
+        return res;
+    }
+
+    static Matrix3x4 rotationX(float angle){
+        Matrix3x4 res{};
+        float c = std::cos(angle), s = std::sin(angle);
+        res._M[1][1] = c; res._M[1][2] = -s;
+        res._M[2][1] = s; res._M[2][2] = c;
+        return res;
+    }
+
+    static Matrix3x4 rotationY(float angle){
+        Matrix3x4 res{};
+        float c = std::cos(angle), s = std::sin(angle);
+        res._M[0][0] = c; res._M[0][2] = s;
+        res._M[2][0] = -s; res._M[2][2] = c;
+        return res;
+    }
+
+    static Matrix3x4 rotationZ(float angle){
+        Matrix3x4 res{};
+        float c = std::cos(angle), s = std::sin(angle);
+        res._M[0][0] = c; res._M[0][1] = -s;
+        res._M[1][0] = s; res._M[1][1] = c;
+        return res;
+    }
+};
+
+
+// same convention as be::Transform, angles in radians
+struct CpuTransform{
+    Vec3 _Position{0.f};
+    Vec3 _Rotation{0.f};
+    Vec3 _Scale{1.f};
+
+    Matrix3x4 getModel() const {
+        return Matrix3x4::translation(_Position)
+            * Matrix3x4::rotationY(_Rotation.y)
+            * Matrix3x4::rotationX(_Rotation.x)
+            * Matrix3x4::rotationZ(_Rotation.z)
+            * Matrix3x4::scale(_Scale);
+    }
+};
\ No newline at end of file
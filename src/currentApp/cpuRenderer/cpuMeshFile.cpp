@@ -0,0 +1,451 @@
+#include "cpuMeshFile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "cpuCacheFile.hpp"
+
+namespace{
+
+// lines are split by chunks of the file, a line belongs to the chunk holding its first character
+const size_t CHUNK_SIZE = 1 << 16;
+
+// a line without its surrounding blanks, empty lines and comments are skipped
+struct TextLine{
+    const char* _Begin = nullptr;
+    const char* _End = nullptr;
+};
+
+bool isBlank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool isDigit(char c){
+    return c >= '0' && c <= '9';
+}
+
+void skipBlanks(const char*& c, const char* end){
+    while(c < end && isBlank(*c)) c++;
+}
+
+std::vector<TextLine> splitLines(const std::string& text){
+    const char* data = text.data();
+    size_t size = text.size();
+    size_t nbChunks = std::max<size_t>(1, (size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<std::vector<TextLine>> chunks(nbChunks);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t chunk=0; chunk<nbChunks; chunk++){
+        size_t first = chunk * CHUNK_SIZE;
+        size_t last = std::min(size, first + CHUNK_SIZE);
+        // the line crossing the start of the chunk belongs to the previous one
+        if(first > 0){
+            const void* newLine = std::memchr(data + first - 1, '\n', size - first + 1);
+            first = newLine == nullptr ? size : static_cast<const char*>(newLine) - data + 1;
+        }
+        while(first < last){
+            const void* newLine = std::memchr(data + first, '\n', size - first);
+            const char* lineEnd = newLine == nullptr ? data + size : static_cast<const char*>(newLine);
+            const char* begin = data + first;
+            const char* end = lineEnd;
+            skipBlanks(begin, end);
+            while(end > begin && isBlank(end[-1])) end--;
+            if(begin < end && *begin != '#'){
+                chunks[chunk].push_back({begin, end});
+            }
+            first = lineEnd - data + 1;
+        }
+    }
+
+    size_t nbLines = 0;
+    for(const auto& chunkLines : chunks) nbLines += chunkLines.size();
+    std::vector<TextLine> lines{};
+    lines.reserve(nbLines);
+    for(const auto& chunkLines : chunks){
+        lines.insert(lines.end(), chunkLines.begin(), chunkLines.end());
+    }
+    return lines;
+}
+
+const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// decimal numbers are rebuilt from an integer mantissa and an exact power of ten in double precision
+// anything else, long mantissas, large exponents, inf or nan, goes through strtof
+// the text must be null terminated after the end of the line
+bool parseFloat(const char*& c, const char* end, float& value){
+    skipBlanks(c, end);
+    const char* start = c;
+    bool isNegative = false;
+    if(c < end && (*c == '-' || *c == '+')){
+        isNegative = *c == '-';
+        c++;
+    }
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    uint32_t nbDigits = 0;
+    bool hasDigits = false;
+    bool isExact = true;
+    auto addDigit = [&](char digit){
+        hasDigits = true;
+        if(nbDigits < 19){
+            mantissa = mantissa*10 + static_cast<uint64_t>(digit - '0');
+            // leading zeros don't count
+            if(mantissa != 0) nbDigits++;
+            return true;
+        }
+        isExact = isExact && digit == '0';
+        return false;
+    };
+    while(c < end && isDigit(*c)){
+        if(!addDigit(*c)) exponent++;
+        c++;
+    }
+    if(c < end && *c == '.'){
+        c++;
+        while(c < end && isDigit(*c)){
+            if(addDigit(*c)) exponent--;
+            c++;
+        }
+    }
+    if(hasDigits && c < end && (*c == 'e' || *c == 'E')){
+        const char* exponentStart = c;
+        c++;
+        bool isNegativeExponent = false;
+        if(c < end && (*c == '-' || *c == '+')){
+            isNegativeExponent = *c == '-';
+            c++;
+        }
+        if(c < end && isDigit(*c)){
+            int32_t explicitExponent = 0;
+            while(c < end && isDigit(*c)){
+                if(explicitExponent < 100000) explicitExponent = explicitExponent*10 + (*c - '0');
+                c++;
+            }
+            exponent += isNegativeExponent ? -explicitExponent : explicitExponent;
+        } else {
+            // the e is not part of the number
+            c = exponentStart;
+        }
+    }
+
+    if(hasDigits && isExact && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22){
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+        value = static_cast<float>(isNegative ? -result : result);
+        return true;
+    }
+
+    char* stop = nullptr;
+    value = std::strtof(start, &stop);
+    if(stop == start || stop > end){
+        c = start;
+        return false;
+    }
+    c = stop;
+    return true;
+}
+
+bool parseUint(const char*& c, const char* end, uint32_t& value){
+    skipBlanks(c, end);
+    if(c >= end || !isDigit(*c)) return false;
+    uint64_t result = 0;
+    while(c < end && isDigit(*c)){
+        result = result*10 + static_cast<uint64_t>(*c - '0');
+        if(result > UINT32_MAX) return false;
+        c++;
+    }
+    value = static_cast<uint32_t>(result);
+    return true;
+}
+
+bool parseInt(const char*& c, const char* end, int64_t& value){
+    skipBlanks(c, end);
+    bool isNegative = c < end && *c == '-';
+    if(c < end && (*c == '-' || *c == '+')) c++;
+    uint32_t magnitude = 0;
+    if(!parseUint(c, end, magnitude)) return false;
+    value = isNegative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+    return true;
+}
+
+bool parseVec3(const char*& c, const char* end, Vec3& value){
+    return parseFloat(c, end, value.x) && parseFloat(c, end, value.y) && parseFloat(c, end, value.z);
+}
+
+// the line starts with the keyword followed by a blank
+bool hasKeyword(const TextLine& line, const char* keyword){
+    size_t length = std::strlen(keyword);
+    return static_cast<size_t>(line._End - line._Begin) >= length
+        && std::memcmp(line._Begin, keyword, length) == 0
+        && (line._Begin + length == line._End || isBlank(line._Begin[length]));
+}
+
+uint32_t countTokens(const char* c, const char* end){
+    uint32_t nbTokens = 0;
+    while(c < end){
+        skipBlanks(c, end);
+        if(c == end) break;
+        nbTokens++;
+        while(c < end && !isBlank(*c)) c++;
+    }
+    return nbTokens;
+}
+
+enum ObjLineType : uint8_t{
+    OBJ_OTHER,
+    OBJ_VERTEX,
+    OBJ_FACE,
+};
+
+}
+
+bool parseOFF(const std::string& text, const std::string& path, CpuMesh& mesh){
+    std::vector<TextLine> lines = splitLines(text);
+    if(lines.empty() || lines[0]._End - lines[0]._Begin < 3 || std::memcmp(lines[0]._Begin, "OFF", 3) != 0){
+        fprintf(stderr, "The model %s is not a valid OFF file!\n", path.c_str());
+        return false;
+    }
+
+    // counts can be on the header line
+    auto parseCounts = [](const char* c, const char* end, uint32_t counts[3]){
+        return parseUint(c, end, counts[0]) && parseUint(c, end, counts[1]) && parseUint(c, end, counts[2]);
+    };
+    uint32_t counts[3] = {0, 0, 0};
+    size_t firstVertexLine = 1;
+    if(!parseCounts(lines[0]._Begin + 3, lines[0]._End, counts)){
+        if(lines.size() < 2 || !parseCounts(lines[1]._Begin, lines[1]._End, counts)){
+            fprintf(stderr, "The model %s has an invalid header!\n", path.c_str());
+            return false;
+        }
+        firstVertexLine = 2;
+    }
+    uint32_t nbVertices = counts[0];
+    uint32_t nbFaces = counts[1];
+    size_t firstFaceLine = firstVertexLine + nbVertices;
+    if(lines.size() < firstFaceLine){
+        fprintf(stderr, "The model %s has an invalid vertex %zu!\n", path.c_str(), lines.size() - firstVertexLine);
+        return false;
+    }
+    if(lines.size() < firstFaceLine + nbFaces){
+        fprintf(stderr, "The model %s has an invalid face %zu!\n", path.c_str(), lines.size() - firstFaceLine);
+        return false;
+    }
+
+    mesh = CpuMesh{};
+    mesh._Positions.resize(nbVertices);
+    uint32_t invalidVertex = UINT32_MAX;
+    #pragma omp parallel for reduction(min:invalidVertex)
+    for(uint32_t i=0; i<nbVertices; i++){
+        const TextLine& line = lines[firstVertexLine + i];
+        const char* c = line._Begin;
+        if(!parseVec3(c, line._End, mesh._Positions[i])) invalidVertex = std::min(invalidVertex, i);
+    }
+    if(invalidVertex != UINT32_MAX){
+        fprintf(stderr, "The model %s has an invalid vertex %u!\n", path.c_str(), invalidVertex);
+        return false;
+    }
+
+    // faces are fan triangulated, their first triangle is found from the number of vertices of the previous ones
+    // a face can't have more vertices than the characters of its line
+    std::vector<size_t> firstTriangles(nbFaces + 1, 0);
+    uint32_t invalidFace = UINT32_MAX;
+    #pragma omp parallel for reduction(min:invalidFace)
+    for(uint32_t i=0; i<nbFaces; i++){
+        const TextLine& line = lines[firstFaceLine + i];
+        const char* c = line._Begin;
+        uint32_t nbFaceVertices = 0;
+        if(!parseUint(c, line._End, nbFaceVertices) || nbFaceVertices > static_cast<size_t>(line._End - line._Begin)){
+            invalidFace = std::min(invalidFace, i);
+        } else {
+            firstTriangles[i+1] = nbFaceVertices > 2 ? nbFaceVertices - 2 : 0;
+        }
+    }
+    if(invalidFace == UINT32_MAX){
+        for(uint32_t i=0; i<nbFaces; i++){
+            firstTriangles[i+1] += firstTriangles[i];
+        }
+        mesh._Indices.resize(3*firstTriangles[nbFaces]);
+
+        #pragma omp parallel for reduction(min:invalidFace)
+        for(uint32_t i=0; i<nbFaces; i++){
+            const TextLine& line = lines[firstFaceLine + i];
+            const char* c = line._Begin;
+            uint32_t nbFaceVertices = 0;
+            parseUint(c, line._End, nbFaceVertices);
+            uint32_t* indices = mesh._Indices.data() + 3*firstTriangles[i];
+            uint32_t first = 0;
+            uint32_t previous = 0;
+            for(uint32_t j=0; j<nbFaceVertices; j++){
+                uint32_t index = 0;
+                if(!parseUint(c, line._End, index) || index >= nbVertices){
+                    invalidFace = std::min(invalidFace, i);
+                    break;
+                }
+                if(j == 0){
+                    first = index;
+                } else if(j >= 2){
+                    *indices++ = first;
+                    *indices++ = previous;
+                    *indices++ = index;
+                }
+                previous = index;
+            }
+        }
+    }
+    if(invalidFace != UINT32_MAX){
+        fprintf(stderr, "The model %s has an invalid face %u!\n", path.c_str(), invalidFace);
+        return false;
+    }
+    return true;
+}
+
+bool parseOBJ(const std::string& text, const std::string& path, CpuMesh& mesh){
+    std::vector<TextLine> lines = splitLines(text);
+    size_t nbLines = lines.size();
+
+    // only the positions and the faces are kept
+    std::vector<ObjLineType> types(nbLines, OBJ_OTHER);
+    std::vector<size_t> offsets(nbLines + 1, 0);
+    #pragma omp parallel for
+    for(size_t i=0; i<nbLines; i++){
+        if(hasKeyword(lines[i], "v")){
+            types[i] = OBJ_VERTEX;
+        } else if(hasKeyword(lines[i], "f")){
+            types[i] = OBJ_FACE;
+            uint32_t nbFaceVertices = countTokens(lines[i]._Begin + 1, lines[i]._End);
+            offsets[i] = nbFaceVertices > 2 ? nbFaceVertices - 2 : 0;
+        }
+    }
+
+    // vertices get their index and faces their first triangle
+    // faces only see the vertices defined before them
+    std::vector<uint32_t> nbPreviousVertices(nbLines, 0);
+    uint32_t nbVertices = 0;
+    size_t nbTriangles = 0;
+    for(size_t i=0; i<nbLines; i++){
+        if(types[i] == OBJ_VERTEX){
+            offsets[i] = nbVertices++;
+        } else if(types[i] == OBJ_FACE){
+            size_t nbFaceTriangles = offsets[i];
+            offsets[i] = nbTriangles;
+            nbTriangles += nbFaceTriangles;
+            nbPreviousVertices[i] = nbVertices;
+        }
+    }
+
+    mesh = CpuMesh{};
+    mesh._Positions.resize(nbVertices);
+    mesh._Indices.resize(3*nbTriangles);
+    size_t invalidVertex = SIZE_MAX;
+    size_t invalidFace = SIZE_MAX;
+    #pragma omp parallel for reduction(min:invalidVertex, invalidFace)
+    for(size_t i=0; i<nbLines; i++){
+        const char* c = lines[i]._Begin + 1;
+        const char* end = lines[i]._End;
+        if(types[i] == OBJ_VERTEX){
+            if(!parseVec3(c, end, mesh._Positions[offsets[i]])) invalidVertex = std::min(invalidVertex, i);
+        } else if(types[i] == OBJ_FACE){
+            uint32_t* indices = mesh._Indices.data() + 3*offsets[i];
+            int64_t nbDefined = nbPreviousVertices[i];
+            uint32_t first = 0;
+            uint32_t previous = 0;
+            for(uint32_t j=0; c<end; j++){
+                // only keep the position index of v/vt/vn
+                int64_t index = 0;
+                if(!parseInt(c, end, index) || (c < end && !isBlank(*c) && *c != '/')){
+                    invalidFace = std::min(invalidFace, i);
+                    break;
+                }
+                while(c < end && !isBlank(*c)) c++;
+                skipBlanks(c, end);
+                if(index < 0) index += nbDefined + 1;
+                if(index <= 0 || index > nbDefined){
+                    invalidFace = std::min(invalidFace, i);
+                    break;
+                }
+                uint32_t vertex = static_cast<uint32_t>(index - 1);
+                if(j == 0){
+                    first = vertex;
+                } else if(j >= 2){
+                    *indices++ = first;
+                    *indices++ = previous;
+                    *indices++ = vertex;
+                }
+                previous = vertex;
+            }
+        }
+    }
+    if(invalidVertex != SIZE_MAX){
+        fprintf(stderr, "The model %s has an invalid vertex!\n", path.c_str());
+        return false;
+    }
+    if(invalidFace != SIZE_MAX){
+        fprintf(stderr, "The model %s has an invalid face!\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+
+/********************************************************************/
+/****************************** BINARY ******************************/
+/********************************************************************/
+uint64_t getMeshBinaryKey(const std::string& path){
+    std::error_code error{};
+    uint64_t size = std::filesystem::file_size(path, error);
+    if(error) return 0;
+    auto time = std::filesystem::last_write_time(path, error);
+    if(error) return 0;
+    // models sharing a size and a date still get their own copy
+    std::string absolutePath = std::filesystem::absolute(path, error).lexically_normal().string();
+    if(error) return 0;
+    uint64_t values[2] = {size, static_cast<uint64_t>(time.time_since_epoch().count())};
+    uint64_t key = hashBytes(values, sizeof(values), hashBytes(absolutePath.data(), absolutePath.size()));
+    return key == 0 ? 1 : key;
+}
+
+bool loadMeshBinary(const std::string& path, uint64_t key, CpuMesh& mesh){
+    CpuCacheReader reader{};
+    if(!reader.open(path, CPU_CACHE_MESH, key)) return false;
+    CpuMesh loaded{};
+    bool isValid = reader.getNbSections() == 4
+        && reader.readSection(0, loaded._Positions)
+        && reader.readSection(1, loaded._Normals)
+        && reader.readSection(2, loaded._Indices)
+        && reader.readValue(3, loaded._BoundingBox)
+        && loaded._Normals.size() == loaded._Positions.size()
+        && loaded._Indices.size() % 3 == 0;
+    if(isValid){
+        uint32_t nbVertices = static_cast<uint32_t>(loaded._Positions.size());
+        size_t nbIndices = loaded._Indices.size();
+        uint32_t maxIndex = 0;
+        #pragma omp parallel for reduction(max:maxIndex)
+        for(size_t i=0; i<nbIndices; i++){
+            maxIndex = std::max(maxIndex, loaded._Indices[i]);
+        }
+        isValid = nbIndices == 0 || maxIndex < nbVertices;
+    }
+    if(!isValid){
+        fprintf(stderr, "The binary model %s is invalid, it will be rebuilt\n", path.c_str());
+        return false;
+    }
+    mesh = std::move(loaded);
+    return true;
+}
+
+bool saveMeshBinary(const std::string& path, uint64_t key, const CpuMesh& mesh, uint64_t maxDirectorySize){
+    CpuCacheWriter writer{};
+    writer.addSection(mesh._Positions);
+    writer.addSection(mesh._Normals);
+    writer.addSection(mesh._Indices);
+    writer.addValue(mesh._BoundingBox);
+    return writer.write(path, CPU_CACHE_MESH, key, maxDirectorySize);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "cpuScene.hpp"
+
+// text models already read in memory, the lines are split and parsed in parallel
+// return false and print the first invalid element if the model can't be parsed
+// the normals and the bounding box are left to the caller
+bool parseOFF(const std::string& text, const std::string& path, CpuMesh& mesh);
+bool parseOBJ(const std::string& text, const std::string& path, CpuMesh& mesh);
+
+// binary copy of a text model in the cache directory, it is memory mapped and copied without any parsing
+// the key changes with the path, the size and the modification time of the text model, 0 if it can't be read
+uint64_t getMeshBinaryKey(const std::string& path);
+// return false if the file is missing, stale or invalid
+bool loadMeshBinary(const std::string& path, uint64_t key, CpuMesh& mesh);
+bool saveMeshBinary(const std::string& path, uint64_t key, const CpuMesh& mesh, uint64_t maxDirectorySize);
\ No newline at end of file
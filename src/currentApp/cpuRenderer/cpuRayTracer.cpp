@@ -0,0 +1,1216 @@
+#include "cpuRayTracer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static const float SHADOW_EPSILON = 1e-3f;
+// adjacent instances are intersected in different object spaces, the tolerance closes the seams
+static const float BARYCENTRIC_EPSILON = 1e-5f;
+// distance used to test the visibility of directional lights
+static const float DIRECTIONAL_LIGHT_DISTANCE = 1e5f;
+// a sample is reused by a pixel on the same surface: same material, close normals and
+// a distance to the plane of the sample small relative to the distance to the camera
+static const float RECONSTRUCTION_MIN_COSINE = 0.9f;
+static const float RECONSTRUCTION_MAX_PLANE_DISTANCE = 0.02f;
+
+void CpuRenderStats::print() const {
+    fprintf(stdout, "BVH %s in %.3fs: %u bottom level nodes, %u top level nodes\n",
+        _IsBvhCached ? "loaded from the cache" : "built",
+        _BvhBuildTime, _NbBottomLevelNodes, _NbTopLevelNodes
+    );
+    if(_TopLevelRefitTime > 0.f){
+        fprintf(stdout, "Top level refit in %.3fms\n", _TopLevelRefitTime * 1000.f);
+    }
+    fprintf(stdout, "Light tree %s in %.3fs, %s builder: %u nodes, %.1f bytes per light\n", 
+        _IsLightTreeCached ? "loaded from the cache" : "built",
+        _LightTreeBuildTime, 
+        CpuLightTree::getBuilderName(_LightTreeBuilder),
+        _NbLightTreeNodes,
+        _NbLights > 0 ? static_cast<float>(_LightTreeMemory) / static_cast<float>(_NbLights) : 0.f
+    );
+    if(_NbLightTreeUpdates > 0){
+        fprintf(stdout, "Light tree updated in %.3fms: %u lights inserted, removed or moved, %.2fx its cost per unit of intensity since its last build\n",
+            _LightTreeUpdateTime * 1000.f, _NbLightTreeUpdates, _LightTreeCostRatio
+        );
+    }
+    if(_NbLightTreeRebuilds > 0){
+        fprintf(stdout, "Light tree rebuilt %u times by updates that made it too costly\n", _NbLightTreeRebuilds);
+    }
+    if(_NbVpls > 0){
+        fprintf(stdout, "Virtual point lights: %u generated in %.3fs\n", _NbVpls, _VplTime);
+    }
+    fprintf(stdout, "Rendered in %.3fs: %lu camera rays, %lu shadow rays\n",
+        _RenderTime,
+        static_cast<unsigned long>(_NbCameraRays.load()),
+        static_cast<unsigned long>(_NbShadowRays.load())
+    );
+    // rates are given per thread since the times are summed over every thread, and measured on the timed rays only
+    auto printRays = [](const char* name, uint64_t nbRays, uint64_t nbNodesVisited, uint64_t nbTimedRays, uint64_t time){
+        if(nbRays == 0) return;
+        fprintf(stdout, "%s: %lu rays, %.2f nodes visited per ray, %.2f Mrays/s per thread\n",
+            name,
+            static_cast<unsigned long>(nbRays),
+            static_cast<double>(nbNodesVisited) / static_cast<double>(nbRays),
+            time > 0 ? static_cast<double>(nbTimedRays) * 1e3 / static_cast<double>(time) : 0.
+        );
+    };
+    printRays("Camera and bounce rays", _NbRays, _NbNodesVisited, _NbTimedRays, _RayTime);
+    printRays("Shadow rays", _NbShadowRays, _NbShadowNodesVisited, _NbTimedShadowRays, _ShadowRayTime);
+    _Scheduler.print();
+    if(_NbCuts > 0){
+        fprintf(stdout, "Average cut size: %.2f, %.2f nodes evaluated per cut, %lu per-thread buffer growths while shading\n",
+            static_cast<double>(_TotalCutSize.load()) / static_cast<double>(_NbCuts.load()),
+            static_cast<double>(_NbCutNodesEvaluated.load()) / static_cast<double>(_NbCuts.load()),
+            static_cast<unsigned long>(_NbBufferGrowths.load())
+        );
+    }
+    if(_NbGatherCuts > 0){
+        fprintf(stdout, "Multidimensional cuts: average size of %.2f for %.2f gather points\n",
+            static_cast<double>(_TotalGatherCutSize.load()) / static_cast<double>(_NbGatherCuts.load()),
+            static_cast<double>(_NbGatherPoints.load()) / static_cast<double>(_NbGatherCuts.load())
+        );
+    }
+    if(_NbReconstructedPixels > 0){
+        fprintf(stdout, "Reconstruction cuts: %.1f%% of the camera rays shaded from their neighbouring samples\n",
+            100. * static_cast<double>(_NbReconstructedPixels.load()) / static_cast<double>(_NbCameraRays.load())
+        );
+    }
+}
+
+CpuRayTracer::CpuRayTracer(CpuScenePtr scene, uint32_t width, uint32_t height)
+    : _Scene(scene){
+    setResolution(width, height);
+}
+
+void CpuRayTracer::setResolution(uint32_t width, uint32_t height){
+    if(_Image != nullptr && width == _Width && height == _Height) return;
+    _Width = width;
+    _Height = height;
+    _Image = CpuImagePtr(new CpuImage(width, height));
+}
+
+void CpuRayTracer::initAccelerationStructure(){
+    auto start = std::chrono::high_resolution_clock::now();
+    const auto& geometries = _Scene->getGeometries();
+    _BottomLevelBvhs.assign(geometries.size(), nullptr);
+    _Stats._IsBvhCached = loadBottomLevelBvhs();
+    if(!_Stats._IsBvhCached){
+        #pragma omp parallel for schedule(dynamic)
+        for(size_t i=0; i<geometries.size(); i++){
+            _BottomLevelBvhs[i] = CpuBvh::build(geometries[i]._Triangles);
+        }
+        saveBottomLevelBvhs();
+    }
+
+    // a handful of instances, the top level is always rebuilt
+    std::vector<Aabb> instanceBoxes(_Scene->getInstances().size());
+    for(uint32_t i=0; i<instanceBoxes.size(); i++){
+        instanceBoxes[i] = _Scene->getInstanceBoundingBox(i);
+    }
+    _TopLevelBvh = CpuBvh::build(instanceBoxes);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    _Stats._BvhBuildTime = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+    _Stats._NbBottomLevelNodes = 0;
+    for(const auto& bvh : _BottomLevelBvhs){
+        _Stats._NbBottomLevelNodes += bvh->getNbNodes();
+    }
+    _Stats._NbTopLevelNodes = _TopLevelBvh->getNbNodes();
+}
+
+void CpuRayTracer::refitInstances(){
+    if(_TopLevelBvh == nullptr){
+        initAccelerationStructure();
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<Aabb> instanceBoxes(_Scene->getInstances().size());
+    for(uint32_t i=0; i<instanceBoxes.size(); i++){
+        instanceBoxes[i] = _Scene->getInstanceBoundingBox(i);
+    }
+    _TopLevelBvh->refit(instanceBoxes);
+    auto end = std::chrono::high_resolution_clock::now();
+    _Stats._TopLevelRefitTime = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+}
+
+uint64_t CpuRayTracer::getBvhCacheKey() const {
+    uint64_t key = 0;
+    for(const auto& geometry : _Scene->getGeometries()){
+        key = CpuBvh::getCacheKey(geometry._Triangles, key);
+    }
+    return key;
+}
+
+bool CpuRayTracer::loadBottomLevelBvhs(){
+    if(_CacheDirectory.empty()) return false;
+    const auto& geometries = _Scene->getGeometries();
+    uint64_t key = getBvhCacheKey();
+    CpuCacheReader reader{};
+    if(!reader.open(getCachePath(_CacheDirectory, CPU_CACHE_BVH, key), CPU_CACHE_BVH, key)) return false;
+    if(reader.getNbSections() != 2 * geometries.size()) return false;
+    for(uint32_t i=0; i<geometries.size(); i++){
+        _BottomLevelBvhs[i] = CpuBvh::loadFromCache(reader, 2*i, static_cast<uint32_t>(geometries[i]._Triangles.size()));
+        if(_BottomLevelBvhs[i] == nullptr) return false;
+    }
+    return true;
+}
+
+void CpuRayTracer::saveBottomLevelBvhs() const {
+    if(_CacheDirectory.empty()) return;
+    uint64_t key = getBvhCacheKey();
+    CpuCacheWriter writer{};
+    for(const auto& bvh : _BottomLevelBvhs){
+        bvh->addToCache(writer);
+    }
+    writer.write(getCachePath(_CacheDirectory, CPU_CACHE_BVH, key), CPU_CACHE_BVH, key, _CacheMaxSize);
+}
+
+bool CpuRayTracer::loadLightTree(){
+    if(_CacheDirectory.empty()) return false;
+    uint64_t key = CpuLightTree::getCacheKey(_Lights, _LightTreeBuilder);
+    CpuCacheReader reader{};
+    if(!reader.open(getCachePath(_CacheDirectory, CPU_CACHE_LIGHT_TREE, key), CPU_CACHE_LIGHT_TREE, key)) return false;
+    _LightTree = CpuLightTree::loadFromCache(reader);
+    return _LightTree != nullptr && _LightTree->getNbLights() == _Lights.size();
+}
+
+void CpuRayTracer::saveLightTree() const {
+    if(_CacheDirectory.empty()) return;
+    uint64_t key = CpuLightTree::getCacheKey(_Lights, _LightTreeBuilder);
+    CpuCacheWriter writer{};
+    _LightTree->addToCache(writer);
+    writer.write(getCachePath(_CacheDirectory, CPU_CACHE_LIGHT_TREE, key), CPU_CACHE_LIGHT_TREE, key, _CacheMaxSize);
+}
+
+void CpuRayTracer::initLights(bool useCache){
+    _Lights = _Scene->getPointLights();
+    _Stats._NbVpls = 0;
+    _Stats._VplTime = 0.f;
+    if(_UseVpls){
+        if(_TopLevelBvh == nullptr){
+            initAccelerationStructure();
+        }
+        auto vplStart = std::chrono::high_resolution_clock::now();
+        std::vector<CpuPointLight> vpls{};
+        generateVpls(vpls);
+        _Lights.insert(_Lights.end(), vpls.begin(), vpls.end());
+        auto vplEnd = std::chrono::high_resolution_clock::now();
+        _Stats._NbVpls = static_cast<uint32_t>(vpls.size());
+        _Stats._VplTime = std::chrono::duration<float, std::chrono::seconds::period>(vplEnd - vplStart).count();
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    _Stats._IsLightTreeCached = useCache && loadLightTree();
+    if(!_Stats._IsLightTreeCached){
+        _LightTree = CpuLightTree::build(_Lights, _LightTreeBuilder);
+        if(useCache) saveLightTree();
+    }
+    _DirectionalLightTree = CpuDirectionalLightTree::build(_Scene->getDirectionalLights());
+    auto end = std::chrono::high_resolution_clock::now();
+    _Stats._LightTreeBuildTime = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+    _Stats._LightTreeBuilder = _LightTreeBuilder;
+    _Stats._NbLightTreeNodes = _LightTree->getNbNodes();
+    _Stats._NbLights = _LightTree->getNbLights();
+    _Stats._LightTreeMemory = _LightTree->getMemorySize();
+    _Stats._LightTreeCostRatio = 1.f;
+}
+
+void CpuRayTracer::insertLight(){
+    if(_LightTree == nullptr || _UseVpls){
+        initLights();
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    _Lights.push_back(_Scene->getPointLights().back());
+    _LightTree->insert(_Lights.back());
+    auto end = std::chrono::high_resolution_clock::now();
+    finishLightTreeUpdate(std::chrono::duration<float, std::chrono::seconds::period>(end - start).count());
+}
+
+void CpuRayTracer::removeLight(uint32_t lightId){
+    if(_LightTree == nullptr || _UseVpls){
+        initLights();
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    _Lights[lightId] = _Lights.back();
+    _Lights.pop_back();
+    _LightTree->remove(lightId);
+    auto end = std::chrono::high_resolution_clock::now();
+    finishLightTreeUpdate(std::chrono::duration<float, std::chrono::seconds::period>(end - start).count());
+}
+
+void CpuRayTracer::refitLight(uint32_t lightId){
+    if(_LightTree == nullptr || _UseVpls){
+        initLights();
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    _Lights[lightId] = _Scene->getPointLights()[lightId];
+    _LightTree->update(lightId, _Lights[lightId]);
+    auto end = std::chrono::high_resolution_clock::now();
+    finishLightTreeUpdate(std::chrono::duration<float, std::chrono::seconds::period>(end - start).count());
+}
+
+void CpuRayTracer::finishLightTreeUpdate(float updateTime){
+    // the updates are counted across the rebuilds they trigger
+    _Stats._LightTreeUpdateTime += updateTime;
+    _Stats._NbLightTreeUpdates++;
+    if(_LightTree->getCostRatio() > _LightTreeRebuildThreshold){
+        _Stats._NbLightTreeRebuilds++;
+        initLights(false);
+        return;
+    }
+    _Stats._LightTreeCostRatio = _LightTree->getCostRatio();
+    _Stats._NbLights = _LightTree->getNbLights();
+    _Stats._NbLightTreeNodes = _LightTree->getNbNodes();
+    _Stats._LightTreeMemory = _LightTree->getMemorySize();
+}
+
+void CpuRayTracer::generateVpls(std::vector<CpuPointLight>& vpls){
+    const auto& lights = _Lights;
+    if(lights.empty() || _NbVplPaths == 0 || _VplBounces == 0) return;
+
+    // lights are picked proportionally to their power
+    std::vector<float> cdf(lights.size());
+    float totalPower = 0.f;
+    for(uint32_t i=0; i<lights.size(); i++){
+        Vec3 intensity = lights[i].getIntensity();
+        totalPower += intensity.x + intensity.y + intensity.z;
+        cdf[i] = totalPower;
+    }
+    if(totalPower <= 0.f) return;
+
+    // one slot per bounce of every path so the result does not depend on the threads
+    std::vector<CpuPointLight> slots(static_cast<size_t>(_NbVplPaths) * _VplBounces);
+    std::vector<uint8_t> isUsed(slots.size(), 0);
+    #pragma omp parallel
+    {
+        CpuRenderContext context{};
+        #pragma omp for schedule(dynamic, 64)
+        for(uint32_t path=0; path<_NbVplPaths; path++){
+            CpuRandom rng(path);
+            float u = rng.nextFloat() * totalPower;
+            uint32_t lightId = static_cast<uint32_t>(std::min<size_t>(
+                std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), lights.size()-1
+            ));
+            const CpuPointLight& light = lights[lightId];
+            Vec3 intensity = light.getIntensity();
+            // power of the light over its probability and the number of paths
+            Vec3 power = intensity * (4.f * CPU_PI * totalPower / ((intensity.x + intensity.y + intensity.z) * _NbVplPaths));
+
+            Ray ray{};
+            ray._Origin = light._Position;
+            ray._Direction = sampleUniformSphere(rng);
+            for(uint32_t bounce=0; bounce<_VplBounces; bounce++){
+                CpuHit hit{};
+                if(!intersect(ray, hit, context)) break;
+                Vec3 position, normal, geometricNormal;
+                getSurface(ray, hit, position, normal, geometricNormal);
+                const CpuMaterial& material = _Scene->getMaterials()[_Scene->getInstances()[hit._Instance]._MaterialId];
+                power = power * material._Albedo;
+                if(maxComponent(power) <= 0.f) break;
+
+                // lambert reflection of the power, the cosine around the normal is applied when shading
+                CpuPointLight& vpl = slots[static_cast<size_t>(path) * _VplBounces + bounce];
+                vpl._Position = position + geometricNormal * SHADOW_EPSILON;
+                vpl._Normal = normal;
+                vpl._Color = power * (_ShadingFactor / CPU_PI);
+                vpl._Intensity = 1.f;
+                isUsed[static_cast<size_t>(path) * _VplBounces + bounce] = 1;
+
+                // cosine sampling cancels the lambert pdf, the albedo is applied at the next hit
+                ray = Ray{};
+                ray._Origin = vpl._Position;
+                ray._Direction = sampleCosineHemisphere(normal, rng);
+            }
+        }
+    }
+
+    for(size_t i=0; i<slots.size(); i++){
+        if(isUsed[i]) vpls.push_back(slots[i]);
+    }
+}
+
+
+
+/********************************************************************/
+/*************************** INTERSECTIONS **************************/
+/********************************************************************/
+static bool intersectTriangle(const Ray& ray, const CpuTriangle& triangle, float& t, float& u, float& v){
+    // moller trumbore, back faces are culled like in the rasterizer
+    Vec3 e1 = triangle._V1 - triangle._V0;
+    Vec3 e2 = triangle._V2 - triangle._V0;
+    Vec3 p = cross(ray._Direction, e2);
+    float det = dot(e1, p);
+    if(det < 1e-12f) return false;
+    float invDet = 1.f / det;
+    Vec3 s = ray._Origin - triangle._V0;
+    u = dot(s, p) * invDet;
+    if(u < -BARYCENTRIC_EPSILON || u > 1.f + BARYCENTRIC_EPSILON) return false;
+    Vec3 q = cross(s, e1);
+    v = dot(ray._Direction, q) * invDet;
+    if(v < -BARYCENTRIC_EPSILON || u + v > 1.f + BARYCENTRIC_EPSILON) return false;
+    t = dot(e2, q) * invDet;
+    return t > ray._TMin && t < ray._TMax;
+}
+
+// same test without the barycentric coordinates, only the distance is needed
+static bool isTriangleHit(const Ray& ray, const CpuTriangle& triangle){
+    Vec3 e1 = triangle._V1 - triangle._V0;
+    Vec3 e2 = triangle._V2 - triangle._V0;
+    Vec3 p = cross(ray._Direction, e2);
+    float det = dot(e1, p);
+    if(det < 1e-12f) return false;
+    Vec3 s = ray._Origin - triangle._V0;
+    float u = dot(s, p);
+    if(u < -BARYCENTRIC_EPSILON*det || u > (1.f + BARYCENTRIC_EPSILON)*det) return false;
+    Vec3 q = cross(s, e1);
+    float v = dot(ray._Direction, q);
+    if(v < -BARYCENTRIC_EPSILON*det || u + v > (1.f + BARYCENTRIC_EPSILON)*det) return false;
+    float t = dot(e2, q);
+    // compare before the division
+    return t > ray._TMin*det && t < ray._TMax*det;
+}
+
+// the direction is not normalized so that distances are the same in both spaces
+static Ray toObjectSpace(const Ray& ray, const CpuMeshInstance& instance){
+    Ray objectRay = ray;
+    objectRay._Origin = instance._WorldToObject.transformPoint(ray._Origin);
+    objectRay._Direction = instance._WorldToObject.transformVector(ray._Direction);
+    return objectRay;
+}
+
+// reading the clock for every ray costs as much as a short traversal, only one ray out of RAY_TIMING_PERIOD is timed
+static const uint64_t RAY_TIMING_PERIOD = 64;
+
+bool CpuRayTracer::intersect(const Ray& ray, CpuHit& hit, CpuRenderContext& context) const {
+    bool isTimed = (context._NbRays++ % RAY_TIMING_PERIOD) == 0;
+    std::chrono::steady_clock::time_point start{};
+    if(isTimed) start = std::chrono::steady_clock::now();
+    const auto& instances = _Scene->getInstances();
+    const auto& geometries = _Scene->getGeometries();
+    Ray worldRay = ray;
+    _TopLevelBvh->traverse(worldRay, [&](uint32_t instanceId, Ray& r){
+        const CpuMeshInstance& instance = instances[instanceId];
+        const auto& triangles = geometries[instance._GeometryId]._Triangles;
+        Ray objectRay = toObjectSpace(r, instance);
+        bool isHit = _BottomLevelBvhs[instance._GeometryId]->traverse(objectRay, [&](uint32_t i, Ray& o){
+            float t, u, v;
+            if(!intersectTriangle(o, triangles[i], t, u, v)) return false;
+            o._TMax = t;
+            hit = {._T = t, ._Instance = instanceId, ._Triangle = i, ._U = u, ._V = v};
+            return true;
+        }, context._NbNodesVisited);
+        r._TMax = objectRay._TMax;
+        return isHit;
+    }, context._NbNodesVisited);
+    if(isTimed){
+        auto end = std::chrono::steady_clock::now();
+        context._RayTime += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        context._NbTimedRays++;
+    }
+    return hit.isValid();
+}
+
+bool CpuRayTracer::isOccluded(const Vec3& origin, const Vec3& target, CpuRenderContext& context) const {
+    bool isTimed = (context._NbShadowRays++ % RAY_TIMING_PERIOD) == 0;
+    std::chrono::steady_clock::time_point start{};
+    if(isTimed) start = std::chrono::steady_clock::now();
+    Ray ray{};
+    ray._Origin = origin;
+    ray._Direction = target - origin;
+    ray._TMin = 0.f;
+    ray._TMax = 1.f - SHADOW_EPSILON;
+    const auto& instances = _Scene->getInstances();
+    const auto& geometries = _Scene->getGeometries();
+    bool isHit = _TopLevelBvh->traverseAny(ray, [&](uint32_t instanceId, const Ray& r){
+        const CpuMeshInstance& instance = instances[instanceId];
+        const auto& triangles = geometries[instance._GeometryId]._Triangles;
+        return _BottomLevelBvhs[instance._GeometryId]->traverseAny(toObjectSpace(r, instance), [&](uint32_t i, const Ray& o){
+            return isTriangleHit(o, triangles[i]);
+        }, context._NbShadowNodesVisited);
+    }, context._NbShadowNodesVisited);
+    if(isTimed){
+        auto end = std::chrono::steady_clock::now();
+        context._ShadowRayTime += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        context._NbTimedShadowRays++;
+    }
+    return isHit;
+}
+
+
+
+/********************************************************************/
+/****************************** SHADING *****************************/
+/********************************************************************/
+Ray CpuRayTracer::generateCameraRay(uint32_t x, uint32_t y, uint32_t sample, CpuRandom& rng) const {
+    const CpuCamera& camera = _Scene->getCamera();
+    Vec3 forward = normalize(camera._At - camera._Eye);
+    Vec3 right = normalize(cross(forward, camera._Up));
+    Vec3 up = cross(right, forward);
+
+    // subpixel jitter only when several samples are used
+    float jx = 0.5f, jy = 0.5f;
+    if(sample > 0 || _SamplesPerPixels > 1){
+        jx = rng.nextFloat();
+        jy = rng.nextFloat();
+    }
+    float tanHalfFov = std::tan(radians(camera._Fov) / 2.f);
+    float aspect = static_cast<float>(_Width) / static_cast<float>(_Height);
+    float px = (2.f * (x + jx) / _Width - 1.f) * aspect * tanHalfFov;
+    float py = (1.f - 2.f * (y + jy) / _Height) * tanHalfFov;
+
+    Ray ray{};
+    ray._Origin = camera._Eye;
+    ray._Direction = normalize(forward + right*px + up*py);
+    return ray;
+}
+
+float CpuRayTracer::getGeometricTerm(const CpuPointLight& light, const Vec3& position, const Vec3& normal) const {
+    Vec3 toLight = light._Position - position;
+    float dist2 = length2(toLight);
+    float invDist = 1.f / std::sqrt(dist2);
+    float cosTheta = dot(normal, toLight) * invDist;
+    if(cosTheta <= 0.f) return 0.f;
+    if(!light.isOriented()) return cosTheta / dist2;
+    float cosLight = -dot(light._Normal, toLight) * invDist;
+    if(cosLight <= 0.f) return 0.f;
+    return std::min(cosTheta * cosLight / dist2, _VplClamp);
+}
+
+Vec3 CpuRayTracer::evaluateLight(const CpuPointLight& light, const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context, bool* isOccluded) const {
+    float geometricTerm = getGeometricTerm(light, position, normal);
+    if(geometricTerm <= 0.f) return Vec3(0.f);
+    if(this->isOccluded(position, light._Position, context)){
+        if(isOccluded != nullptr) *isOccluded = true;
+        return Vec3(0.f);
+    }
+    return brdf.evaluate(light._Position - position) * geometricTerm;
+}
+
+Vec3 CpuRayTracer::evaluateLight(const CpuDirectionalLight& light, const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context) const {
+    float cosTheta = -dot(normal, light._Direction);
+    if(cosTheta <= 0.f) return Vec3(0.f);
+    if(isOccluded(position, position - light._Direction * DIRECTIONAL_LIGHT_DISTANCE, context)) return Vec3(0.f);
+    return brdf.evaluate(-light._Direction) * cosTheta;
+}
+
+Vec3 CpuRayTracer::shadeDirectional(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context){
+    if(_UseLightCuts && _DirectionalLightTree != nullptr && _DirectionalLightTree->getNbLights() > 1){
+        return shadeDirectionalLightcuts(position, normal, brdf, context);
+    }
+    Vec3 color{0.f};
+    for(const auto& light : _Scene->getDirectionalLights()){
+        color += light.getIntensity() * evaluateLight(light, position, normal, brdf, context);
+    }
+    return color;
+}
+
+Vec3 CpuRayTracer::shadeDirectionalLightcuts(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context){
+    const auto& lights = _Scene->getDirectionalLights();
+    float materialBound = brdf.getUpperBound();
+    auto makeEntry = [&](const CpuDirectionalLightNode* node, const CpuDirectionalCutEntry* parent){
+        CpuDirectionalCutEntry entry{};
+        entry._Node = node;
+        entry._ErrorBound = CpuDirectionalLightTree::errorBound(*node, normal, materialBound);
+        if(parent != nullptr && parent->_Node->_RepresentativeLight == node->_RepresentativeLight){
+            entry._RepresentativeContribution = parent->_RepresentativeContribution;
+        } else {
+            entry._RepresentativeContribution = evaluateLight(lights[node->_RepresentativeLight], position, normal, brdf, context);
+        }
+        return entry;
+    };
+
+    CpuCutHeap<CpuDirectionalCutEntry>& cut = context._DirectionalCut;
+    cut.clear();
+    const CpuDirectionalLightNode* root = _DirectionalLightTree->getRoot();
+    cut.push(makeEntry(root, nullptr));
+    Vec3 total = root->_Intensity * cut.top()._RepresentativeContribution;
+    while(cut.size() < _LightcutsMaxClusters){
+        const CpuDirectionalCutEntry top = cut.top();
+        if(top._ErrorBound <= _LightcutsErrorThreshold * maxComponent(total) || top._Node->isLeaf()) break;
+        cut.pop();
+        CpuDirectionalCutEntry left = makeEntry(&_DirectionalLightTree->getLeft(*top._Node), &top);
+        CpuDirectionalCutEntry right = makeEntry(&_DirectionalLightTree->getRight(*top._Node), &top);
+        total += left._Node->_Intensity * left._RepresentativeContribution
+            + right._Node->_Intensity * right._RepresentativeContribution
+            - top._Node->_Intensity * top._RepresentativeContribution;
+        cut.push(left);
+        cut.push(right);
+    }
+    return vmax(total, Vec3(0.f));
+}
+
+Vec3 CpuRayTracer::shadeDirect(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context){
+    Vec3 color{0.f};
+    for(const auto& light : _Lights){
+        color += light.getIntensity() * evaluateLight(light, position, normal, brdf, context);
+    }
+    return color;
+}
+
+Vec3 CpuRayTracer::shadeDirectLightcuts(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context, bool isSeeded,
+        std::vector<CpuReconstructionCluster>* reconstructionCut){
+    const auto& lights = _Lights;
+    const CpuLightTreeNode* root = _LightTree->getRoot();
+    if(root == nullptr) return Vec3(0.f);
+
+    CpuBoundQuery query(position, normal, brdf.getUpperBound());
+    float bounds[2*CPU_CUT_REFINE_BATCH];
+    const CpuLightTreeNode* children[2*CPU_CUT_REFINE_BATCH];
+
+    auto makeEntry = [&](const CpuLightTreeNode* node, const CpuCutEntry* parent, float errorBound){
+        CpuCutEntry entry{};
+        entry._Node = node;
+        // the representative is shared with one of the children, reuse its visibility
+        if(parent != nullptr && parent->_Node->_RepresentativeLight == node->_RepresentativeLight){
+            entry._RepresentativeContribution = parent->_RepresentativeContribution;
+            entry._IsOccluded = parent->_IsOccluded;
+        } else {
+            entry._RepresentativeContribution = evaluateLight(
+                lights[node->_RepresentativeLight], position, normal, brdf, context, &entry._IsOccluded
+            );
+        }
+        entry._ErrorBound = errorBound;
+        return entry;
+    };
+    auto getEstimate = [](const CpuCutEntry& entry){
+        return entry._Node->_Intensity * entry._RepresentativeContribution;
+    };
+
+    // the cut starts from the one of the previous pixel, or from the root
+    const CpuLightTreeNode* const* seed = &root;
+    uint32_t nbSeedNodes = 1;
+    if(isSeeded && !context._PreviousCut.empty()){
+        seed = context._PreviousCut.data();
+        nbSeedNodes = static_cast<uint32_t>(context._PreviousCut.size());
+    }
+    std::vector<float>& seedBounds = context._SeedBounds;
+    seedBounds.resize(nbSeedNodes);
+    clusterErrorBounds(seed, nbSeedNodes, query, seedBounds.data());
+    context._NbCutNodesEvaluated += nbSeedNodes;
+
+    std::vector<CpuCutEntry>& entries = context._SeedEntries;
+    entries.clear();
+    Vec3 total{0.f};
+    for(uint32_t i=0; i<nbSeedNodes; i++){
+        entries.push_back(makeEntry(seed[i], nullptr, seedBounds[i]));
+        total += getEstimate(entries.back());
+    }
+
+    // coarsen the seed by one level where both children are in the cut and their parent is
+    // precise enough, the seed is sorted so siblings are next to each other
+    std::vector<const CpuLightTreeNode*>& parents = context._SeedParents;
+    std::vector<uint32_t>& pairs = context._SeedPairs;
+    parents.clear();
+    pairs.clear();
+    for(uint32_t i=0; i+1<nbSeedNodes; i++){
+        if(seed[i+1] != seed[i] + 1) continue;
+        const CpuLightTreeNode& parent = _LightTree->getNode(_LightTree->getNodeInfo(_LightTree->getNodeId(*seed[i]))._Parent);
+        if(&_LightTree->getLeft(parent) != seed[i]) continue;
+        parents.push_back(&parent);
+        pairs.push_back(i);
+        i++;
+    }
+    if(!parents.empty()){
+        seedBounds.resize(parents.size());
+        clusterErrorBounds(parents.data(), static_cast<uint32_t>(parents.size()), query, seedBounds.data());
+        context._NbCutNodesEvaluated += parents.size();
+        for(uint32_t k=0; k<parents.size(); k++){
+            if(seedBounds[k] > _LightcutsErrorThreshold * maxComponent(total)) continue;
+            CpuCutEntry& left = entries[pairs[k]];
+            CpuCutEntry& right = entries[pairs[k]+1];
+            CpuCutEntry parent{};
+            parent._Node = parents[k];
+            const CpuCutEntry& representative = (parents[k]->_RepresentativeLight == left._Node->_RepresentativeLight) ? left : right;
+            parent._RepresentativeContribution = representative._RepresentativeContribution;
+            parent._IsOccluded = representative._IsOccluded;
+            parent._ErrorBound = seedBounds[k];
+            total += getEstimate(parent) - getEstimate(left) - getEstimate(right);
+            left = parent;
+            // removed once the heap is filled
+            right._Node = nullptr;
+        }
+    }
+
+    CpuCutHeap<CpuCutEntry>& cut = context._Cut;
+    cut.clear();
+    for(const auto& entry : entries){
+        if(entry._Node != nullptr) cut.push(entry);
+    }
+
+    CpuCutEntry refined[CPU_CUT_REFINE_BATCH];
+    while(cut.size() < _LightcutsMaxClusters){
+        // every entry above the threshold is refined at once, up to the batch size,
+        // so the bounds of their children come from a single simd pass
+        float threshold = _LightcutsErrorThreshold * maxComponent(total);
+        size_t maxRefined = std::min<size_t>(CPU_CUT_REFINE_BATCH, _LightcutsMaxClusters - cut.size());
+        uint32_t nbRefined = 0;
+        while(nbRefined < maxRefined && !cut.empty()){
+            const CpuCutEntry& top = cut.top();
+            // the heap is ordered by bound, every other entry is at or below a leaf
+            if(top._ErrorBound <= threshold || top._Node->isLeaf()) break;
+            refined[nbRefined] = top;
+            children[2*nbRefined] = &_LightTree->getLeft(*top._Node);
+            children[2*nbRefined+1] = children[2*nbRefined] + 1;
+            nbRefined++;
+            cut.pop();
+        }
+        if(nbRefined == 0) break;
+
+        clusterErrorBounds(children, 2*nbRefined, query, bounds);
+        context._NbCutNodesEvaluated += 2*nbRefined;
+        for(uint32_t k=0; k<nbRefined; k++){
+            CpuCutEntry left = makeEntry(children[2*k], &refined[k], bounds[2*k]);
+            CpuCutEntry right = makeEntry(children[2*k+1], &refined[k], bounds[2*k+1]);
+            total += getEstimate(left) + getEstimate(right) - getEstimate(refined[k]);
+            cut.push(left);
+            cut.push(right);
+        }
+    }
+
+    if(isSeeded){
+        std::vector<const CpuLightTreeNode*>& previousCut = context._PreviousCut;
+        previousCut.clear();
+        for(const auto& entry : cut){
+            previousCut.push_back(entry._Node);
+        }
+        std::sort(previousCut.begin(), previousCut.end());
+    }
+    if(reconstructionCut != nullptr){
+        size_t first = reconstructionCut->size();
+        for(const auto& entry : cut){
+            reconstructionCut->push_back({._Node = entry._Node, ._IsOccluded = entry._IsOccluded});
+        }
+        std::sort(reconstructionCut->begin() + first, reconstructionCut->end());
+    }
+
+    context._NbCuts++;
+    context._TotalCutSize += cut.size();
+    return vmax(total, Vec3(0.f));
+}
+
+Vec3 CpuRayTracer::shadeDirectReconstructed(const CpuReconstructionPixel& pixel, const CpuReconstructionPixel* const* samples, uint32_t nbSamples, CpuRenderContext& context){
+    static const uint32_t MAX_SAMPLES = CpuReconstructionNode::MAX_SAMPLES;
+
+    const auto& lights = _Lights;
+    const CpuLightTreeNode* root = _LightTree->getRoot();
+    if(root == nullptr) return Vec3(0.f);
+    nbSamples = std::min(nbSamples, MAX_SAMPLES);
+
+    // depth first walk down to the finest cut of the samples, every pushed node has a sibling
+    // so the stack holds at most one node per level, it is reserved from the depth of the tree
+    std::vector<CpuReconstructionNode>& stack = context._ReconstructionStack;
+    stack.clear();
+    // the root is above the cut of every sample
+    stack.push_back({._Node = root});
+
+    Vec3 total{0.f};
+    while(!stack.empty()){
+        CpuReconstructionNode entry = stack.back();
+        stack.pop_back();
+        bool isAboveCut = false;
+        bool isVisible = false;
+        bool isOccluded = false;
+        for(uint32_t k=0; k<nbSamples; k++){
+            if(entry._States[k] == CPU_CLUSTER_ABOVE_CUT){
+                const CpuReconstructionCluster* first = &context._SampleClusters[samples[k]->_FirstCluster];
+                const CpuReconstructionCluster* last = first + samples[k]->_NbClusters;
+                const CpuReconstructionCluster* cluster = std::lower_bound(first, last, CpuReconstructionCluster{._Node = entry._Node});
+                if(cluster != last && cluster->_Node == entry._Node){
+                    entry._States[k] = cluster->_IsOccluded ? CPU_CLUSTER_OCCLUDED : CPU_CLUSTER_VISIBLE;
+                }
+            }
+            isAboveCut |= (entry._States[k] == CPU_CLUSTER_ABOVE_CUT);
+            isVisible |= (entry._States[k] == CPU_CLUSTER_VISIBLE);
+            isOccluded |= (entry._States[k] == CPU_CLUSTER_OCCLUDED);
+        }
+
+        // a leaf is always in or below the cut of every sample
+        if(isAboveCut && !entry._Node->isLeaf()){
+            const CpuLightTreeNode* children = &_LightTree->getLeft(*entry._Node);
+            stack.push_back(entry);
+            stack.back()._Node = &children[1];
+            stack.push_back(entry);
+            stack.back()._Node = &children[0];
+            continue;
+        }
+        if(!isVisible) continue;
+
+        // the visibility is only traced where the samples disagree
+        const CpuPointLight& light = lights[entry._Node->_RepresentativeLight];
+        Vec3 contribution{0.f};
+        if(isOccluded || isAboveCut){
+            contribution = evaluateLight(light, pixel._Position, pixel._Normal, pixel._Brdf, context);
+        } else {
+            contribution = pixel._Brdf * getGeometricTerm(light, pixel._Position, pixel._Normal);
+        }
+        total += entry._Node->_Intensity * contribution;
+    }
+    context._NbReconstructedPixels++;
+    return total;
+}
+
+Vec3 CpuRayTracer::shadeBouncesMultidimensional(const Vec3& position, const Vec3& normal, const Vec3& albedo, CpuRenderContext& context, const Vec3& backgroundColor){
+    Vec3 weight = albedo * (_ShadingFactor / _SamplesPerBounces);
+    CpuGatherTree& gatherTree = context._GatherTree;
+    gatherTree.clear();
+    // the point lights of the gather points are left to the cut
+    const Vec3 noPointLights{0.f};
+    Vec3 indirect{0.f};
+    for(uint32_t i=0; i<_SamplesPerBounces; i++){
+        Ray bounce{};
+        bounce._Origin = position;
+        bounce._Direction = sampleCosineHemisphere(normal, context._Rng);
+        CpuHit hit{};
+        if(!intersect(bounce, hit, context)){
+            indirect += backgroundColor;
+            continue;
+        }
+        // directional lights and the next bounces
+        indirect += shadeHit(bounce, hit, 1, context, backgroundColor, &noPointLights);
+
+        const CpuMaterial& material = _Scene->getMaterials()[_Scene->getInstances()[hit._Instance]._MaterialId];
+        CpuGatherPoint point{};
+        Vec3 hitPosition, geometricNormal;
+        getSurface(bounce, hit, hitPosition, point._Normal, geometricNormal);
+        point._Position = hitPosition + geometricNormal * SHADOW_EPSILON;
+        point._Strength = weight * material._Albedo / CPU_PI;
+        if(maxComponent(point._Strength) > 0.f) gatherTree.addPoint(point);
+    }
+    return weight * indirect + shadeGatherTree(context);
+}
+
+Vec3 CpuRayTracer::shadeGatherTree(CpuRenderContext& context){
+    const auto& lights = _Lights;
+    const CpuLightTreeNode* root = _LightTree->getRoot();
+    CpuGatherTree& gatherTree = context._GatherTree;
+    gatherTree.build();
+    if(root == nullptr || gatherTree.empty()) return Vec3(0.f);
+    context._NbGatherPoints += gatherTree.getNbPoints();
+
+    // the cosine at the gather points is only bounded for single points, larger gather
+    // clusters fall back on the distance between both boxes
+    float bounds[2];
+    auto computeBounds = [&](const CpuGatherNode& gather, const CpuLightTreeNode* lightNodes, uint32_t nbLightNodes){
+        if(gather.isLeaf()){
+            const CpuGatherPoint& point = gatherTree.getRepresentative(gather);
+            clusterErrorBounds(lightNodes, nbLightNodes, CpuBoundQuery(point._Position, point._Normal, Vec3(1.f)), bounds);
+            for(uint32_t i=0; i<nbLightNodes; i++){
+                bounds[i] *= maxComponent(gather._Strength);
+            }
+            return;
+        }
+        for(uint32_t i=0; i<nbLightNodes; i++){
+            float dist2 = gather._BoundingBox.distance2(lightNodes[i]._BoundingBox);
+            bounds[i] = dist2 > 0.f
+                ? maxComponent(gather._Strength) * maxComponent(lightNodes[i]._Intensity) / dist2
+                : CPU_INFINITY;
+        }
+    };
+    auto makeEntry = [&](uint32_t gatherId, const CpuLightTreeNode* lightNode, const CpuGatherCutEntry* parent, float errorBound){
+        CpuGatherCutEntry entry{};
+        entry._GatherNode = gatherId;
+        entry._LightNode = lightNode;
+        entry._ErrorBound = errorBound;
+        const CpuGatherNode& gather = gatherTree.getNode(gatherId);
+        // both representatives are shared with the parent, reuse its visibility
+        if(parent != nullptr
+            && gatherTree.getNode(parent->_GatherNode)._RepresentativePoint == gather._RepresentativePoint
+            && parent->_LightNode->_RepresentativeLight == lightNode->_RepresentativeLight){
+            entry._RepresentativeContribution = parent->_RepresentativeContribution;
+        } else {
+            const CpuGatherPoint& point = gatherTree.getRepresentative(gather);
+            entry._RepresentativeContribution = evaluateLight(
+                lights[lightNode->_RepresentativeLight], point._Position, point._Normal, Vec3(1.f), context
+            );
+        }
+        return entry;
+    };
+    auto getEstimate = [&](const CpuGatherCutEntry& entry){
+        return gatherTree.getNode(entry._GatherNode)._Strength * entry._LightNode->_Intensity * entry._RepresentativeContribution;
+    };
+
+    CpuCutHeap<CpuGatherCutEntry>& cut = context._GatherCut;
+    cut.clear();
+    computeBounds(gatherTree.getNode(0), root, 1);
+    CpuGatherCutEntry rootEntry = makeEntry(0, root, nullptr, bounds[0]);
+    Vec3 total = getEstimate(rootEntry);
+    cut.push(rootEntry);
+
+    while(cut.size() < _GatherMaxClusters){
+        const CpuGatherCutEntry top = cut.top();
+        if(top._ErrorBound <= _LightcutsErrorThreshold * maxComponent(total)) break;
+        const CpuGatherNode& gather = gatherTree.getNode(top._GatherNode);
+        const CpuLightTreeNode& light = *top._LightNode;
+        // the heap is ordered by bound, every other pair is at or below a pair of leaves
+        if(gather.isLeaf() && light.isLeaf()) break;
+        cut.pop();
+
+        // the largest of both clusters is refined
+        bool isRefiningLight = gather.isLeaf()
+            || (!light.isLeaf() && light._BoundingBox.getDiagonalLength2() >= gather._BoundingBox.getDiagonalLength2());
+        CpuGatherCutEntry children[2];
+        if(isRefiningLight){
+            const CpuLightTreeNode* lightChildren = &_LightTree->getLeft(light);
+            computeBounds(gather, lightChildren, 2);
+            for(uint32_t i=0; i<2; i++){
+                children[i] = makeEntry(top._GatherNode, &lightChildren[i], &top, bounds[i]);
+            }
+        } else {
+            for(uint32_t i=0; i<2; i++){
+                computeBounds(gatherTree.getNode(gather._FirstChild + i), &light, 1);
+                children[i] = makeEntry(gather._FirstChild + i, &light, &top, bounds[0]);
+            }
+        }
+        total += getEstimate(children[0]) + getEstimate(children[1]) - getEstimate(top);
+        cut.push(children[0]);
+        cut.push(children[1]);
+    }
+
+    context._NbGatherCuts++;
+    context._TotalGatherCutSize += cut.size();
+    return vmax(total, Vec3(0.f));
+}
+
+void CpuRayTracer::getSurface(const Ray& ray, const CpuHit& hit, Vec3& position, Vec3& normal, Vec3& geometricNormal) const {
+    const CpuMeshInstance& instance = _Scene->getInstances()[hit._Instance];
+    const CpuTriangle& triangle = _Scene->getGeometries()[instance._GeometryId]._Triangles[hit._Triangle];
+    position = ray._Origin + ray._Direction * hit._T;
+    // normals go to world space with the inverse transpose
+    const Matrix3x4& normalMatrix = instance._WorldToObject;
+    geometricNormal = normalize(normalMatrix.transformTransposed(
+        cross(triangle._V1 - triangle._V0, triangle._V2 - triangle._V0)
+    ));
+    normal = normalize(normalMatrix.transformTransposed(
+        triangle._N0 * (1.f - hit._U - hit._V)
+        + triangle._N1 * hit._U
+        + triangle._N2 * hit._V
+    ));
+    if(dot(normal, geometricNormal) < 0.f){
+        normal = -normal;
+    }
+}
+
+Vec3 CpuRayTracer::trace(const Ray& ray, uint32_t depth, CpuRenderContext& context, const Vec3& backgroundColor){
+    CpuHit hit{};
+    if(!intersect(ray, hit, context)) return backgroundColor;
+    return shadeHit(ray, hit, depth, context, backgroundColor, nullptr);
+}
+
+Vec3 CpuRayTracer::shadeHit(const Ray& ray, const CpuHit& hit, uint32_t depth, CpuRenderContext& context, const Vec3& backgroundColor, const Vec3* directLight){
+    const CpuMeshInstance& instance = _Scene->getInstances()[hit._Instance];
+    const CpuMaterial& material = _Scene->getMaterials()[instance._MaterialId];
+    Vec3 position, normal, geometricNormal;
+    getSurface(ray, hit, position, normal, geometricNormal);
+
+    // the bounces only follow the lambert term of the brdf
+    Vec3 albedo = material._Albedo;
+    CpuBrdf brdf(albedo / CPU_PI);
+    switch(_BRDFModel){
+        case CPU_COLOR_BRDF:
+            return material._Albedo;
+        case CPU_NORMAL_BRDF:
+            return normal * 0.5f + Vec3(0.5f);
+        case CPU_LAMBERT_BRDF:
+            break;
+        case CPU_GGX_BRDF:
+            albedo = albedo * (1.f - material._Metallic);
+            brdf = CpuBrdf::ggx(material, normal, normalize(-ray._Direction));
+            break;
+    }
+
+    Vec3 shadingPosition = position + geometricNormal * SHADOW_EPSILON;
+    Vec3 color{0.f};
+    if(directLight != nullptr){
+        color = *directLight;
+    } else {
+        color = _UseLightCuts
+            ? shadeDirectLightcuts(shadingPosition, normal, brdf, context, _UseCutCoherence && depth == 0)
+            : shadeDirect(shadingPosition, normal, brdf, context);
+    }
+    // directional lights are few and never clustered
+    color += shadeDirectional(shadingPosition, normal, brdf, context);
+
+    if(depth == 0 && _MaxBounces > 0 && _UseLightCuts && _UseMultidimensionalLightcuts){
+        color += shadeBouncesMultidimensional(shadingPosition, normal, albedo, context, backgroundColor);
+    } else if(depth < _MaxBounces){
+        Vec3 indirect{0.f};
+        for(uint32_t i=0; i<_SamplesPerBounces; i++){
+            Ray bounce{};
+            bounce._Origin = shadingPosition;
+            bounce._Direction = sampleCosineHemisphere(normal, context._Rng);
+            // cosine sampling cancels the lambert pdf
+            indirect += trace(bounce, depth+1, context, backgroundColor);
+        }
+        color += albedo * indirect * (_ShadingFactor / _SamplesPerBounces);
+    }
+    return color;
+}
+
+
+
+/********************************************************************/
+/****************************** RENDER ******************************/
+/********************************************************************/
+void CpuRayTracer::renderTile(const CpuTile& tile, CpuRenderContext& context, const Vec3& backgroundColor){
+    for(uint32_t y=tile._Y; y<tile._Y+tile._Height; y++){
+        for(uint32_t x=tile._X; x<tile._X+tile._Width; x++){
+            // seeded per pixel so the image does not depend on the scheduling
+            context._Rng = CpuRandom(static_cast<uint64_t>(y)*_Width + x);
+            Vec3 color{0.f};
+            for(uint32_t s=0; s<_SamplesPerPixels; s++){
+                Ray ray = generateCameraRay(x, y, s, context._Rng);
+                color += trace(ray, 0, context, backgroundColor);
+            }
+            _Image->setPixel(x, y, color / static_cast<float>(_SamplesPerPixels));
+        }
+    }
+}
+
+void CpuRayTracer::renderTileReconstructed(const CpuTile& tile, CpuRenderContext& context, const Vec3& backgroundColor){
+    uint32_t spacing = std::max(1u, _ReconstructionSpacing);
+    std::vector<CpuReconstructionPixel>& pixels = context._TilePixels;
+    pixels.assign(static_cast<size_t>(tile._Width) * tile._Height, CpuReconstructionPixel{});
+    auto getPixel = [&](uint32_t x, uint32_t y) -> CpuReconstructionPixel& {return pixels[y*tile._Width + x];};
+    for(uint32_t y=0; y<tile._Height; y++){
+        for(uint32_t x=0; x<tile._Width; x++){
+            CpuReconstructionPixel& pixel = getPixel(x, y);
+            pixel._Rng = CpuRandom(static_cast<uint64_t>(tile._Y + y)*_Width + tile._X + x);
+            // grid of samples including the last row and column of the tile
+            pixel._IsSample = (x % spacing == 0 || x == tile._Width-1) && (y % spacing == 0 || y == tile._Height-1);
+        }
+    }
+
+    auto isConsistent = [&](const CpuReconstructionPixel& pixel, const CpuReconstructionPixel& sample){
+        if(!sample._Hit.isValid() || sample._MaterialId != pixel._MaterialId) return false;
+        if(dot(pixel._Normal, sample._Normal) < RECONSTRUCTION_MIN_COSINE) return false;
+        return std::abs(dot(pixel._Position - sample._Position, sample._Normal)) <= RECONSTRUCTION_MAX_PLANE_DISTANCE * pixel._Hit._T;
+    };
+
+    for(uint32_t s=0; s<_SamplesPerPixels; s++){
+        // camera hits of the whole tile
+        for(auto& pixel : pixels){
+            uint32_t index = static_cast<uint32_t>(&pixel - pixels.data());
+            pixel._Ray = generateCameraRay(tile._X + index % tile._Width, tile._Y + index / tile._Width, s, pixel._Rng);
+            pixel._Hit = CpuHit{};
+            if(!intersect(pixel._Ray, pixel._Hit, context)) continue;
+            Vec3 position, geometricNormal;
+            getSurface(pixel._Ray, pixel._Hit, position, pixel._Normal, geometricNormal);
+            pixel._Position = position + geometricNormal * SHADOW_EPSILON;
+            pixel._MaterialId = _Scene->getInstances()[pixel._Hit._Instance]._MaterialId;
+            pixel._Brdf = _Scene->getMaterials()[pixel._MaterialId]._Albedo / CPU_PI;
+        }
+
+        // full cuts on the samples
+        context._SampleClusters.clear();
+        for(auto& pixel : pixels){
+            if(!pixel._IsSample) continue;
+            if(!pixel._Hit.isValid()){
+                pixel._Color += backgroundColor;
+                continue;
+            }
+            pixel._FirstCluster = static_cast<uint32_t>(context._SampleClusters.size());
+            context._Rng = pixel._Rng;
+            Vec3 direct = shadeDirectLightcuts(pixel._Position, pixel._Normal, pixel._Brdf, context, _UseCutCoherence, &context._SampleClusters);
+            pixel._NbClusters = static_cast<uint32_t>(context._SampleClusters.size()) - pixel._FirstCluster;
+            pixel._Color += shadeHit(pixel._Ray, pixel._Hit, 0, context, backgroundColor, &direct);
+            pixel._Rng = context._Rng;
+        }
+
+        // other pixels from the samples at the corners of their cell
+        for(uint32_t y=0; y<tile._Height; y++){
+            for(uint32_t x=0; x<tile._Width; x++){
+                CpuReconstructionPixel& pixel = getPixel(x, y);
+                if(pixel._IsSample) continue;
+                context._Rng = pixel._Rng;
+                if(!pixel._Hit.isValid()){
+                    pixel._Color += backgroundColor;
+                    continue;
+                }
+                uint32_t x0 = (x / spacing) * spacing, x1 = std::min(x0 + spacing, tile._Width-1);
+                uint32_t y0 = (y / spacing) * spacing, y1 = std::min(y0 + spacing, tile._Height-1);
+                const CpuReconstructionPixel* corners[4] = {&getPixel(x0, y0), &getPixel(x1, y0), &getPixel(x0, y1), &getPixel(x1, y1)};
+                const CpuReconstructionPixel* samples[4];
+                uint32_t nbSamples = 0;
+                for(const auto* corner : corners){
+                    if(std::find(samples, samples + nbSamples, corner) != samples + nbSamples) continue;
+                    if(isConsistent(pixel, *corner)) samples[nbSamples++] = corner;
+                }
+                // no sample on the same surface, the pixel gets its own cut
+                Vec3 direct = nbSamples > 0
+                    ? shadeDirectReconstructed(pixel, samples, nbSamples, context)
+                    : shadeDirectLightcuts(pixel._Position, pixel._Normal, pixel._Brdf, context, false);
+                pixel._Color += shadeHit(pixel._Ray, pixel._Hit, 0, context, backgroundColor, &direct);
+                pixel._Rng = context._Rng;
+            }
+        }
+    }
+
+    for(uint32_t y=0; y<tile._Height; y++){
+        for(uint32_t x=0; x<tile._Width; x++){
+            _Image->setPixel(tile._X + x, tile._Y + y, getPixel(x, y)._Color / static_cast<float>(_SamplesPerPixels));
+        }
+    }
+}
+
+void CpuRayTracer::run(const Vec3& backgroundColor, const std::atomic<bool>* isCancelled, const std::function<void(const CpuTile&)>& onTileDone){
+    if(_TopLevelBvh == nullptr){
+        initAccelerationStructure();
+    }
+    if(_LightTree == nullptr){
+        initLights();
+    }
+    _Stats.reset();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    CpuTileScheduler scheduler(_Width, _Height, _TileSize, _NbThreads);
+    std::vector<CpuRenderContext> contexts(scheduler.getNbThreads());
+    // only the lambert brdf uses the lights
+    bool isReconstructing = _UseReconstructionCuts && _UseLightCuts && _BRDFModel == CPU_LAMBERT_BRDF;
+    uint32_t maxTreeDepth = isReconstructing ? _LightTree->getMaxDepth() : 0;
+    // refining a cluster removes one entry and adds two
+    for(auto& context : contexts){
+        context.reserveCut(_LightcutsMaxClusters + 1);
+        if(_UseMultidimensionalLightcuts){
+            context.reserveGatherCut(_SamplesPerBounces, _GatherMaxClusters + 1);
+        }
+        if(isReconstructing){
+            context.reserveReconstruction(_TileSize, _ReconstructionSpacing, _LightcutsMaxClusters + 1, maxTreeDepth);
+        }
+        context._BufferCapacities = context.getBufferCapacities();
+    }
+    std::atomic<uint32_t> nbTilesDone{0};
+
+    scheduler.run([&](const CpuTile& tile, uint32_t threadId){
+        CpuRenderContext& context = contexts[threadId];
+        // the image must not depend on the tile previously rendered by the thread
+        context._PreviousCut.clear();
+        if(isReconstructing){
+            renderTileReconstructed(tile, context, backgroundColor);
+        } else {
+            renderTile(tile, context, backgroundColor);
+        }
+        context._NbCameraRays += static_cast<uint64_t>(tile._Width) * tile._Height * _SamplesPerPixels;
+        context.countBufferGrowths();
+        if(onTileDone){
+            onTileDone(tile);
+        }
+
+        uint32_t done = ++nbTilesDone;
+        if(done % 64 == 0 || done == scheduler.getNbTiles()){
+            fprintf(stdout, "\rRendering: %u/%u tiles", done, scheduler.getNbTiles());
+            fflush(stdout);
+        }
+    }, isCancelled);
+    fprintf(stdout, "\n");
+
+    for(const auto& context : contexts){
+        _Stats._NbCameraRays += context._NbCameraRays;
+        _Stats._NbRays += context._NbRays;
+        _Stats._NbShadowRays += context._NbShadowRays;
+        _Stats._NbNodesVisited += context._NbNodesVisited;
+        _Stats._NbShadowNodesVisited += context._NbShadowNodesVisited;
+        _Stats._RayTime += context._RayTime;
+        _Stats._ShadowRayTime += context._ShadowRayTime;
+        _Stats._NbTimedRays += context._NbTimedRays;
+        _Stats._NbTimedShadowRays += context._NbTimedShadowRays;
+        _Stats._NbCuts += context._NbCuts;
+        _Stats._TotalCutSize += context._TotalCutSize;
+        _Stats._NbCutNodesEvaluated += context._NbCutNodesEvaluated;
+        _Stats._NbReconstructedPixels += context._NbReconstructedPixels;
+        _Stats._NbGatherCuts += context._NbGatherCuts;
+        _Stats._TotalGatherCutSize += context._TotalGatherCutSize;
+        _Stats._NbGatherPoints += context._NbGatherPoints;
+        _Stats._NbBufferGrowths += context._NbBufferGrowths;
+    }
+    _Stats._Scheduler = scheduler.getStats();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    _Stats._RenderTime = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+}
+
+float CpuRayTracer::measureLightTreeQuality(float errorThreshold, uint32_t gridSize){
+    if(_TopLevelBvh == nullptr){
+        initAccelerationStructure();
+    }
+    if(_LightTree == nullptr){
+        initLights();
+    }
+    const auto& lights = _Lights;
+    const CpuLightTreeNode* root = _LightTree->getRoot();
+    if(root == nullptr) return 0.f;
+
+    uint64_t nbCuts = 0;
+    uint64_t totalCutSize = 0;
+    #pragma omp parallel reduction(+:nbCuts, totalCutSize)
+    {
+        // the heap of the thread grows to the largest cut and is reused after
+        CpuRenderContext context{};
+        #pragma omp for schedule(dynamic)
+        for(uint32_t cell=0; cell<gridSize*gridSize; cell++){
+            context._Rng = CpuRandom{};
+            uint32_t x = ((cell % gridSize) * _Width + _Width / 2) / gridSize;
+            uint32_t y = ((cell / gridSize) * _Height + _Height / 2) / gridSize;
+            Ray ray = generateCameraRay(x, y, 0, context._Rng);
+            CpuHit hit{};
+            if(!intersect(ray, hit, context)) continue;
+            Vec3 position, normal, geometricNormal;
+            getSurface(ray, hit, position, normal, geometricNormal);
+            // the albedo scales every bound the same way, a white lambert brdf is enough
+            Vec3 brdf = Vec3(1.f / CPU_PI);
+            CpuBoundQuery query(position, normal, brdf);
+            float bounds[2*CPU_CUT_REFINE_BATCH];
+            const CpuLightTreeNode* children[2*CPU_CUT_REFINE_BATCH];
+            CpuCutEntry refined[CPU_CUT_REFINE_BATCH];
+
+            auto makeEntry = [&](const CpuLightTreeNode* node, float errorBound){
+                CpuCutEntry entry{};
+                entry._Node = node;
+                entry._RepresentativeContribution = brdf * getGeometricTerm(lights[node->_RepresentativeLight], position, normal);
+                entry._ErrorBound = errorBound;
+                return entry;
+            };
+
+            CpuCutHeap<CpuCutEntry>& cut = context._Cut;
+            cut.clear();
+            clusterErrorBounds(root, 1, query, bounds);
+            CpuCutEntry rootEntry = makeEntry(root, bounds[0]);
+            Vec3 total = root->_Intensity * rootEntry._RepresentativeContribution;
+            cut.push(rootEntry);
+            // same batched refinement as shadeDirectLightcuts
+            while(cut.size() < lights.size()){
+                float threshold = errorThreshold * maxComponent(total);
+                size_t maxRefined = std::min<size_t>(CPU_CUT_REFINE_BATCH, lights.size() - cut.size());
+                uint32_t nbRefined = 0;
+                while(nbRefined < maxRefined && !cut.empty()){
+                    const CpuCutEntry& top = cut.top();
+                    if(top._ErrorBound <= threshold || top._Node->isLeaf()) break;
+                    refined[nbRefined] = top;
+                    children[2*nbRefined] = &_LightTree->getLeft(*top._Node);
+                    children[2*nbRefined+1] = children[2*nbRefined] + 1;
+                    nbRefined++;
+                    cut.pop();
+                }
+                if(nbRefined == 0) break;
+
+                clusterErrorBounds(children, 2*nbRefined, query, bounds);
+                for(uint32_t k=0; k<nbRefined; k++){
+                    CpuCutEntry left = makeEntry(children[2*k], bounds[2*k]);
+                    CpuCutEntry right = makeEntry(children[2*k+1], bounds[2*k+1]);
+                    total -= refined[k]._Node->_Intensity * refined[k]._RepresentativeContribution;
+                    total += left._Node->_Intensity * left._RepresentativeContribution;
+                    total += right._Node->_Intensity * right._RepresentativeContribution;
+                    cut.push(left);
+                    cut.push(right);
+                }
+            }
+            nbCuts++;
+            totalCutSize += cut.size();
+        }
+    }
+    return nbCuts > 0 ? static_cast<float>(totalCutSize) / static_cast<float>(nbCuts) : 0.f;
+}
\ No newline at end of file
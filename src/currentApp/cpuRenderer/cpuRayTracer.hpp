@@ -0,0 +1,386 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpuBrdf.hpp"
+#include "cpuBvh.hpp"
+#include "cpuCacheFile.hpp"
+#include "cpuClusterBounds.hpp"
+#include "cpuGatherTree.hpp"
+#include "cpuImage.hpp"
+#include "cpuLightCut.hpp"
+#include "cpuLightTree.hpp"
+#include "cpuMath.hpp"
+#include "cpuSampling.hpp"
+#include "cpuScene.hpp"
+#include "cpuTileScheduler.hpp"
+
+class CpuRayTracer;
+using CpuRayTracerPtr = std::shared_ptr<CpuRayTracer>;
+
+enum CpuBRDFModel{
+    CPU_COLOR_BRDF,
+    CPU_NORMAL_BRDF,
+    CPU_LAMBERT_BRDF,
+    // lambert with a ggx specular lobe from the material parameters
+    CPU_GGX_BRDF,
+};
+
+struct CpuHit{
+    float _T = CPU_INFINITY;
+    uint32_t _Instance = UINT32_MAX;
+    // index in the geometry of the instance
+    uint32_t _Triangle = UINT32_MAX;
+    float _U = 0.f;
+    float _V = 0.f;
+
+    bool isValid() const {return _Triangle != UINT32_MAX;}
+};
+
+// state of a light tree node in the cut of a sample pixel
+enum CpuClusterState : uint8_t{
+    CPU_CLUSTER_ABOVE_CUT,
+    CPU_CLUSTER_VISIBLE,
+    CPU_CLUSTER_OCCLUDED,
+};
+
+// node of the walk of a reconstructed pixel down to the cuts of its samples
+struct CpuReconstructionNode{
+    static const uint32_t MAX_SAMPLES = 4;
+
+    const CpuLightTreeNode* _Node = nullptr;
+    CpuClusterState _States[MAX_SAMPLES]{};
+};
+
+// camera hit of a tile rendered with reconstruction cuts
+struct CpuReconstructionPixel{
+    CpuRandom _Rng{};
+    Ray _Ray{};
+    CpuHit _Hit{};
+    Vec3 _Position{};
+    Vec3 _Normal{};
+    Vec3 _Brdf{};
+    uint32_t _MaterialId = UINT32_MAX;
+    // clusters of the cut of a sample pixel in CpuRenderContext::_SampleClusters
+    uint32_t _FirstCluster = 0;
+    uint32_t _NbClusters = 0;
+    bool _IsSample = false;
+    Vec3 _Color{0.f};
+};
+
+// per thread state, merged into the global stats at the end of the frame
+// aligned on cache lines since the contexts of all threads are stored together
+struct alignas(64) CpuRenderContext{
+    CpuRandom _Rng{};
+    uint64_t _NbCameraRays = 0;
+    uint64_t _NbRays = 0;
+    uint64_t _NbShadowRays = 0;
+    uint64_t _NbNodesVisited = 0;
+    uint64_t _NbShadowNodesVisited = 0;
+    // time spent in the acceleration structure in nanoseconds, only for the sampled rays
+    uint64_t _RayTime = 0;
+    uint64_t _ShadowRayTime = 0;
+    uint64_t _NbTimedRays = 0;
+    uint64_t _NbTimedShadowRays = 0;
+    uint64_t _NbCuts = 0;
+    uint64_t _TotalCutSize = 0;
+    uint64_t _NbCutNodesEvaluated = 0;
+    // reused by every cut of the thread
+    CpuCutHeap<CpuCutEntry> _Cut{};
+    CpuCutHeap<CpuDirectionalCutEntry> _DirectionalCut{};
+    // sorted nodes of the last camera hit cut, seed of the next one with cut coherence
+    std::vector<const CpuLightTreeNode*> _PreviousCut{};
+    // temporaries of the seeding
+    std::vector<CpuCutEntry> _SeedEntries{};
+    std::vector<float> _SeedBounds{};
+    std::vector<const CpuLightTreeNode*> _SeedParents{};
+    std::vector<uint32_t> _SeedPairs{};
+    // bounce hits of the camera hit being shaded with multidimensional lightcuts
+    CpuGatherTree _GatherTree{};
+    CpuCutHeap<CpuGatherCutEntry> _GatherCut{};
+    uint64_t _NbGatherCuts = 0;
+    uint64_t _TotalGatherCutSize = 0;
+    uint64_t _NbGatherPoints = 0;
+    // tile being reconstructed and the cuts of its samples
+    uint64_t _NbReconstructedPixels = 0;
+    std::vector<CpuReconstructionPixel> _TilePixels{};
+    std::vector<CpuReconstructionCluster> _SampleClusters{};
+    // depth first walk of shadeDirectReconstructed
+    std::vector<CpuReconstructionNode> _ReconstructionStack{};
+
+    void reserveCut(size_t maxCutSize){
+        _Cut.reserve(maxCutSize);
+        _DirectionalCut.reserve(maxCutSize);
+        _PreviousCut.reserve(maxCutSize);
+        _SeedEntries.reserve(maxCutSize);
+        _SeedBounds.reserve(maxCutSize);
+        _SeedParents.reserve(maxCutSize);
+        _SeedPairs.reserve(maxCutSize);
+    }
+    void reserveGatherCut(uint32_t nbGatherPoints, size_t maxCutSize){
+        _GatherTree.reserve(nbGatherPoints);
+        _GatherCut.reserve(maxCutSize);
+    }
+    void reserveReconstruction(uint32_t tileSize, uint32_t spacing, size_t maxCutSize, uint32_t maxTreeDepth){
+        size_t nbSamplesPerSide = tileSize / std::max(1u, spacing) + 2;
+        _TilePixels.reserve(static_cast<size_t>(tileSize) * tileSize);
+        _SampleClusters.reserve(nbSamplesPerSide * nbSamplesPerSide * maxCutSize);
+        // every popped node pushes both of its children
+        _ReconstructionStack.reserve(maxTreeDepth + 2);
+    }
+
+    // every buffer above is reserved before the render and should never grow while shading,
+    // their capacities are compared after each tile and every buffer that grew is counted
+    static const uint32_t NB_REUSED_BUFFERS = 12;
+    std::array<size_t, NB_REUSED_BUFFERS> _BufferCapacities{};
+    uint64_t _NbBufferGrowths = 0;
+
+    std::array<size_t, NB_REUSED_BUFFERS> getBufferCapacities() const {
+        return {
+            _Cut.capacity(), _DirectionalCut.capacity(), _PreviousCut.capacity(),
+            _SeedEntries.capacity(), _SeedBounds.capacity(), _SeedParents.capacity(), _SeedPairs.capacity(),
+            _GatherTree.getCapacity(), _GatherCut.capacity(), _TilePixels.capacity(), _SampleClusters.capacity(),
+            _ReconstructionStack.capacity(),
+        };
+    }
+    void countBufferGrowths(){
+        std::array<size_t, NB_REUSED_BUFFERS> capacities = getBufferCapacities();
+        for(uint32_t i=0; i<NB_REUSED_BUFFERS; i++){
+            if(capacities[i] > _BufferCapacities[i]) _NbBufferGrowths++;
+        }
+        _BufferCapacities = capacities;
+    }
+};
+
+struct CpuRenderStats{
+    std::atomic<uint64_t> _NbCameraRays{0};
+    // camera and bounce rays
+    std::atomic<uint64_t> _NbRays{0};
+    std::atomic<uint64_t> _NbShadowRays{0};
+    std::atomic<uint64_t> _NbNodesVisited{0};
+    std::atomic<uint64_t> _NbShadowNodesVisited{0};
+    // summed over every thread, in nanoseconds, for the timed rays only
+    std::atomic<uint64_t> _RayTime{0};
+    std::atomic<uint64_t> _ShadowRayTime{0};
+    std::atomic<uint64_t> _NbTimedRays{0};
+    std::atomic<uint64_t> _NbTimedShadowRays{0};
+    std::atomic<uint64_t> _NbCuts{0};
+    std::atomic<uint64_t> _TotalCutSize{0};
+    // growths of the per-thread cut, seeding, gather and reconstruction buffers
+    // while shading, counted once per buffer and tile, should stay at 0
+    std::atomic<uint64_t> _NbBufferGrowths{0};
+    // error bounds computed, seeding included
+    std::atomic<uint64_t> _NbCutNodesEvaluated{0};
+    std::atomic<uint64_t> _NbGatherCuts{0};
+    std::atomic<uint64_t> _TotalGatherCutSize{0};
+    std::atomic<uint64_t> _NbGatherPoints{0};
+    // camera hits shaded from the cuts of their neighbours
+    std::atomic<uint64_t> _NbReconstructedPixels{0};
+    float _BvhBuildTime = 0.f;
+    bool _IsBvhCached = false;
+    uint32_t _NbBottomLevelNodes = 0;
+    uint32_t _NbTopLevelNodes = 0;
+    float _TopLevelRefitTime = 0.f;
+    float _LightTreeBuildTime = 0.f;
+    bool _IsLightTreeCached = false;
+    CpuLightTreeBuilder _LightTreeBuilder = CPU_LIGHT_TREE_LOCALLY_ORDERED;
+    uint32_t _NbLightTreeNodes = 0;
+    uint32_t _NbLights = 0;
+    // lights inserted, removed or moved, kept across the rebuilds like the time spent on them
+    uint32_t _NbLightTreeUpdates = 0;
+    // normalized cost of the light tree over the one right after its last build
+    float _LightTreeCostRatio = 1.f;
+    float _LightTreeUpdateTime = 0.f;
+    // rebuilds triggered by updates that made the tree too costly, kept across the rebuilds
+    uint32_t _NbLightTreeRebuilds = 0;
+    uint32_t _NbVpls = 0;
+    float _VplTime = 0.f;
+    // in bytes
+    size_t _LightTreeMemory = 0;
+    float _RenderTime = 0.f;
+    CpuSchedulerStats _Scheduler{};
+
+    // build times are kept, they are only measured once
+    void reset(){
+        _NbCameraRays = 0;
+        _NbRays = 0;
+        _NbShadowRays = 0;
+        _NbNodesVisited = 0;
+        _NbShadowNodesVisited = 0;
+        _RayTime = 0;
+        _ShadowRayTime = 0;
+        _NbTimedRays = 0;
+        _NbTimedShadowRays = 0;
+        _NbCuts = 0;
+        _TotalCutSize = 0;
+        _NbBufferGrowths = 0;
+        _NbCutNodesEvaluated = 0;
+        _NbGatherCuts = 0;
+        _TotalGatherCutSize = 0;
+        _NbGatherPoints = 0;
+        _NbReconstructedPixels = 0;
+        _RenderTime = 0.f;
+        _Scheduler = CpuSchedulerStats{};
+    }
+    void print() const;
+};
+
+// cpu only counterpart of be::RayTracer, used by the headless mode
+class CpuRayTracer{
+
+    public:
+        static const uint32_t DEFAULT_RECONSTRUCTION_SPACING = 4;
+        static const uint32_t DEFAULT_GATHER_MAX_CLUSTERS = 1000;
+        static const uint32_t DEFAULT_NB_VPL_PATHS = 4096;
+        static constexpr float DEFAULT_VPL_CLAMP = 1.f;
+        // relative to the working directory
+        static constexpr const char* DEFAULT_CACHE_DIRECTORY = "cache";
+
+        uint32_t _SamplesPerPixels = 1;
+        uint32_t _MaxBounces = 0;
+        uint32_t _SamplesPerBounces = 1;
+        float _ShadingFactor = 1.f;
+
+        bool _UseLightCuts = false;
+        float _LightcutsErrorThreshold = 0.02f;
+        uint32_t _LightcutsMaxClusters = 100;
+        // camera hits start from the cut of the previous pixel of the tile instead of the root
+        bool _UseCutCoherence = false;
+        // the bounces of a camera hit share a single cut over pairs of gather and light clusters
+        bool _UseMultidimensionalLightcuts = false;
+        // a multidimensional cut covers every gather point, it is larger than the one of a single point
+        uint32_t _GatherMaxClusters = DEFAULT_GATHER_MAX_CLUSTERS;
+        // full cuts are only computed on a grid of samples and where the neighbouring samples are
+        // on another surface, the other camera hits reuse the cuts and visibility of the samples
+        bool _UseReconstructionCuts = false;
+        // pixels between two samples of the grid
+        uint32_t _ReconstructionSpacing = DEFAULT_RECONSTRUCTION_SPACING;
+        CpuLightTreeBuilder _LightTreeBuilder = CPU_LIGHT_TREE_LOCALLY_ORDERED;
+
+        // directory of the cached bottom level bvhs and light trees, keyed by a hash of
+        // their triangles or lights, empty disables the cache
+        std::string _CacheDirectory = "";
+        // the least recently used files are removed past this size, 0 keeps every file
+        uint64_t _CacheMaxSize = CpuCacheWriter::DEFAULT_MAX_DIRECTORY_SIZE;
+
+        // the light tree is updated in place by the light edits and only rebuilt once
+        // its cost went past this ratio of the cost right after its last build
+        float _LightTreeRebuildThreshold = CpuLightTree::DEFAULT_REBUILD_THRESHOLD;
+
+        // instant radiosity, read by initLights: light paths leave virtual point lights on the
+        // surfaces they hit, which are clustered with the point lights of the scene
+        bool _UseVpls = false;
+        uint32_t _NbVplPaths = DEFAULT_NB_VPL_PATHS;
+        // bounces of a light path, each one leaves a virtual point light
+        uint32_t _VplBounces = 1;
+        // maximum geometric term of a virtual point light, hides the spikes close to them
+        float _VplClamp = DEFAULT_VPL_CLAMP;
+
+        // 0 uses every core
+        uint32_t _NbThreads = 0;
+        uint32_t _TileSize = CpuTileScheduler::DEFAULT_TILE_SIZE;
+
+    private:
+        CpuScenePtr _Scene = nullptr;
+        uint32_t _Width = 0;
+        uint32_t _Height = 0;
+        CpuImagePtr _Image = nullptr;
+        // one bottom level per geometry and a top level over the instances
+        std::vector<CpuBvhPtr> _BottomLevelBvhs{};
+        CpuBvhPtr _TopLevelBvh = nullptr;
+        // point lights of the scene followed by the virtual point lights, indexed by the light tree
+        std::vector<CpuPointLight> _Lights{};
+        CpuLightTreePtr _LightTree = nullptr;
+        CpuDirectionalLightTreePtr _DirectionalLightTree = nullptr;
+        CpuBRDFModel _BRDFModel = CPU_LAMBERT_BRDF;
+        CpuRenderStats _Stats{};
+
+    public:
+        CpuRayTracer(CpuScenePtr scene, uint32_t width, uint32_t height);
+
+        void setResolution(uint32_t width, uint32_t height);
+        void enableColorBRDF(){_BRDFModel = CPU_COLOR_BRDF;}
+        void enableNormalBRDF(){_BRDFModel = CPU_NORMAL_BRDF;}
+        void enableLambertBRDF(){_BRDFModel = CPU_LAMBERT_BRDF;}
+        void enableGgxBRDF(){_BRDFModel = CPU_GGX_BRDF;}
+
+        void initAccelerationStructure();
+        // call after CpuScene::setInstanceTransform, geometries are not rebuilt
+        void refitInstances();
+        // call after CpuScene::addPointLight, removePointLight or setPointLight, never during a render
+        // virtual point lights depend on every light, the tree is rebuilt if they are used
+        void insertLight();
+        void removeLight(uint32_t lightId);
+        void refitLight(uint32_t lightId);
+        // the rebuilds triggered by light edits skip the cache, their trees are rarely seen again
+        void initLights(bool useCache = true);
+        // onTileDone is called from the render threads once the pixels of a tile are written
+        // return early without finishing the image if isCancelled is set
+        void run(const Vec3& backgroundColor, 
+            const std::atomic<bool>* isCancelled = nullptr, 
+            const std::function<void(const CpuTile&)>& onTileDone = nullptr
+        );
+
+        // average cut size over a grid of camera hits, visibility is ignored so only the tree is measured
+        float measureLightTreeQuality(float errorThreshold = 0.02f, uint32_t gridSize = 32);
+
+        CpuImagePtr getImage() const {return _Image;}
+        uint32_t getNbTiles() const {return CpuTileScheduler::getNbTiles(_Width, _Height, _TileSize);}
+        const CpuRenderStats& getStats() const {return _Stats;}
+
+    private:
+        Ray generateCameraRay(uint32_t x, uint32_t y, uint32_t sample, CpuRandom& rng) const;
+        // closest hit, used by camera and bounce rays
+        bool intersect(const Ray& ray, CpuHit& hit, CpuRenderContext& context) const;
+        // any hit between origin and target, used by shadow rays
+        bool isOccluded(const Vec3& origin, const Vec3& target, CpuRenderContext& context) const;
+
+        // shading frame of a hit, the normal faces the same side as the geometric normal
+        void getSurface(const Ray& ray, const CpuHit& hit, Vec3& position, Vec3& normal, Vec3& geometricNormal) const;
+
+        Vec3 trace(const Ray& ray, uint32_t depth, CpuRenderContext& context, const Vec3& backgroundColor);
+        // directLight replaces the contribution of the point lights if set
+        Vec3 shadeHit(const Ray& ray, const CpuHit& hit, uint32_t depth, CpuRenderContext& context, const Vec3& backgroundColor, const Vec3* directLight);
+        void renderTile(const CpuTile& tile, CpuRenderContext& context, const Vec3& backgroundColor);
+        void renderTileReconstructed(const CpuTile& tile, CpuRenderContext& context, const Vec3& backgroundColor);
+        Vec3 shadeDirectional(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context);
+        // lightcuts over the directional light tree, with their own error threshold relative to their total
+        Vec3 shadeDirectionalLightcuts(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context);
+        Vec3 shadeDirect(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context);
+        // a seeded cut starts from context._PreviousCut and replaces it by the new cut
+        // the clusters of the cut are appended to reconstructionCut if set
+        Vec3 shadeDirectLightcuts(const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context, bool isSeeded,
+            std::vector<CpuReconstructionCluster>* reconstructionCut = nullptr
+        );
+        // first bounce of a camera hit, the point lights of every gather point come from one multidimensional cut
+        Vec3 shadeBouncesMultidimensional(const Vec3& position, const Vec3& normal, const Vec3& albedo, CpuRenderContext& context, const Vec3& backgroundColor);
+        Vec3 shadeGatherTree(CpuRenderContext& context);
+        // point lights of a camera hit from the cuts of the consistent samples around it
+        Vec3 shadeDirectReconstructed(const CpuReconstructionPixel& pixel, const CpuReconstructionPixel* const* samples, uint32_t nbSamples, CpuRenderContext& context);
+
+        // hash of the triangles of every geometry
+        uint64_t getBvhCacheKey() const;
+        // both loads return false if the cache is disabled, missing, stale or corrupt
+        bool loadBottomLevelBvhs();
+        void saveBottomLevelBvhs() const;
+        bool loadLightTree();
+        void saveLightTree() const;
+        // rebuild the light tree if the update made it too costly
+        void finishLightTreeUpdate(float updateTime);
+        // light paths from the point lights of the scene
+        void generateVpls(std::vector<CpuPointLight>& vpls);
+
+        // cosines at the receiver and at oriented lights over the squared distance
+        float getGeometricTerm(const CpuPointLight& light, const Vec3& position, const Vec3& normal) const;
+        // brdf times geometric term times visibility, without the light intensity
+        // isOccluded is set if a shadow ray was blocked
+        Vec3 evaluateLight(const CpuPointLight& light, const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context, bool* isOccluded = nullptr) const;
+        Vec3 evaluateLight(const CpuDirectionalLight& light, const Vec3& position, const Vec3& normal, const CpuBrdf& brdf, CpuRenderContext& context) const;
+};
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "cpuRenderJob.hpp"
+
+CpuRenderJob::CpuRenderJob(CpuRayTracerPtr rayTracer, const Vec3& backgroundColor, bool isLightTreeDirty)
+    : _RayTracer(rayTracer){
+    _NbTiles = _RayTracer->getNbTiles();
+    _Thread = std::thread([this, backgroundColor, isLightTreeDirty](){
+        if(isLightTreeDirty){
+            _RayTracer->initLights();
+        }
+        _RayTracer->run(backgroundColor, &_IsCancelled, [this](const CpuTile& tile){
+            // the lock publishes the pixels of the tile to the thread taking it
+            std::lock_guard<std::mutex> lock(_FinishedTilesMutex);
+            _FinishedTiles.push_back(tile);
+            _NbTilesDone++;
+        });
+        _IsDone = true;
+    });
+}
+
+CpuRenderJob::~CpuRenderJob(){
+    cancel();
+    wait();
+}
+
+void CpuRenderJob::wait(){
+    if(_Thread.joinable()){
+        _Thread.join();
+    }
+}
+
+std::vector<CpuTile> CpuRenderJob::takeFinishedTiles(){
+    std::vector<CpuTile> tiles{};
+    std::lock_guard<std::mutex> lock(_FinishedTilesMutex);
+    tiles.swap(_FinishedTiles);
+    return tiles;
+}
\ No newline at end of file
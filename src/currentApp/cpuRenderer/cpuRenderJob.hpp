@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpuMath.hpp"
+#include "cpuRayTracer.hpp"
+#include "cpuTileScheduler.hpp"
+
+class CpuRenderJob;
+using CpuRenderJobPtr = std::shared_ptr<CpuRenderJob>;
+
+// handle on a render running in the background
+// the ray tracer must not be modified until the job is done
+class CpuRenderJob{
+
+    private:
+        CpuRayTracerPtr _RayTracer = nullptr;
+        std::thread _Thread{};
+        std::atomic<bool> _IsCancelled{false};
+        std::atomic<bool> _IsDone{false};
+
+        uint32_t _NbTiles = 0;
+        std::atomic<uint32_t> _NbTilesDone{0};
+        std::mutex _FinishedTilesMutex{};
+        std::vector<CpuTile> _FinishedTiles{};
+
+    public:
+        // start the render right away, the light tree is rebuilt first on the worker if requested
+        CpuRenderJob(CpuRayTracerPtr rayTracer, const Vec3& backgroundColor, bool isLightTreeDirty = false);
+        // cancel the render and wait for the worker
+        ~CpuRenderJob();
+
+        void cancel(){_IsCancelled = true;}
+        void wait();
+
+        bool isDone() const {return _IsDone;}
+        bool isCancelled() const {return _IsCancelled;}
+        uint32_t getNbTiles() const {return _NbTiles;}
+        uint32_t getNbTilesDone() const {return _NbTilesDone;}
+
+        // tiles finished since the last call, their pixels can safely be read from the ray tracer image
+        std::vector<CpuTile> takeFinishedTiles();
+};
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+#include "cpuMath.hpp"
+
+// small pcg32 generator, one per pixel or per thread
+struct CpuRandom{
+    uint64_t _State = 0x853c49e6748fea9bULL;
+
+    CpuRandom(){};
+    CpuRandom(uint64_t seed){
+        _State = 0u;
+        nextUint();
+        _State += seed;
+        nextUint();
+    }
+
+    uint32_t nextUint(){
+        uint64_t oldState = _State;
+        _State = oldState * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+        uint32_t rot = static_cast<uint32_t>(oldState >> 59u);
+        return (xorShifted >> rot) | (xorShifted << ((-rot) & 31));
+    }
+
+    // uniform float in [0, 1)
+    float nextFloat(){
+        return static_cast<float>(nextUint() >> 8) * (1.f / 16777216.f);
+    }
+};
+
+// uniform direction on the unit sphere
+inline Vec3 sampleUniformSphere(CpuRandom& rng){
+    float z = 1.f - 2.f * rng.nextFloat();
+    float r = std::sqrt(std::max(0.f, 1.f - z*z));
+    float phi = 2.f * CPU_PI * rng.nextFloat();
+    return Vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+// cosine weighted direction around the normal n
+inline Vec3 sampleCosineHemisphere(const Vec3& n, CpuRandom& rng){
+    float u1 = rng.nextFloat();
+    float u2 = rng.nextFloat();
+    float r = std::sqrt(u1);
+    float phi = 2.f * CPU_PI * u2;
+    Vec3 t, b;
+    orthonormalBasis(n, t, b);
+    return normalize(
+        t * (r * std::cos(phi))
+        + b * (r * std::sin(phi))
+        + n * std::sqrt(std::max(0.f, 1.f - u1))
+    );
+}
\ No newline at end of file
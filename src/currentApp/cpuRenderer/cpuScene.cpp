@@ -0,0 +1,384 @@
+#include "cpuScene.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unordered_map>
+#include <utility>
+
+#include "cpuMeshFile.hpp"
+
+/********************************************************************/
+/****************************** MESHES ******************************/
+/********************************************************************/
+void CpuMesh::computeNormals(){
+    _Normals.assign(_Positions.size(), Vec3(0.f));
+    for(size_t i=0; i+2<_Indices.size(); i+=3){
+        const Vec3& p0 = _Positions[_Indices[i]];
+        const Vec3& p1 = _Positions[_Indices[i+1]];
+        const Vec3& p2 = _Positions[_Indices[i+2]];
+        // area weighted face normal
+        Vec3 n = cross(p1 - p0, p2 - p0);
+        _Normals[_Indices[i]] += n;
+        _Normals[_Indices[i+1]] += n;
+        _Normals[_Indices[i+2]] += n;
+    }
+    for(auto& n : _Normals){
+        n = normalize(n);
+    }
+}
+
+void CpuMesh::computeBoundingBox(){
+    _BoundingBox = Aabb{};
+    for(const auto& p : _Positions){
+        _BoundingBox.extend(p);
+    }
+}
+
+CpuMesh CpuMesh::primitiveRectangle(float width, float height){
+    CpuMesh mesh{};
+    float hw = width / 2.f;
+    float hh = height / 2.f;
+    mesh._Positions = {
+        {-hw, -hh, 0.f},
+        { hw, -hh, 0.f},
+        { hw,  hh, 0.f},
+        {-hw,  hh, 0.f},
+    };
+    mesh._Normals = std::vector<Vec3>(4, Vec3(0.f, 0.f, 1.f));
+    mesh._Indices = {0, 1, 2, 0, 2, 3};
+    mesh.computeBoundingBox();
+    return mesh;
+}
+
+CpuMesh CpuMesh::primitiveSphere(uint32_t nbSegments){
+    CpuMesh mesh{};
+    uint32_t nbRings = nbSegments;
+    for(uint32_t ring=0; ring<=nbRings; ring++){
+        float theta = CPU_PI * ring / nbRings;
+        for(uint32_t seg=0; seg<=nbSegments; seg++){
+            float phi = 2.f * CPU_PI * seg / nbSegments;
+            Vec3 p = {
+                std::sin(theta) * std::cos(phi),
+                std::cos(theta),
+                std::sin(theta) * std::sin(phi)
+            };
+            mesh._Positions.push_back(p);
+            mesh._Normals.push_back(p);
+        }
+    }
+    uint32_t stride = nbSegments + 1;
+    for(uint32_t ring=0; ring<nbRings; ring++){
+        for(uint32_t seg=0; seg<nbSegments; seg++){
+            uint32_t i0 = ring*stride + seg;
+            uint32_t i1 = i0 + stride;
+            mesh._Indices.insert(mesh._Indices.end(), {i0, i0+1, i1});
+            mesh._Indices.insert(mesh._Indices.end(), {i0+1, i1+1, i1});
+        }
+    }
+    mesh.computeBoundingBox();
+    return mesh;
+}
+
+namespace{
+
+bool readText(const std::string& path, std::string& text){
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file.is_open()){
+        fprintf(stderr, "Failed to open the model %s!\n", path.c_str());
+        return false;
+    }
+    text.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if(!file.read(text.data(), static_cast<std::streamsize>(text.size()))){
+        fprintf(stderr, "Failed to read the model %s!\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
+
+bool CpuMesh::loadOFF(const std::string& path, CpuMesh& mesh){
+    std::string text{};
+    if(!readText(path, text) || !parseOFF(text, path, mesh)) return false;
+    mesh.computeNormals();
+    mesh.computeBoundingBox();
+    return true;
+}
+
+bool CpuMesh::loadOBJ(const std::string& path, CpuMesh& mesh){
+    std::string text{};
+    if(!readText(path, text) || !parseOBJ(text, path, mesh)) return false;
+    mesh.computeNormals();
+    mesh.computeBoundingBox();
+    return true;
+}
+
+bool CpuMesh::load(const std::string& path, CpuMesh& mesh, const std::string& cacheDirectory, uint64_t cacheMaxSize){
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    if(extension != "off" && extension != "obj"){
+        fprintf(stderr, "Unsupported model format for %s!\n", path.c_str());
+        return false;
+    }
+
+    uint64_t key = cacheDirectory.empty() ? 0 : getMeshBinaryKey(path);
+    std::string binaryPath = key == 0 ? "" : getCachePath(cacheDirectory, CPU_CACHE_MESH, key);
+    bool isBinary = key != 0 && loadMeshBinary(binaryPath, key, mesh);
+    if(!isBinary){
+        bool isLoaded = extension == "off" ? loadOFF(path, mesh) : loadOBJ(path, mesh);
+        if(!isLoaded) return false;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    fprintf(stdout, "Model %s %s in %fs: %zu vertices, %zu triangles\n",
+        path.c_str(),
+        isBinary ? "loaded from its binary copy" : "parsed",
+        std::chrono::duration<float, std::chrono::seconds::period>(end - start).count(),
+        mesh._Positions.size(),
+        mesh._Indices.size() / 3
+    );
+    if(!isBinary && key != 0){
+        saveMeshBinary(binaryPath, key, mesh, cacheMaxSize);
+    }
+    return true;
+}
+
+
+
+void CpuMaterial::setParameters(const float* parameters, const bool* isSet){
+    auto isRead = [&](uint32_t id){return isSet == nullptr || isSet[id];};
+    if(isRead(MaterialDescription::METALLIC)) _Metallic = parameters[MaterialDescription::METALLIC];
+    if(isRead(MaterialDescription::SPECULAR)) _Specular = parameters[MaterialDescription::SPECULAR];
+    if(isRead(MaterialDescription::ROUGHNESS)) _Roughness = parameters[MaterialDescription::ROUGHNESS];
+}
+
+
+
+/********************************************************************/
+/****************************** SCENE *******************************/
+/********************************************************************/
+uint32_t CpuScene::addGeometry(const CpuMesh& mesh){
+    CpuGeometry geometry{};
+    geometry._Triangles.reserve(mesh._Indices.size()/3);
+    for(size_t i=0; i+2<mesh._Indices.size(); i+=3){
+        uint32_t i0 = mesh._Indices[i];
+        uint32_t i1 = mesh._Indices[i+1];
+        uint32_t i2 = mesh._Indices[i+2];
+        geometry._Triangles.push_back({
+            ._V0 = mesh._Positions[i0],
+            ._V1 = mesh._Positions[i1],
+            ._V2 = mesh._Positions[i2],
+            ._N0 = mesh._Normals[i0],
+            ._N1 = mesh._Normals[i1],
+            ._N2 = mesh._Normals[i2],
+        });
+    }
+    geometry._BoundingBox = mesh._BoundingBox;
+    _Geometries.push_back(std::move(geometry));
+    return static_cast<uint32_t>(_Geometries.size() - 1);
+}
+
+uint32_t CpuScene::addInstance(uint32_t geometryId, const CpuTransform& transform, const CpuMaterial& material){
+    uint32_t materialId = static_cast<uint32_t>(_Materials.size());
+    _Materials.push_back(material);
+    _Instances.push_back({._GeometryId = geometryId, ._MaterialId = materialId});
+    uint32_t instanceId = static_cast<uint32_t>(_Instances.size() - 1);
+    setInstanceTransform(instanceId, transform);
+    return instanceId;
+}
+
+void CpuScene::setInstanceTransform(uint32_t instanceId, const CpuTransform& transform){
+    CpuMeshInstance& instance = _Instances[instanceId];
+    instance._ObjectToWorld = transform.getModel();
+    instance._WorldToObject = instance._ObjectToWorld.inverse();
+}
+
+Aabb CpuScene::getInstanceBoundingBox(uint32_t instanceId) const {
+    const CpuMeshInstance& instance = _Instances[instanceId];
+    const Aabb& box = _Geometries[instance._GeometryId]._BoundingBox;
+    Aabb worldBox{};
+    if(box.isEmpty()) return worldBox;
+    for(uint32_t i=0; i<8; i++){
+        Vec3 corner = {
+            (i & 1) ? box._Max.x : box._Min.x,
+            (i & 2) ? box._Max.y : box._Min.y,
+            (i & 4) ? box._Max.z : box._Min.z,
+        };
+        worldBox.extend(instance._ObjectToWorld.transformPoint(corner));
+    }
+    return worldBox;
+}
+
+size_t CpuScene::getNbTriangles() const {
+    size_t nbTriangles = 0;
+    for(const auto& instance : _Instances){
+        nbTriangles += _Geometries[instance._GeometryId]._Triangles.size();
+    }
+    return nbTriangles;
+}
+
+size_t CpuScene::getNbUniqueTriangles() const {
+    size_t nbTriangles = 0;
+    for(const auto& geometry : _Geometries){
+        nbTriangles += geometry._Triangles.size();
+    }
+    return nbTriangles;
+}
+
+void CpuScene::addPointLight(const Vec3& position, const Vec3& color, float intensity){
+    _PointLights.push_back({
+        ._Position = position,
+        ._Color = color,
+        ._Intensity = intensity
+    });
+}
+
+void CpuScene::removePointLight(uint32_t lightId){
+    _PointLights[lightId] = _PointLights.back();
+    _PointLights.pop_back();
+}
+
+void CpuScene::addDirectionalLight(const Vec3& direction, const Vec3& color, float intensity){
+    _DirectionalLights.push_back({
+        ._Direction = normalize(direction),
+        ._Color = color,
+        ._Intensity = intensity
+    });
+}
+
+void CpuScene::addCubeOfLight(const LightCubeDescription& cube){
+    _PendingLightCubes.push_back(cube);
+}
+
+static void expandLightCube(const LightCubeDescription& cube, CpuPointLight* lights){
+    CpuTransform transform{};
+    transform._Position = cube._Center;
+    transform._Rotation = cube._Rotation;
+    Matrix3x4 model = transform.getModel();
+
+    uint32_t nbSteps[3] = {cube.getNbSteps(0), cube.getNbSteps(1), cube.getNbSteps(2)};
+    uint32_t cur = 0;
+    for(uint32_t i=0; i<=nbSteps[0]; i++){
+        for(uint32_t j=0; j<=nbSteps[1]; j++){
+            for(uint32_t k=0; k<=nbSteps[2]; k++){
+                bool isOnFace = i==0 || j==0 || k==0
+                    || i==nbSteps[0] || j==nbSteps[1] || k==nbSteps[2];
+                if(!isOnFace) continue;
+                Vec3 local = {
+                    cube._Scale.x * (static_cast<float>(i) / nbSteps[0] - 0.5f),
+                    cube._Scale.y * (static_cast<float>(j) / nbSteps[1] - 0.5f),
+                    cube._Scale.z * (static_cast<float>(k) / nbSteps[2] - 0.5f),
+                };
+                lights[cur++] = {
+                    ._Position = model.transformPoint(local),
+                    ._Color = cube._Color,
+                    ._Intensity = cube._Intensity
+                };
+            }
+        }
+    }
+}
+
+void CpuScene::expandLightCubes(){
+    if(_PendingLightCubes.empty()) return;
+
+    // offsets of each grid in the contiguous array
+    std::vector<size_t> offsets(_PendingLightCubes.size());
+    size_t nbLights = _PointLights.size();
+    for(size_t i=0; i<_PendingLightCubes.size(); i++){
+        offsets[i] = nbLights;
+        nbLights += _PendingLightCubes[i].getNbLights();
+    }
+    _PointLights.resize(nbLights);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i=0; i<_PendingLightCubes.size(); i++){
+        expandLightCube(_PendingLightCubes[i], &_PointLights[offsets[i]]);
+    }
+    _PendingLightCubes.clear();
+}
+
+CpuScenePtr CpuScene::createFromDescription(const SceneDescription& description, const std::string& cacheDirectory, uint64_t cacheMaxSize){
+    CpuScenePtr scene = CpuScenePtr(new CpuScene());
+
+    // identical meshes share their geometry
+    std::vector<std::string> keys(description._Meshes.size());
+    std::unordered_map<std::string, uint32_t> uniqueIds{};
+    std::vector<size_t> uniqueMeshes{};
+    uint32_t nbModels = 0;
+    for(size_t i=0; i<description._Meshes.size(); i++){
+        const auto& meshDescription = description._Meshes[i];
+        switch(meshDescription._Type){
+            case MESH_RECTANGLE:
+                keys[i] = "rectangle " + std::to_string(meshDescription._Width) + " " + std::to_string(meshDescription._Height);
+                break;
+            case MESH_SPHERE:
+                keys[i] = "sphere " + std::to_string(meshDescription._NbSegments);
+                break;
+            case MESH_MODEL:
+                keys[i] = "model " + meshDescription._Path;
+                break;
+        }
+        if(uniqueIds.emplace(keys[i], static_cast<uint32_t>(uniqueMeshes.size())).second){
+            uniqueMeshes.push_back(i);
+            if(meshDescription._Type == MESH_MODEL) nbModels++;
+        }
+    }
+
+    // the models are decoded in parallel, a single one keeps every thread for its own parser
+    std::vector<CpuMesh> meshes(uniqueMeshes.size());
+    std::vector<uint8_t> isLoaded(uniqueMeshes.size(), 1);
+    #pragma omp parallel for schedule(dynamic) if(nbModels > 1)
+    for(size_t i=0; i<uniqueMeshes.size(); i++){
+        const auto& meshDescription = description._Meshes[uniqueMeshes[i]];
+        switch(meshDescription._Type){
+            case MESH_RECTANGLE:
+                meshes[i] = CpuMesh::primitiveRectangle(meshDescription._Width, meshDescription._Height);
+                break;
+            case MESH_SPHERE:
+                meshes[i] = CpuMesh::primitiveSphere(meshDescription._NbSegments);
+                break;
+            case MESH_MODEL:
+                isLoaded[i] = CpuMesh::load(meshDescription._Path, meshes[i], cacheDirectory, cacheMaxSize);
+                break;
+        }
+    }
+
+    std::vector<uint32_t> geometryIds(uniqueMeshes.size());
+    for(size_t i=0; i<uniqueMeshes.size(); i++){
+        if(!isLoaded[i]) return nullptr;
+        geometryIds[i] = scene->addGeometry(meshes[i]);
+    }
+    for(size_t i=0; i<description._Meshes.size(); i++){
+        const auto& meshDescription = description._Meshes[i];
+        CpuMaterial material{._Albedo = meshDescription._Color};
+        if(meshDescription._Material._IsDefined){
+            material.setParameters(meshDescription._Material._Parameters.data(), meshDescription._Material._IsSet.data());
+        }
+        // the material ids follow the meshes of the description
+        scene->addInstance(geometryIds[uniqueIds[keys[i]]], meshDescription._Transform, material);
+    }
+
+    scene->_PointLights.reserve(description.getNbPointLights());
+    for(const auto& light : description._PointLights){
+        scene->addPointLight(light._Position, light._Color, light._Intensity);
+    }
+    for(const auto& cube : description._LightCubes){
+        scene->addCubeOfLight(cube);
+    }
+    scene->expandLightCubes();
+    for(const auto& light : description._DirectionalLights){
+        scene->addDirectionalLight(light._Direction, light._Color, light._Intensity);
+    }
+
+    const CameraDescription& camera = description._Camera;
+    scene->setCamera({
+        ._Eye = camera._Eye,
+        ._At = camera._At,
+        ._Up = camera._Up,
+        ._Fov = camera._Fov
+    });
+    return scene;
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpuCacheFile.hpp"
+#include "cpuMath.hpp"
+#include "sceneDescription.hpp"
+
+class CpuScene;
+using CpuScenePtr = std::shared_ptr<CpuScene>;
+
+struct CpuMaterial{
+    Vec3 _Albedo{1.f};
+    // only read by the ggx brdf, disney defaults
+    float _Metallic = 0.f;
+    float _Specular = 0.5f;
+    float _Roughness = 0.5f;
+
+    // parameters in the order of MaterialDescription::PARAMETER_NAMES, only the set ones are read
+    void setParameters(const float* parameters, const bool* isSet = nullptr);
+};
+
+// object space triangle with per vertex normals
+struct CpuTriangle{
+    Vec3 _V0{};
+    Vec3 _V1{};
+    Vec3 _V2{};
+    Vec3 _N0{};
+    Vec3 _N1{};
+    Vec3 _N2{};
+};
+
+struct CpuPointLight{
+    Vec3 _Position{};
+    Vec3 _Color{1.f};
+    float _Intensity = 1.f;
+    // virtual point lights only emit around the normal of their surface with a cosine falloff
+    // the normal of the lights of the scene is null, they emit the same way in every direction
+    Vec3 _Normal{0.f};
+
+    Vec3 getIntensity() const {return _Color * _Intensity;}
+    bool isOriented() const {return _Normal.x != 0.f || _Normal.y != 0.f || _Normal.z != 0.f;}
+};
+
+struct CpuDirectionalLight{
+    // direction the light travels toward
+    Vec3 _Direction{0.f, -1.f, 0.f};
+    Vec3 _Color{1.f};
+    float _Intensity = 1.f;
+
+    Vec3 getIntensity() const {return _Color * _Intensity;}
+};
+
+struct CpuCamera{
+    Vec3 _Eye{0.f, 0.f, 20.f};
+    Vec3 _At{0.f, 0.f, 0.f};
+    Vec3 _Up{0.f, 1.f, 0.f};
+    // vertical field of view in degrees
+    float _Fov = 45.f;
+};
+
+// indexed mesh in object space
+struct CpuMesh{
+    std::vector<Vec3> _Positions{};
+    std::vector<Vec3> _Normals{};
+    std::vector<uint32_t> _Indices{};
+    Aabb _BoundingBox{};
+
+    void computeNormals();
+    void computeBoundingBox();
+
+    // same primitives as be::VertexDataBuilder
+    static CpuMesh primitiveRectangle(float width, float height);
+    static CpuMesh primitiveSphere(uint32_t nbSegments);
+
+    // return false if the file can't be read
+    static bool loadOFF(const std::string& path, CpuMesh& mesh);
+    static bool loadOBJ(const std::string& path, CpuMesh& mesh);
+    // the text model is only parsed if its binary copy in the cache directory is missing or older,
+    // the copy is written afterwards, an empty directory always parses the model
+    static bool load(const std::string& path, CpuMesh& mesh, const std::string& cacheDirectory = "",
+        uint64_t cacheMaxSize = CpuCacheWriter::DEFAULT_MAX_DIRECTORY_SIZE);
+};
+
+// triangles of a mesh, shared by every instance of the mesh
+struct CpuGeometry{
+    std::vector<CpuTriangle> _Triangles{};
+    Aabb _BoundingBox{};
+};
+
+struct CpuMeshInstance{
+    uint32_t _GeometryId = 0;
+    uint32_t _MaterialId = 0;
+    Matrix3x4 _ObjectToWorld{};
+    Matrix3x4 _WorldToObject{};
+};
+
+class CpuScene{
+
+    private:
+        std::vector<CpuGeometry> _Geometries{};
+        std::vector<CpuMeshInstance> _Instances{};
+        std::vector<CpuMaterial> _Materials{};
+        std::vector<CpuPointLight> _PointLights{};
+        std::vector<CpuDirectionalLight> _DirectionalLights{};
+        CpuCamera _Camera{};
+
+        // light grids waiting to be expanded into _PointLights
+        std::vector<LightCubeDescription> _PendingLightCubes{};
+
+    public:
+        CpuScene(){};
+
+        // return the id of the geometry, meshes used several times must only be added once
+        uint32_t addGeometry(const CpuMesh& mesh);
+        // return the id of the instance
+        uint32_t addInstance(uint32_t geometryId, const CpuTransform& transform, const CpuMaterial& material);
+        // only the top level of the acceleration structure needs a refit afterwards
+        void setInstanceTransform(uint32_t instanceId, const CpuTransform& transform);
+        // never during a render
+        void setMaterial(uint32_t materialId, const CpuMaterial& material){_Materials[materialId] = material;}
+        void addPointLight(const Vec3& position, const Vec3& color, float intensity);
+        void setPointLight(uint32_t lightId, const CpuPointLight& light){_PointLights[lightId] = light;}
+        // the last light takes the id of the removed one
+        void removePointLight(uint32_t lightId);
+        void addDirectionalLight(const Vec3& direction, const Vec3& color, float intensity);
+        // cpu counterpart of be::Scene::addCubeOfLight, lights lie on the faces of the cube
+        // the grid is only recorded here and expanded by expandLightCubes
+        void addCubeOfLight(const LightCubeDescription& cube);
+        // write every pending grid into the point lights array in a single allocation
+        void expandLightCubes();
+        void setCamera(const CpuCamera& camera){_Camera = camera;}
+
+        const std::vector<CpuGeometry>& getGeometries() const {return _Geometries;}
+        const std::vector<CpuMeshInstance>& getInstances() const {return _Instances;}
+        // world space bounding box of an instance
+        Aabb getInstanceBoundingBox(uint32_t instanceId) const;
+        // triangles once every instance is expanded
+        size_t getNbTriangles() const;
+        size_t getNbUniqueTriangles() const;
+        const std::vector<CpuMaterial>& getMaterials() const {return _Materials;}
+        const std::vector<CpuPointLight>& getPointLights() const {return _PointLights;}
+        const std::vector<CpuDirectionalLight>& getDirectionalLights() const {return _DirectionalLights;}
+        const CpuCamera& getCamera() const {return _Camera;}
+
+    public:
+        // return nullptr if a model of the scene can't be loaded
+        // the binary copies of the models are kept in the cache directory, empty disables them
+        static CpuScenePtr createFromDescription(const SceneDescription& description, const std::string& cacheDirectory = "",
+            uint64_t cacheMaxSize = CpuCacheWriter::DEFAULT_MAX_DIRECTORY_SIZE);
+};
\ No newline at end of file
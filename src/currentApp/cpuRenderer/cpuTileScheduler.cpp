@@ -0,0 +1,153 @@
+#include "cpuTileScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+void CpuSchedulerStats::print() const {
+    fprintf(stdout, "Scheduler: %u threads, %u tiles (%u stolen), %.1f%% utilisation, last thread finished %.2fms after the first\n",
+        _NbThreads,
+        _NbTiles,
+        _NbStolenTiles,
+        _Utilisation * 100.f,
+        _TailTime * 1000.f
+    );
+    fprintf(stdout, "Tile times: min %.3fms, average %.3fms, max %.3fms\n",
+        _MinTileTime * 1000.f,
+        _AverageTileTime * 1000.f,
+        _MaxTileTime * 1000.f
+    );
+}
+
+// interleave the bits of x and y
+static uint32_t mortonCode(uint32_t x, uint32_t y){
+    auto spread = [](uint32_t v){
+        v &= 0x0000ffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+CpuTileScheduler::CpuTileScheduler(uint32_t width, uint32_t height, uint32_t tileSize, uint32_t nbThreads){
+    _NbThreads = nbThreads > 0 ? nbThreads : std::max(1u, std::thread::hardware_concurrency());
+    tileSize = std::max(1u, tileSize);
+
+    uint32_t nbTilesX = (width + tileSize - 1) / tileSize;
+    uint32_t nbTilesY = (height + tileSize - 1) / tileSize;
+    std::vector<std::pair<uint32_t, CpuTile>> tiles{};
+    tiles.reserve(nbTilesX * nbTilesY);
+    for(uint32_t ty=0; ty<nbTilesY; ty++){
+        for(uint32_t tx=0; tx<nbTilesX; tx++){
+            CpuTile tile{
+                ._X = tx * tileSize,
+                ._Y = ty * tileSize,
+                ._Width = std::min(tileSize, width - tx * tileSize),
+                ._Height = std::min(tileSize, height - ty * tileSize)
+            };
+            tiles.push_back({mortonCode(tx, ty), tile});
+        }
+    }
+    std::sort(tiles.begin(), tiles.end(), [](const auto& a, const auto& b){return a.first < b.first;});
+
+    _Tiles.reserve(tiles.size());
+    for(const auto& tile : tiles){
+        _Tiles.push_back(tile.second);
+    }
+}
+
+bool CpuTileScheduler::popTile(std::vector<WorkerQueue>& queues, uint32_t threadId, uint32_t& tile, bool& isStolen) const {
+    {
+        WorkerQueue& own = queues[threadId];
+        std::lock_guard<std::mutex> lock(own._Mutex);
+        if(!own._Tiles.empty()){
+            tile = own._Tiles.front();
+            own._Tiles.pop_front();
+            isStolen = false;
+            return true;
+        }
+    }
+    // tiles are never added during a frame, every queue being empty means the frame is done
+    for(uint32_t i=1; i<_NbThreads; i++){
+        WorkerQueue& victim = queues[(threadId + i) % _NbThreads];
+        std::lock_guard<std::mutex> lock(victim._Mutex);
+        if(!victim._Tiles.empty()){
+            tile = victim._Tiles.back();
+            victim._Tiles.pop_back();
+            isStolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CpuTileScheduler::run(const std::function<void(const CpuTile&, uint32_t)>& renderTile, const std::atomic<bool>* isCancelled){
+    uint32_t nbTiles = getNbTiles();
+    std::vector<WorkerQueue> queues(_NbThreads);
+    // contiguous ranges of the morton order keep the tiles of a thread close to each other
+    for(uint32_t t=0; t<_NbThreads; t++){
+        uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(nbTiles) * t / _NbThreads);
+        uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(nbTiles) * (t+1) / _NbThreads);
+        for(uint32_t i=first; i<last; i++){
+            queues[t]._Tiles.push_back(i);
+        }
+    }
+
+    std::vector<float> tileTimes(nbTiles, 0.f);
+    std::vector<float> busyTimes(_NbThreads, 0.f);
+    std::vector<float> finishTimes(_NbThreads, 0.f);
+    std::atomic<uint32_t> nbStolenTiles{0};
+    auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&](uint32_t threadId){
+        uint32_t tile = 0;
+        bool isStolen = false;
+        while((isCancelled == nullptr || !*isCancelled) && popTile(queues, threadId, tile, isStolen)){
+            if(isStolen) nbStolenTiles++;
+            auto tileStart = std::chrono::steady_clock::now();
+            renderTile(_Tiles[tile], threadId);
+            auto tileEnd = std::chrono::steady_clock::now();
+            tileTimes[tile] = std::chrono::duration<float, std::chrono::seconds::period>(tileEnd - tileStart).count();
+            busyTimes[threadId] += tileTimes[tile];
+        }
+        finishTimes[threadId] = std::chrono::duration<float, std::chrono::seconds::period>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+    };
+
+    // the calling thread is the first worker
+    std::vector<std::thread> threads{};
+    threads.reserve(_NbThreads - 1);
+    for(uint32_t t=1; t<_NbThreads; t++){
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for(auto& thread : threads){
+        thread.join();
+    }
+    float wallTime = std::chrono::duration<float, std::chrono::seconds::period>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+
+    _Stats = CpuSchedulerStats{};
+    _Stats._NbThreads = _NbThreads;
+    _Stats._NbTiles = nbTiles;
+    _Stats._NbStolenTiles = nbStolenTiles;
+    if(nbTiles > 0){
+        _Stats._MinTileTime = *std::min_element(tileTimes.begin(), tileTimes.end());
+        _Stats._MaxTileTime = *std::max_element(tileTimes.begin(), tileTimes.end());
+        float totalBusyTime = 0.f;
+        for(float busyTime : busyTimes){
+            totalBusyTime += busyTime;
+        }
+        _Stats._AverageTileTime = totalBusyTime / nbTiles;
+        _Stats._Utilisation = wallTime > 0.f ? totalBusyTime / (wallTime * _NbThreads) : 1.f;
+    }
+    auto finish = std::minmax_element(finishTimes.begin(), finishTimes.end());
+    _Stats._TailTime = *finish.second - *finish.first;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class CpuTileScheduler;
+using CpuTileSchedulerPtr = std::shared_ptr<CpuTileScheduler>;
+
+struct CpuTile{
+    uint32_t _X = 0;
+    uint32_t _Y = 0;
+    uint32_t _Width = 0;
+    uint32_t _Height = 0;
+};
+
+struct CpuSchedulerStats{
+    uint32_t _NbThreads = 0;
+    uint32_t _NbTiles = 0;
+    uint32_t _NbStolenTiles = 0;
+    // in seconds
+    float _MinTileTime = 0.f;
+    float _AverageTileTime = 0.f;
+    float _MaxTileTime = 0.f;
+    // busy time of every thread over the wall time of the frame
+    float _Utilisation = 0.f;
+    // time between the first and the last thread running out of tiles
+    float _TailTime = 0.f;
+
+    void print() const;
+};
+
+// splits the image in tiles visited in morton order, each thread owns a deque of
+// neighbouring tiles and steals from the back of the others once its own is empty
+class CpuTileScheduler{
+
+    public:
+        static const uint32_t DEFAULT_TILE_SIZE = 16;
+
+    private:
+        struct WorkerQueue{
+            std::mutex _Mutex{};
+            std::deque<uint32_t> _Tiles{};
+        };
+
+        std::vector<CpuTile> _Tiles{};
+        uint32_t _NbThreads = 1;
+        CpuSchedulerStats _Stats{};
+
+    public:
+        // nbThreads set to 0 uses every core
+        CpuTileScheduler(uint32_t width, uint32_t height, uint32_t tileSize = DEFAULT_TILE_SIZE, uint32_t nbThreads = 0);
+
+        // call renderTile(tile, threadId) once for every tile, threadId is below getNbThreads
+        // once isCancelled is set, the tiles being rendered are finished and the others are skipped
+        void run(const std::function<void(const CpuTile&, uint32_t)>& renderTile, const std::atomic<bool>* isCancelled = nullptr);
+
+        uint32_t getNbThreads() const {return _NbThreads;}
+        uint32_t getNbTiles() const {return static_cast<uint32_t>(_Tiles.size());}
+        const CpuSchedulerStats& getStats() const {return _Stats;}
+
+        static uint32_t getNbTiles(uint32_t width, uint32_t height, uint32_t tileSize){
+            tileSize = std::max(1u, tileSize);
+            return ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+        }
+
+    private:
+        bool popTile(std::vector<WorkerQueue>& queues, uint32_t threadId, uint32_t& tile, bool& isStolen) const;
+};
\ No newline at end of file
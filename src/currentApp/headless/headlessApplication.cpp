@@ -0,0 +1,359 @@
+#include "headlessApplication.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/********************************************************************/
+/************************* ARGUMENTS PARSING ************************/
+/********************************************************************/
+static bool parseUint(const char* value, uint32_t& result){
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(value, &end, 10);
+    if(end == value || *end != '\0') return false;
+    result = static_cast<uint32_t>(parsed);
+    return true;
+}
+
+static bool parseUint(const char* value, std::optional<uint32_t>& result){
+    uint32_t parsed = 0;
+    if(!parseUint(value, parsed)) return false;
+    result = parsed;
+    return true;
+}
+
+static bool parseFloat(const char* value, std::optional<float>& result){
+    char* end = nullptr;
+    float parsed = std::strtof(value, &end);
+    if(end == value || *end != '\0') return false;
+    result = parsed;
+    return true;
+}
+
+bool HeadlessApplication::isRequested(int argc, char* argv[]){
+    for(int i=1; i<argc; i++){
+        if(strcmp(argv[i], "--headless") == 0) return true;
+    }
+    return false;
+}
+
+void HeadlessApplication::printUsage(const char* programName){
+    fprintf(stderr,
+        "Usage: %s --headless [options]\n"
+        "  --scene <name|file>        scene file, or name of a scene in resources/scenes (default spheres)\n"
+        "  --width <pixels>           image width (default %u)\n"
+        "  --height <pixels>          image height (default %u)\n"
+        "  --brdf <name>              color, normal, lambert or ggx (default lambert)\n"
+        "  --threads <n>              render threads (default 0, every core)\n"
+        "  --tile-size <pixels>       size of the square tiles shared between threads (default %u)\n"
+        "  --light-tree <name>        light tree builder, greedy or ploc (default ploc)\n"
+        "  --cut-coherence            start the cut of each pixel from the one of the previous pixel\n"
+        "  --multidimensional         one cut over pairs of gather and light clusters for the bounces of a camera hit\n"
+        "  --max-gather-cut <n>       maximum size of a multidimensional cut (default %u)\n"
+        "  --reconstruction-cuts      full cuts only on a grid of samples, the other pixels reuse them\n"
+        "  --reconstruction-spacing <pixels>  spacing of the samples of the reconstruction cuts (default %u)\n"
+        "  --vpls                     add virtual point lights left by light paths to the light tree\n"
+        "  --vpl-paths <n>            light paths traced from the point lights (default %u)\n"
+        "  --vpl-bounces <n>          virtual point lights left by each light path (default 1)\n"
+        "  --vpl-clamp <f>            maximum geometric term of a virtual point light (default %.2f)\n"
+        "  --cache <dir>              directory of the cached models, bvhs and light trees (default %s)\n"
+        "  --no-cache                 always parse the models and build the bvhs and the light tree\n"
+        "  --cache-size <mb>          size of the cache directory before its least recently used files are removed, 0 for no limit (default %llu)\n"
+        "  --light-tree-stats         print the average cut size at 2%% error without visibility\n"
+        "  --light-edits <n>          insert, remove or move n random point lights through light tree updates before rendering\n"
+        "  --simd <level>             cluster bounds kernel, scalar, sse or avx2 (default best supported)\n"
+        "The following options override the raytracer settings of the scene file:\n"
+        "  --spp <n>                  samples per pixels\n"
+        "  --bounces <n>              max bounces of the path tracer\n"
+        "  --bounce-samples <n>       samples per bounces\n"
+        "  --shading-factor <f>       shading factor for bounces\n"
+        "  --lightcuts, --no-lightcuts  use the lightcuts algorithm or not\n"
+        "  --error <f>                lightcuts error threshold\n"
+        "  --max-cut <n>              maximum size of a cut\n"
+        "  -o <file>                  output ppm image (default lightcuts.ppm)\n"
+        "  --help                     print this message\n",
+        programName, DEFAULT_WIDTH, DEFAULT_HEIGHT, CpuTileScheduler::DEFAULT_TILE_SIZE, 
+        CpuRayTracer::DEFAULT_GATHER_MAX_CLUSTERS, CpuRayTracer::DEFAULT_RECONSTRUCTION_SPACING,
+        CpuRayTracer::DEFAULT_NB_VPL_PATHS, CpuRayTracer::DEFAULT_VPL_CLAMP, CpuRayTracer::DEFAULT_CACHE_DIRECTORY,
+        static_cast<unsigned long long>(CpuCacheWriter::DEFAULT_MAX_DIRECTORY_SIZE >> 20)
+    );
+}
+
+bool HeadlessApplication::parseArguments(int argc, char* argv[]){
+    for(int i=1; i<argc; i++){
+        std::string arg = argv[i];
+        if(arg == "--headless") continue;
+        if(arg == "--help" || arg == "-h"){
+            _ShowHelp = true;
+            continue;
+        }
+        if(arg == "--lightcuts" || arg == "--no-lightcuts"){
+            _UseLightCuts = (arg == "--lightcuts");
+            continue;
+        }
+        if(arg == "--cut-coherence"){
+            _UseCutCoherence = true;
+            continue;
+        }
+        if(arg == "--multidimensional"){
+            _UseMultidimensionalLightcuts = true;
+            continue;
+        }
+        if(arg == "--reconstruction-cuts"){
+            _UseReconstructionCuts = true;
+            continue;
+        }
+        if(arg == "--vpls"){
+            _UseVpls = true;
+            continue;
+        }
+        if(arg == "--no-cache"){
+            _CacheDirectory.clear();
+            continue;
+        }
+        if(arg == "--light-tree-stats"){
+            _PrintLightTreeQuality = true;
+            continue;
+        }
+
+        // every other option needs a value
+        if(i+1 >= argc){
+            fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+        bool isValid = true;
+        if(arg == "--scene") _SceneName = value;
+        else if(arg == "--cache") _CacheDirectory = value;
+        else if(arg == "--cache-size") isValid = parseUint(value, _CacheMaxSize);
+        else if(arg == "-o" || arg == "--output") _OutputPath = value;
+        else if(arg == "--width") isValid = parseUint(value, _Width) && _Width > 0;
+        else if(arg == "--height") isValid = parseUint(value, _Height) && _Height > 0;
+        else if(arg == "--threads") isValid = parseUint(value, _NbThreads);
+        else if(arg == "--tile-size") isValid = parseUint(value, _TileSize) && _TileSize > 0;
+        else if(arg == "--light-edits") isValid = parseUint(value, _NbLightEdits);
+        else if(arg == "--max-gather-cut") isValid = parseUint(value, _GatherMaxClusters) && _GatherMaxClusters > 0;
+        else if(arg == "--reconstruction-spacing") isValid = parseUint(value, _ReconstructionSpacing) && _ReconstructionSpacing > 0;
+        else if(arg == "--vpl-paths") isValid = parseUint(value, _NbVplPaths) && _NbVplPaths > 0;
+        else if(arg == "--vpl-bounces") isValid = parseUint(value, _VplBounces) && _VplBounces > 0;
+        else if(arg == "--vpl-clamp") isValid = parseFloat(value, _VplClamp) && *_VplClamp > 0.f;
+        else if(arg == "--spp") isValid = parseUint(value, _SamplesPerPixels) && *_SamplesPerPixels > 0;
+        else if(arg == "--bounces") isValid = parseUint(value, _MaxBounces);
+        else if(arg == "--bounce-samples") isValid = parseUint(value, _SamplesPerBounces) && *_SamplesPerBounces > 0;
+        else if(arg == "--shading-factor") isValid = parseFloat(value, _ShadingFactor);
+        else if(arg == "--error") isValid = parseFloat(value, _LightcutsErrorThreshold) && *_LightcutsErrorThreshold >= 0.f;
+        else if(arg == "--max-cut") isValid = parseUint(value, _LightcutsMaxClusters) && *_LightcutsMaxClusters > 0;
+        else if(arg == "--brdf"){
+            std::string brdf = value;
+            if(brdf == "color") _BRDFModel = CPU_COLOR_BRDF;
+            else if(brdf == "normal") _BRDFModel = CPU_NORMAL_BRDF;
+            else if(brdf == "lambert") _BRDFModel = CPU_LAMBERT_BRDF;
+            else if(brdf == "ggx") _BRDFModel = CPU_GGX_BRDF;
+            else isValid = false;
+        } else if(arg == "--light-tree"){
+            std::string builder = value;
+            if(builder == "greedy") _LightTreeBuilder = CPU_LIGHT_TREE_GREEDY;
+            else if(builder == "ploc") _LightTreeBuilder = CPU_LIGHT_TREE_LOCALLY_ORDERED;
+            else isValid = false;
+        } else if(arg == "--simd"){
+            std::string level = value;
+            if(level == "scalar") _SimdLevel = CPU_SIMD_SCALAR;
+            else if(level == "sse") _SimdLevel = CPU_SIMD_SSE;
+            else if(level == "avx2") _SimdLevel = CPU_SIMD_AVX2;
+            else isValid = false;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+
+        if(!isValid){
+            fprintf(stderr, "Invalid value %s for %s\n", value, arg.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+/********************************************************************/
+/************************** INIT FUNCTIONS **************************/
+/********************************************************************/
+bool HeadlessApplication::initScene(){
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string path = SceneDescription::resolvePath(_SceneName);
+    if(!SceneDescription::load(path, _SceneDescription)){
+        return false;
+    }
+    auto parsed = std::chrono::high_resolution_clock::now();
+    _Scene = CpuScene::createFromDescription(_SceneDescription, _CacheDirectory, static_cast<uint64_t>(_CacheMaxSize) << 20);
+    if(_Scene == nullptr){
+        return false;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    fprintf(stdout, "Scene %s parsed in %.3fs, built in %.3fs: %zu triangles (%zu unique) in %zu instances, %zu point lights\n",
+        path.c_str(),
+        std::chrono::duration<float, std::chrono::seconds::period>(parsed - start).count(),
+        std::chrono::duration<float, std::chrono::seconds::period>(end - parsed).count(),
+        _Scene->getNbTriangles(),
+        _Scene->getNbUniqueTriangles(),
+        _Scene->getInstances().size(),
+        _Scene->getPointLights().size()
+    );
+    return true;
+}
+
+void HeadlessApplication::initRaytracer(){
+    const RayTracerDescription& settings = _SceneDescription._RayTracer;
+    _RayTracer = CpuRayTracerPtr(new CpuRayTracer(_Scene, _Width, _Height));
+    _RayTracer->_NbThreads = _NbThreads;
+    _RayTracer->_TileSize = _TileSize;
+    _RayTracer->_SamplesPerPixels = _SamplesPerPixels.value_or(settings._SamplesPerPixels);
+    _RayTracer->_MaxBounces = _MaxBounces.value_or(settings._MaxBounces);
+    _RayTracer->_SamplesPerBounces = _SamplesPerBounces.value_or(settings._SamplesPerBounces);
+    _RayTracer->_ShadingFactor = _ShadingFactor.value_or(settings._ShadingFactor);
+    _RayTracer->_UseLightCuts = _UseLightCuts.value_or(settings._UseLightCuts);
+    _RayTracer->_LightcutsErrorThreshold = _LightcutsErrorThreshold.value_or(settings._LightcutsErrorThreshold);
+    _RayTracer->_LightcutsMaxClusters = _LightcutsMaxClusters.value_or(settings._LightcutsMaxClusters);
+    _RayTracer->_UseCutCoherence = _UseCutCoherence;
+    _RayTracer->_UseMultidimensionalLightcuts = _UseMultidimensionalLightcuts;
+    _RayTracer->_GatherMaxClusters = _GatherMaxClusters;
+    _RayTracer->_UseReconstructionCuts = _UseReconstructionCuts;
+    _RayTracer->_ReconstructionSpacing = _ReconstructionSpacing;
+    _RayTracer->_UseVpls = _UseVpls;
+    _RayTracer->_NbVplPaths = _NbVplPaths;
+    _RayTracer->_VplBounces = _VplBounces;
+    _RayTracer->_VplClamp = _VplClamp.value_or(CpuRayTracer::DEFAULT_VPL_CLAMP);
+    _RayTracer->_LightTreeBuilder = _LightTreeBuilder;
+    _RayTracer->_CacheDirectory = _CacheDirectory;
+    _RayTracer->_CacheMaxSize = static_cast<uint64_t>(_CacheMaxSize) << 20;
+    if(_SimdLevel.has_value()){
+        setSimdLevel(*_SimdLevel);
+        if(getSimdLevel() != *_SimdLevel){
+            fprintf(stderr, "The cpu does not support %s, %s is used instead\n", getSimdLevelName(*_SimdLevel), getSimdLevelName(getSimdLevel()));
+        }
+    }
+    switch(_BRDFModel){
+        case CPU_COLOR_BRDF:
+            _RayTracer->enableColorBRDF();
+            break;
+        case CPU_NORMAL_BRDF:
+            _RayTracer->enableNormalBRDF();
+            break;
+        case CPU_LAMBERT_BRDF:
+            _RayTracer->enableLambertBRDF();
+            break;
+        case CPU_GGX_BRDF:
+            _RayTracer->enableGgxBRDF();
+            break;
+    }
+}
+
+
+
+void HeadlessApplication::applyLightEdits(){
+    if(_NbLightEdits == 0) return;
+    // the edits update the tree of the scene, it has to exist first
+    _RayTracer->initLights();
+    uint32_t nbRebuilds = _RayTracer->getStats()._NbLightTreeRebuilds;
+
+    // new lights stay around the current ones, moves are small next to the extent of the scene
+    Aabb bounds{};
+    for(const auto& light : _Scene->getPointLights()){
+        bounds.extend(light._Position);
+    }
+    if(bounds.isEmpty()){
+        for(uint32_t i=0; i<_Scene->getInstances().size(); i++){
+            bounds.extend(_Scene->getInstanceBoundingBox(i));
+        }
+    }
+    if(bounds.isEmpty()) bounds.extend(Vec3(0.f));
+    Vec3 extent = vmax(bounds.getDiagonal(), Vec3(1.f));
+
+    CpuRandom rng(_NbLightEdits);
+    uint32_t nbInserted = 0;
+    uint32_t nbRemoved = 0;
+    uint32_t nbMoved = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(uint32_t i=0; i<_NbLightEdits; i++){
+        uint32_t nbLights = static_cast<uint32_t>(_Scene->getPointLights().size());
+        // the tree keeps at least one light
+        uint32_t edit = nbLights <= 1 ? 0 : rng.nextUint() % 3;
+        if(edit == 0){
+            Vec3 position = bounds._Min + extent * Vec3(rng.nextFloat(), rng.nextFloat(), rng.nextFloat());
+            CpuPointLight model{};
+            if(nbLights > 0) model = _Scene->getPointLights()[rng.nextUint() % nbLights];
+            _Scene->addPointLight(position, model._Color, model._Intensity);
+            _RayTracer->insertLight();
+            nbInserted++;
+        } else if(edit == 1){
+            uint32_t lightId = rng.nextUint() % nbLights;
+            _Scene->removePointLight(lightId);
+            _RayTracer->removeLight(lightId);
+            nbRemoved++;
+        } else {
+            uint32_t lightId = rng.nextUint() % nbLights;
+            CpuPointLight light = _Scene->getPointLights()[lightId];
+            Vec3 offset = Vec3(rng.nextFloat(), rng.nextFloat(), rng.nextFloat()) - Vec3(0.5f);
+            light._Position += extent * offset * 0.1f;
+            _Scene->setPointLight(lightId, light);
+            _RayTracer->refitLight(lightId);
+            nbMoved++;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    const CpuRenderStats& stats = _RayTracer->getStats();
+    fprintf(stdout, "Light edits: %u inserted, %u removed and %u moved in %.3fms, %.2fx the cost per unit of intensity of the tree since its last build, %u rebuilds triggered\n",
+        nbInserted, nbRemoved, nbMoved,
+        std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count(),
+        stats._LightTreeCostRatio,
+        stats._NbLightTreeRebuilds - nbRebuilds
+    );
+}
+
+
+
+/*******************************************************************/
+/************************* MAIN FUNCTIONS **************************/
+/*******************************************************************/
+int HeadlessApplication::run(int argc, char* argv[]){
+    // same seed as Application::run so random light colors match
+    static const uint32_t SEED = 4242;
+    srand(SEED);
+
+    if(!parseArguments(argc, argv)){
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if(_ShowHelp){
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    if(!initScene()){
+        fprintf(stderr, "Failed to load the scene %s!\n", _SceneName.c_str());
+        return EXIT_FAILURE;
+    }
+    initRaytracer();
+    applyLightEdits();
+
+    // same background as Application::runRaytracer, in linear space
+    Vec3 backgroundColor = {0.383f, 0.632f, 0.800f};
+    _RayTracer->run(backgroundColor);
+    _RayTracer->getStats().print();
+    if(_PrintLightTreeQuality){
+        fprintf(stdout, "Light tree quality: average cut size of %.2f at 2%% error, %s cluster bounds\n", 
+            _RayTracer->measureLightTreeQuality(0.02f),
+            getSimdLevelName(getSimdLevel())
+        );
+    }
+
+    if(!_RayTracer->getImage()->savePPM(_OutputPath)){
+        return EXIT_FAILURE;
+    }
+    fprintf(stdout, "Image saved to %s\n", _OutputPath.c_str());
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "cpuRayTracer.hpp"
+#include "sceneDescription.hpp"
+
+class HeadlessApplication;
+using HeadlessApplicationPtr = std::shared_ptr<HeadlessApplication>;
+
+// batch render mode, runs the cpu ray tracer without a window or a vulkan device
+class HeadlessApplication{
+
+    public:
+        static const uint32_t DEFAULT_WIDTH = 1280;
+        static const uint32_t DEFAULT_HEIGHT = 720;
+
+    private:
+        std::string _SceneName = "spheres";
+        std::string _OutputPath = "lightcuts.ppm";
+        uint32_t _Width = DEFAULT_WIDTH;
+        uint32_t _Height = DEFAULT_HEIGHT;
+        uint32_t _NbThreads = 0;
+        uint32_t _TileSize = CpuTileScheduler::DEFAULT_TILE_SIZE;
+
+        // command line values override the ones of the scene file
+        std::optional<uint32_t> _SamplesPerPixels{};
+        std::optional<uint32_t> _MaxBounces{};
+        std::optional<uint32_t> _SamplesPerBounces{};
+        std::optional<float> _ShadingFactor{};
+        std::optional<bool> _UseLightCuts{};
+        std::optional<float> _LightcutsErrorThreshold{};
+        std::optional<uint32_t> _LightcutsMaxClusters{};
+        CpuBRDFModel _BRDFModel = CPU_LAMBERT_BRDF;
+        bool _UseCutCoherence = false;
+        bool _UseMultidimensionalLightcuts = false;
+        uint32_t _GatherMaxClusters = CpuRayTracer::DEFAULT_GATHER_MAX_CLUSTERS;
+        bool _UseReconstructionCuts = false;
+        uint32_t _ReconstructionSpacing = CpuRayTracer::DEFAULT_RECONSTRUCTION_SPACING;
+        bool _UseVpls = false;
+        uint32_t _NbVplPaths = CpuRayTracer::DEFAULT_NB_VPL_PATHS;
+        uint32_t _VplBounces = 1;
+        std::optional<float> _VplClamp{};
+        CpuLightTreeBuilder _LightTreeBuilder = CPU_LIGHT_TREE_LOCALLY_ORDERED;
+        bool _PrintLightTreeQuality = false;
+        // random point lights inserted, removed or moved through the incremental light tree updates before the render
+        uint32_t _NbLightEdits = 0;
+        // empty disables the cache
+        std::string _CacheDirectory = CpuRayTracer::DEFAULT_CACHE_DIRECTORY;
+        // in megabytes
+        uint32_t _CacheMaxSize = static_cast<uint32_t>(CpuCacheWriter::DEFAULT_MAX_DIRECTORY_SIZE >> 20);
+        // best supported level if not set
+        std::optional<CpuSimdLevel> _SimdLevel{};
+        bool _ShowHelp = false;
+
+        SceneDescription _SceneDescription{};
+        CpuScenePtr _Scene = nullptr;
+        CpuRayTracerPtr _RayTracer = nullptr;
+
+    private:
+        bool parseArguments(int argc, char* argv[]);
+        bool initScene();
+        void initRaytracer();
+        void applyLightEdits();
+
+    public:
+        HeadlessApplication(){};
+
+        static bool isRequested(int argc, char* argv[]);
+        static void printUsage(const char* programName);
+
+        // return the process exit status
+        int run(int argc, char* argv[]);
+};
\ No newline at end of file
@@ -17,4 +17,7 @@ void KeyboardInput::runRaytracer(be::WindowPtr window, Application* app){
     if(glfwGetKey(window->getWindow(), KEY_RUN_RAYTRACING) == GLFW_PRESS){
         app->runRaytracer();
     }
+    if(glfwGetKey(window->getWindow(), KEY_CANCEL_RAYTRACING) == GLFW_PRESS){
+        app->cancelRaytracer();
+    }
 }
\ No newline at end of file
@@ -32,6 +32,7 @@ class KeyboardInput{
 
             KEY_SWITCH_RENDERING_MODE = GLFW_KEY_TAB,
             KEY_RUN_RAYTRACING = GLFW_KEY_SPACE,
+            KEY_CANCEL_RAYTRACING = GLFW_KEY_C,
         };
 
         static KeyboardInputPtr _KeyboardInput;
@@ -1,6 +1,8 @@
 #include "brdfRenderSubSystem.hpp"
 
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include "data.hpp"
 
 const std::array<std::string, BrdfRenderSubSystem::_NB_PIPELINES> BrdfRenderSubSystem::_PIPELINE_NAMES = {
@@ -14,7 +16,6 @@ const std::array<std::string, BrdfRenderSubSystem::_NB_PIPELINES> BrdfRenderSubS
 
 BrdfRenderSubSystem::BrdfRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool)
     : IRenderSubSystem(vulkanApp, renderPass), _GlobalPool(globalPool){
-    _NeedPerObjectBind = true;
     initUBOs();
     initDescriptors();
     initPipelineLayout();
@@ -22,14 +23,23 @@ BrdfRenderSubSystem::BrdfRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPas
 }
 
 void BrdfRenderSubSystem::cleanUpPipeline(){
-    for(auto& pipeline : _PossiblePipelines){
-        pipeline->cleanUp();
-    }
-    for(auto& pipeline : _WireframePipelines){
-        pipeline->cleanUp();
+    destroyPipelines();
+}
+
+void BrdfRenderSubSystem::destroyPipelines(){
+    for(uint32_t i=0; i<_NB_PIPELINES; i++){
+        for(bool isWireframe : {false, true}){
+            auto& pending = _PendingPipelines[2*i + isWireframe];
+            auto& pipeline = isWireframe ? _WireframePipelines[i] : _PossiblePipelines[i];
+            if(pending.valid()){
+                pipeline = pending.get();
+            }
+            if(pipeline != nullptr){
+                pipeline->cleanUp();
+                pipeline = nullptr;
+            }
+        }
     }
-    _PossiblePipelines.clear();
-    _WireframePipelines.clear();
 }
 
 
@@ -55,6 +65,10 @@ void BrdfRenderSubSystem::renderingFunction(be::GameObject object){
     push._Model = objectTransform._Transform->getModel();
     auto objectMaterial = be::GameCoordinator::getComponent<be::ComponentMaterial>(object);
     push._MaterialId = objectMaterial.getId();
+    // the shaders index the material UBO with the push constant, no set to rebind
+    if(_IsUpdatingMaterials){
+        _MaterialUBO.setMaterial(objectMaterial._Material, objectMaterial.getId());
+    }
     
     vkCmdPushConstants(
         _FrameInfo._CommandBuffer, 
@@ -69,41 +83,44 @@ void BrdfRenderSubSystem::renderingFunction(be::GameObject object){
     model->draw(_FrameInfo._CommandBuffer);
 }
 
-void BrdfRenderSubSystem::updateDescriptorSets(be::GameObject object, be::FrameInfo& frameInfo){
+void BrdfRenderSubSystem::renderGameObjects(be::FrameInfo& frameInfo){    
+    _FrameInfo = frameInfo;
     uint32_t frameIndex = frameInfo._FrameIndex;
-    
-    // update UBOs
+
+    // update UBOs, once per frame
     _CameraUBO.setProj(frameInfo._Camera->getPerspective());
     _CameraUBO.setView(frameInfo._Camera->getView());
     _CameraUBO.update(frameIndex);
 
-    _LightUBO.reset();
-    for(auto light : _Scene->getPointLights()){
-        _LightUBO.addPointLight(light);
-    }
-    for(auto light : _Scene->getDirectionalLights()){
-        _LightUBO.addDirectionalLight(light);
+    if(_NbLightUpdatesPending > 0 && _Scene != nullptr){
+        _LightUBO.reset();
+        for(const auto& light : _Scene->getPointLights()){
+            _LightUBO.addPointLight(light);
+        }
+        for(const auto& light : _Scene->getDirectionalLights()){
+            _LightUBO.addDirectionalLight(light);
+        }
+        _LightUBO.update(frameIndex);
+        _NbLightUpdatesPending--;
     }
-    _LightUBO.update(frameIndex);
-
-    auto objectMaterial = be::GameCoordinator::getComponent<be::ComponentMaterial>(object);
-    _MaterialUBO.setMaterial(objectMaterial._Material, objectMaterial.getId());
-    _MaterialUBO.update(frameIndex);
 
     _DescriptorSets = {
         _GlobalDescriptorSets[frameIndex],
         _LightDescriptorSets[frameIndex],
         _MaterialDescriptorSets[frameIndex],
     };
-}
-
-void BrdfRenderSubSystem::renderGameObjects(be::FrameInfo& frameInfo){    
-    _FrameInfo = frameInfo;
 
+    // the materials are gathered while drawing, the buffer is only read once the frame is submitted
+    _IsUpdatingMaterials = _NbMaterialUpdatesPending > 0;
     be::RenderSystem::renderGameObjects(
         frameInfo, 
         this
     );
+    if(_IsUpdatingMaterials){
+        _MaterialUBO.update(frameIndex);
+        _NbMaterialUpdatesPending--;
+        _IsUpdatingMaterials = false;
+    }
 }
 
 void BrdfRenderSubSystem::initPipelineLayout(){
@@ -144,9 +161,8 @@ void BrdfRenderSubSystem::initPipelineLayout(){
 }
 
 void BrdfRenderSubSystem::initPipeline(VkRenderPass renderPass){
-    if(_Pipeline != nullptr){
-        _Pipeline->cleanUp();
-    }
+    // the pipelines of the previous render pass can't be reused
+    destroyPipelines();
 
     if(_VulkanApp == nullptr){
         be::ErrorHandler::handle(__FILE__, __LINE__, 
@@ -162,34 +178,76 @@ void BrdfRenderSubSystem::initPipeline(VkRenderPass renderPass){
         );
     }
 
-    // init pipelines
-    for(uint32_t i=0; i<_NB_PIPELINES; i++){
-        _PossiblePipelines[i] = be::PipelinePtr(new be::Pipeline(_VulkanApp));
-        if(i==COLOR_BRDF) _PossiblePipelines[i]->initColorPassThroughShaders();// 0 = colors brdf
-        if(i==NORMAL_BRDF) _PossiblePipelines[i]->initNormalPassThroughShaders();// 1 = normals brdf
-        if(i==LAMBERT_BRDF) _PossiblePipelines[i]->initLambertShaders();// 2 = lambert brdf
-        if(i==BLINN_PHONG_BRDF) _PossiblePipelines[i]->initBlinnPhongShaders();// 3 = blinn-phong brdf
-        if(i==MICROFACET_BRDF) _PossiblePipelines[i]->initMicroFacetsShaders();// 4 = microfacet brdf
-        if(i==DISNEY_BRDF) _PossiblePipelines[i]->initDisneyShaders();// 5 = disney brdf
-        auto pipelineConfig = be::Pipeline::defaultPipelineConfigInfo();
-        pipelineConfig._RenderPass = renderPass;
-        pipelineConfig._PipelineLayout = _PipelineLayout;
-        _PossiblePipelines[i]->init(pipelineConfig);
-    }
+    _PipelineRenderPass = renderPass;
+    _Pipeline = getPipeline(_PipelineId, _IsWireFrameMode);
+    prefetchPipelines();
+}
 
-    // init wireframe pipelines
-    for(uint32_t i=0; i<_NB_PIPELINES; i++){
-        _WireframePipelines[i] = be::PipelinePtr(new be::Pipeline(_VulkanApp));
-        _WireframePipelines[i]->copyShaders(_PossiblePipelines[i]);
-        auto pipelineConfig = be::Pipeline::defaultPipelineConfigInfo();
+be::PipelinePtr BrdfRenderSubSystem::createPipeline(uint32_t id, bool isWireframe) const {
+    be::PipelinePtr pipeline = be::PipelinePtr(new be::Pipeline(_VulkanApp));
+    switch(id){
+        case COLOR_BRDF:
+            pipeline->initColorPassThroughShaders();
+            break;
+        case NORMAL_BRDF:
+            pipeline->initNormalPassThroughShaders();
+            break;
+        case LAMBERT_BRDF:
+            pipeline->initLambertShaders();
+            break;
+        case BLINN_PHONG_BRDF:
+            pipeline->initBlinnPhongShaders();
+            break;
+        case MICROFACET_BRDF:
+            pipeline->initMicroFacetsShaders();
+            break;
+        case DISNEY_BRDF:
+            pipeline->initDisneyShaders();
+            break;
+    }
+    auto pipelineConfig = be::Pipeline::defaultPipelineConfigInfo();
+    if(isWireframe){
         pipelineConfig = be::Pipeline::defaultWireFramePipelineConfigInfo();
-        pipelineConfig._RenderPass = renderPass;
         pipelineConfig._RasterizationInfo.cullMode = VK_CULL_MODE_NONE;
-        pipelineConfig._PipelineLayout = _PipelineLayout;
-        _WireframePipelines[i]->init(pipelineConfig);
     }
+    pipelineConfig._RenderPass = _PipelineRenderPass;
+    pipelineConfig._PipelineLayout = _PipelineLayout;
+    pipeline->init(pipelineConfig);
+    return pipeline;
+}
+
+be::PipelinePtr BrdfRenderSubSystem::getPipeline(uint32_t id, bool isWireframe){
+    auto& pipeline = isWireframe ? _WireframePipelines[id] : _PossiblePipelines[id];
+    if(pipeline != nullptr) return pipeline;
+    auto& pending = _PendingPipelines[2*id + isWireframe];
+    if(pending.valid()){
+        pipeline = pending.get();
+        return pipeline;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    pipeline = createPipeline(id, isWireframe);
+    auto end = std::chrono::high_resolution_clock::now();
+    fprintf(stdout, "Pipeline %s%s compiled in %fs\n", 
+        _PIPELINE_NAMES[id].c_str(), 
+        isWireframe ? " (wireframe)" : "",
+        std::chrono::duration<float, std::chrono::seconds::period>(end - start).count()
+    );
+    return pipeline;
+}
+
+void BrdfRenderSubSystem::prefetchPipeline(uint32_t id, bool isWireframe){
+    const auto& pipeline = isWireframe ? _WireframePipelines[id] : _PossiblePipelines[id];
+    auto& pending = _PendingPipelines[2*id + isWireframe];
+    if(pipeline != nullptr || pending.valid()) return;
+    pending = std::async(std::launch::async, [this, id, isWireframe](){
+        return createPipeline(id, isWireframe);
+    });
+}
 
-    _Pipeline = _PossiblePipelines[DISNEY_BRDF];
+void BrdfRenderSubSystem::prefetchPipelines(){
+    // the brdfs are cycled in order and the wireframe key toggles the current one
+    prefetchPipeline((_PipelineId + 1) % _NB_PIPELINES, false);
+    prefetchPipeline(_PipelineId, !_IsWireFrameMode);
 }
 
 void BrdfRenderSubSystem::cleanUpPipelineLayout(){
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <future>
 #include <memory>
+#include <vector>
 
 #include <BigoudiEngine.hpp>
 
@@ -41,11 +43,20 @@ class BrdfRenderSubSystem : public be::IRenderSubSystem {
 
         be::FrameInfo _FrameInfo{};
 
+        // only the selected pipeline is compiled with the sub system, the others on their first use
+        // the next brdf of the cycle and the other variant of the current one are compiled in the background
         std::vector<be::PipelinePtr> _PossiblePipelines = std::vector<be::PipelinePtr>(_NB_PIPELINES);
         std::vector<be::PipelinePtr> _WireframePipelines = std::vector<be::PipelinePtr>(_NB_PIPELINES);
+        std::vector<std::future<be::PipelinePtr>> _PendingPipelines = std::vector<std::future<be::PipelinePtr>>(2*_NB_PIPELINES);
+        VkRenderPass _PipelineRenderPass = VK_NULL_HANDLE;
 
         be::ScenePtr _Scene = nullptr;
 
+        // number of frames in flight whose UBO still holds stale data
+        uint32_t _NbLightUpdatesPending = be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT;
+        uint32_t _NbMaterialUpdatesPending = be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT;
+        bool _IsUpdatingMaterials = false;
+
         int _PipelineId = DISNEY_BRDF;
         bool _IsSwitchPipelineKeyPressed = false;
         bool _IsWireframePipelineKeyPressed = false;
@@ -58,7 +69,6 @@ class BrdfRenderSubSystem : public be::IRenderSubSystem {
                 _IsSwitchPipelineKeyPressed = true;
                 switchPipeline();
                 resetWireframePipelineKey();
-                _IsWireFrameMode = false;
             }
         }
 
@@ -87,7 +97,14 @@ class BrdfRenderSubSystem : public be::IRenderSubSystem {
         virtual void cleanUp() override;
 
         int getBRDFModel() const {return _PipelineId;}
-        void setScene(be::ScenePtr scene){_Scene = scene;}
+        void setScene(be::ScenePtr scene){
+            _Scene = scene;
+            setLightsDirty();
+        }
+
+        // the lights and materials are only uploaded after being flagged as modified
+        void setLightsDirty(){_NbLightUpdatesPending = be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT;}
+        void setMaterialsDirty(){_NbMaterialUpdatesPending = be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT;}
 
 
     protected:
@@ -100,20 +117,26 @@ class BrdfRenderSubSystem : public be::IRenderSubSystem {
 
         virtual void renderingFunction(be::GameObject object) override;
         void switchPipeline(){
-            _PipelineId = (_PipelineId + 1) % _PossiblePipelines.size();
-            _Pipeline = _PossiblePipelines[_PipelineId];
+            _PipelineId = (_PipelineId + 1) % _NB_PIPELINES;
+            _IsWireFrameMode = false;
+            _Pipeline = getPipeline(_PipelineId, _IsWireFrameMode);
+            prefetchPipelines();
             fprintf(stdout, "Pipeline %s\n", _PIPELINE_NAMES[_PipelineId].c_str());
         }
 
         void switchWireframe(){
-            if(!_IsWireFrameMode){
-                _Pipeline = _WireframePipelines[_PipelineId];
-                _IsWireFrameMode = true;
-            }else{
-                _Pipeline = _PossiblePipelines[_PipelineId];
-                _IsWireFrameMode = false;
-            }
+            _IsWireFrameMode = !_IsWireFrameMode;
+            _Pipeline = getPipeline(_PipelineId, _IsWireFrameMode);
+            prefetchPipelines();
         }
 
-        virtual void updateDescriptorSets(be::GameObject object, be::FrameInfo& frameInfo) override;
+    private:
+        // can run on any thread, only reads what is set before the first pipeline
+        be::PipelinePtr createPipeline(uint32_t id, bool isWireframe) const;
+        // wait for the background compilation or compile right away if it never started
+        be::PipelinePtr getPipeline(uint32_t id, bool isWireframe);
+        void prefetchPipeline(uint32_t id, bool isWireframe);
+        void prefetchPipelines();
+        // wait for the background compilations and destroy every pipeline
+        void destroyPipelines();
 };
\ No newline at end of file
@@ -5,4 +5,10 @@
 struct SimplePushConstantData : be::PushConstantData{
     alignas(16) be::Matrix4x4 _Model{1.f};
     alignas(4) uint32_t _MaterialId = 0;
+};
+
+// camera of the instanced light gizmos, matches lightGizmo.vert
+struct LightGizmoPushConstantData{
+    alignas(16) be::Matrix4x4 _Proj{1.f};
+    alignas(16) be::Matrix4x4 _View{1.f};
 };
\ No newline at end of file
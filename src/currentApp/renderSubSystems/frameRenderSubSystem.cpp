@@ -1,15 +1,22 @@
 #include "frameRenderSubSystem.hpp"
 
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <fstream>
 #include "data.hpp"
 
+const std::string FrameRenderSubSystem::_GIZMO_VERTEX_SHADER = "resources/shaders/lightGizmo.vert.spv";
+const std::string FrameRenderSubSystem::_GIZMO_FRAGMENT_SHADER = "resources/shaders/lightGizmo.frag.spv";
 
-FrameRenderSubSystem::FrameRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool)
-    : IRenderSubSystem(vulkanApp, renderPass), _GlobalPool(globalPool){
+FrameRenderSubSystem::FrameRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool, DeviceMemoryPoolPtr memoryPool, VkPipelineCache pipelineCache)
+    : IRenderSubSystem(vulkanApp, renderPass), _GlobalPool(globalPool), _MemoryPool(memoryPool), _PipelineCache(pipelineCache){
     initUBOs();
     initDescriptors();
     initPipelineLayout();
     initPipeline(renderPass);
+    initGizmoMesh();
 }
 
 
@@ -18,6 +25,7 @@ void FrameRenderSubSystem::cleanUp() {
 
     _GlobalSetLayout->cleanUp();
     _CameraUBO.cleanUp();
+    cleanUpGizmos();
 }
 
 
@@ -58,6 +66,7 @@ void FrameRenderSubSystem::renderGameObjects(be::FrameInfo& frameInfo){
         frameInfo, 
         this
     );
+    renderGizmos(frameInfo._CommandBuffer, frameInfo._Camera);
 }
 
 void FrameRenderSubSystem::initPipelineLayout(){
@@ -93,6 +102,25 @@ void FrameRenderSubSystem::initPipelineLayout(){
         &_PipelineLayout
     );
     be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create pipeline layout!\n");
+
+    // the gizmos only need the camera, given as push constants
+    VkPushConstantRange gizmoPushConstantRange{};
+    gizmoPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    gizmoPushConstantRange.offset = 0;
+    gizmoPushConstantRange.size = sizeof(LightGizmoPushConstantData);
+
+    VkPipelineLayoutCreateInfo gizmoPipelineLayoutInfo{};
+    gizmoPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    gizmoPipelineLayoutInfo.pushConstantRangeCount = 1;
+    gizmoPipelineLayoutInfo.pPushConstantRanges = &gizmoPushConstantRange;
+
+    result = vkCreatePipelineLayout(
+        _VulkanApp->getDevice(), 
+        &gizmoPipelineLayoutInfo, 
+        nullptr, 
+        &_GizmoPipelineLayout
+    );
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create the light gizmos pipeline layout!\n");
 }
 
 void FrameRenderSubSystem::initPipeline(VkRenderPass renderPass){
@@ -120,6 +148,8 @@ void FrameRenderSubSystem::initPipeline(VkRenderPass renderPass){
     pipelineConfig._RenderPass = renderPass;
     pipelineConfig._PipelineLayout = _PipelineLayout;
     _Pipeline->init(pipelineConfig);
+
+    initGizmoPipeline(renderPass);
 }
 
 void FrameRenderSubSystem::cleanUpPipelineLayout(){
@@ -149,4 +179,237 @@ void FrameRenderSubSystem::initDescriptors(){
             .writeBuffer(0, &cameraBufferInfo)
             .build(_GlobalDescriptorSets[i]);
     }
+}
+
+
+
+/*******************************************************************/
+/************************** LIGHT GIZMOS ***************************/
+/*******************************************************************/
+void FrameRenderSubSystem::setLightGizmos(const std::vector<LightGizmoInstance>& instances){
+    // the previous instances may still be read by the frames in flight
+    vkDeviceWaitIdle(_VulkanApp->getDevice());
+
+    uint32_t nbInstances = static_cast<uint32_t>(instances.size());
+    if(nbInstances > _GizmoInstanceCapacity){
+        destroyBuffer(_MemoryPool, _GizmoInstanceBuffer, _GizmoInstanceMemory);
+        createBuffer(
+            _MemoryPool, 
+            nbInstances * sizeof(LightGizmoInstance), 
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+            _GizmoInstanceBuffer, 
+            _GizmoInstanceMemory
+        );
+        _GizmoInstanceData = reinterpret_cast<LightGizmoInstance*>(_GizmoInstanceMemory._MappedData);
+        _GizmoInstanceCapacity = nbInstances;
+    }
+
+    if(nbInstances > 0){
+        memcpy(_GizmoInstanceData, instances.data(), nbInstances * sizeof(LightGizmoInstance));
+    }
+    _NbGizmoInstances = nbInstances;
+}
+
+void FrameRenderSubSystem::renderGizmos(VkCommandBuffer commandBuffer, be::CameraPtr camera){
+    if(_NbGizmoInstances == 0) return;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _GizmoPipeline);
+
+    LightGizmoPushConstantData push{};
+    push._Proj = camera->getPerspective();
+    push._View = camera->getView();
+    vkCmdPushConstants(
+        commandBuffer, 
+        _GizmoPipelineLayout, 
+        VK_SHADER_STAGE_VERTEX_BIT, 
+        0, 
+        sizeof(LightGizmoPushConstantData), 
+        &push
+    );
+
+    VkBuffer buffers[] = {_GizmoVertexBuffer, _GizmoInstanceBuffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, _GizmoIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(commandBuffer, _NbGizmoIndices, _NbGizmoInstances, 0, 0, 0);
+}
+
+void FrameRenderSubSystem::initGizmoMesh(){
+    // unit uv sphere
+    const float pi = 3.14159265358979f;
+    std::vector<float> positions{};
+    positions.reserve((_GIZMO_NB_SEGMENTS+1) * (_GIZMO_NB_SEGMENTS+1) * 3);
+    for(uint32_t i=0; i<=_GIZMO_NB_SEGMENTS; i++){
+        float theta = pi * i / _GIZMO_NB_SEGMENTS;
+        for(uint32_t j=0; j<=_GIZMO_NB_SEGMENTS; j++){
+            float phi = 2.f * pi * j / _GIZMO_NB_SEGMENTS;
+            positions.push_back(std::sin(theta) * std::cos(phi));
+            positions.push_back(std::cos(theta));
+            positions.push_back(std::sin(theta) * std::sin(phi));
+        }
+    }
+    std::vector<uint32_t> indices{};
+    indices.reserve(_GIZMO_NB_SEGMENTS * _GIZMO_NB_SEGMENTS * 6);
+    for(uint32_t i=0; i<_GIZMO_NB_SEGMENTS; i++){
+        for(uint32_t j=0; j<_GIZMO_NB_SEGMENTS; j++){
+            uint32_t first = i * (_GIZMO_NB_SEGMENTS+1) + j;
+            uint32_t second = first + _GIZMO_NB_SEGMENTS + 1;
+            indices.insert(indices.end(), {first, second, first+1, first+1, second, second+1});
+        }
+    }
+    _NbGizmoIndices = static_cast<uint32_t>(indices.size());
+
+    // a few kilobytes written once, host visible memory is enough
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkDeviceSize vertexSize = positions.size() * sizeof(float);
+    createBuffer(_MemoryPool, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, properties, _GizmoVertexBuffer, _GizmoVertexMemory);
+    memcpy(_GizmoVertexMemory._MappedData, positions.data(), vertexSize);
+
+    VkDeviceSize indexSize = indices.size() * sizeof(uint32_t);
+    createBuffer(_MemoryPool, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, properties, _GizmoIndexBuffer, _GizmoIndexMemory);
+    memcpy(_GizmoIndexMemory._MappedData, indices.data(), indexSize);
+}
+
+VkShaderModule FrameRenderSubSystem::createShaderModule(const std::string& path) const {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if(!file.is_open()){
+        be::ErrorHandler::handle(__FILE__, __LINE__, 
+            be::ErrorCode::IO_ERROR, 
+            "Failed to open the shader " + path + "!\n"
+        );
+    }
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> code(fileSize);
+    file.seekg(0);
+    file.read(code.data(), fileSize);
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkResult result = vkCreateShaderModule(_VulkanApp->getDevice(), &createInfo, nullptr, &shaderModule);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create a light gizmo shader module!\n");
+    return shaderModule;
+}
+
+void FrameRenderSubSystem::initGizmoPipeline(VkRenderPass renderPass){
+    VkDevice device = _VulkanApp->getDevice();
+    if(_GizmoPipeline != VK_NULL_HANDLE){
+        vkDestroyPipeline(device, _GizmoPipeline, nullptr);
+        _GizmoPipeline = VK_NULL_HANDLE;
+    }
+
+    VkShaderModule vertexShader = createShaderModule(_GIZMO_VERTEX_SHADER);
+    VkShaderModule fragmentShader = createShaderModule(_GIZMO_FRAGMENT_SHADER);
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertexShader;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragmentShader;
+    shaderStages[1].pName = "main";
+
+    // binding 0 walks the sphere vertices, binding 1 the lights
+    VkVertexInputBindingDescription bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].stride = 3 * sizeof(float);
+    bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindings[1].binding = 1;
+    bindings[1].stride = sizeof(LightGizmoInstance);
+    bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    VkVertexInputAttributeDescription attributes[3]{};
+    attributes[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0};
+    attributes[1] = {1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(LightGizmoInstance, _PositionScale))};
+    attributes[2] = {2, 1, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(LightGizmoInstance, _Color))};
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
+    vertexInputInfo.pVertexBindingDescriptions = bindings;
+    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputInfo.pVertexAttributeDescriptions = attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
+    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    // same dynamic viewport as the engine pipelines
+    VkPipelineViewportStateCreateInfo viewportInfo{};
+    viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportInfo.viewportCount = 1;
+    viewportInfo.scissorCount = 1;
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo{};
+    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo.dynamicStateCount = 2;
+    dynamicStateInfo.pDynamicStates = dynamicStates;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationInfo{};
+    rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+    rasterizationInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizationInfo.lineWidth = 1.f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleInfo{};
+    multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = 
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT 
+        | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo{};
+    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendInfo.attachmentCount = 1;
+    colorBlendInfo.pAttachments = &colorBlendAttachment;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilInfo{};
+    depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilInfo.depthTestEnable = VK_TRUE;
+    depthStencilInfo.depthWriteEnable = VK_TRUE;
+    depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilInfo.maxDepthBounds = 1.f;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+    pipelineInfo.pViewportState = &viewportInfo;
+    pipelineInfo.pRasterizationState = &rasterizationInfo;
+    pipelineInfo.pMultisampleState = &multisampleInfo;
+    pipelineInfo.pColorBlendState = &colorBlendInfo;
+    pipelineInfo.pDepthStencilState = &depthStencilInfo;
+    pipelineInfo.pDynamicState = &dynamicStateInfo;
+    pipelineInfo.layout = _GizmoPipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+
+    VkResult result = vkCreateGraphicsPipelines(device, _PipelineCache, 1, &pipelineInfo, nullptr, &_GizmoPipeline);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create the light gizmos pipeline!\n");
+
+    vkDestroyShaderModule(device, vertexShader, nullptr);
+    vkDestroyShaderModule(device, fragmentShader, nullptr);
+}
+
+void FrameRenderSubSystem::cleanUpGizmos(){
+    VkDevice device = _VulkanApp->getDevice();
+    vkDestroyPipeline(device, _GizmoPipeline, nullptr);
+    vkDestroyPipelineLayout(device, _GizmoPipelineLayout, nullptr);
+    _GizmoPipeline = VK_NULL_HANDLE;
+    _GizmoPipelineLayout = VK_NULL_HANDLE;
+
+    destroyBuffer(_MemoryPool, _GizmoVertexBuffer, _GizmoVertexMemory);
+    destroyBuffer(_MemoryPool, _GizmoIndexBuffer, _GizmoIndexMemory);
+    destroyBuffer(_MemoryPool, _GizmoInstanceBuffer, _GizmoInstanceMemory);
+    _GizmoInstanceData = nullptr;
+    _NbGizmoInstances = 0;
+    _GizmoInstanceCapacity = 0;
 }
\ No newline at end of file
@@ -1,15 +1,29 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <BigoudiEngine.hpp>
 
+#include "vulkanMemory.hpp"
+
 class FrameRenderSubSystem;
 using FrameRenderSubSystemPtr = std::shared_ptr<FrameRenderSubSystem>;
 
+// per instance data of the light gizmos, matches lightGizmo.vert
+struct LightGizmoInstance{
+    // xyz for the position, w for the scale
+    be::Vector4 _PositionScale{0.f, 0.f, 0.f, 1.f};
+    be::Vector4 _Color{1.f, 1.f, 1.f, 1.f};
+};
+
 class FrameRenderSubSystem : public be::IRenderSubSystem {
     public:
         static const uint32_t _NB_SETS = 1;
+        static const uint32_t _GIZMO_NB_SEGMENTS = 16;
+        static const std::string _GIZMO_VERTEX_SHADER;
+        static const std::string _GIZMO_FRAGMENT_SHADER;
 
     protected:
 
@@ -22,13 +36,35 @@ class FrameRenderSubSystem : public be::IRenderSubSystem {
 
         be::FrameInfo _FrameInfo{};
 
+        DeviceMemoryPoolPtr _MemoryPool = nullptr;
+
+        // the engine pipelines are created without a cache, only the raw vulkan ones use it
+        VkPipelineCache _PipelineCache = VK_NULL_HANDLE;
+
+        // every light gizmo shares a unit sphere drawn with a single instanced call
+        VkPipelineLayout _GizmoPipelineLayout = VK_NULL_HANDLE;
+        VkPipeline _GizmoPipeline = VK_NULL_HANDLE;
+        VkBuffer _GizmoVertexBuffer = VK_NULL_HANDLE;
+        DeviceAllocation _GizmoVertexMemory{};
+        VkBuffer _GizmoIndexBuffer = VK_NULL_HANDLE;
+        DeviceAllocation _GizmoIndexMemory{};
+        uint32_t _NbGizmoIndices = 0;
+        VkBuffer _GizmoInstanceBuffer = VK_NULL_HANDLE;
+        DeviceAllocation _GizmoInstanceMemory{};
+        LightGizmoInstance* _GizmoInstanceData = nullptr;
+        uint32_t _NbGizmoInstances = 0;
+        uint32_t _GizmoInstanceCapacity = 0;
+
     public:
-        FrameRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool);
+        FrameRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool, DeviceMemoryPoolPtr memoryPool, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
 
         virtual void renderGameObjects(be::FrameInfo& frameInfo) override;
 
         virtual void cleanUp() override;
 
+        // replace the light gizmos, waits for the device so it is not meant to be called every frame
+        void setLightGizmos(const std::vector<LightGizmoInstance>& instances);
+
 
     protected:
         virtual void initPipelineLayout() override;
@@ -36,6 +72,13 @@ class FrameRenderSubSystem : public be::IRenderSubSystem {
         virtual void cleanUpPipelineLayout() override;
         virtual void initUBOs();
         virtual void initDescriptors();
+        virtual void initGizmoMesh();
+        virtual void initGizmoPipeline(VkRenderPass renderPass);
+        virtual void cleanUpGizmos();
+        virtual void renderGizmos(VkCommandBuffer commandBuffer, be::CameraPtr camera);
 
         virtual void renderingFunction(be::GameObject object) override;
+
+    private:
+        VkShaderModule createShaderModule(const std::string& path) const;
 };
\ No newline at end of file
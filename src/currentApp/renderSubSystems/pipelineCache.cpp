@@ -0,0 +1,89 @@
+#include "pipelineCache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+const std::string PipelineCache::DEFAULT_PATH = "cache/pipelines.bin";
+
+PipelineCache::PipelineCache(be::VulkanAppPtr vulkanApp, const std::string& path)
+    : _VulkanApp(vulkanApp), _Path(path){
+    std::vector<char> data{};
+    std::ifstream file(_Path, std::ios::ate | std::ios::binary);
+    if(file.is_open()){
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), data.size());
+        if(!file || !isCompatible(data)){
+            fprintf(stderr, "The pipeline cache %s can't be used, it will be rebuilt\n", _Path.c_str());
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+    VkResult result = vkCreatePipelineCache(_VulkanApp->getDevice(), &createInfo, nullptr, &_Cache);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create the pipeline cache!\n");
+    if(!data.empty()){
+        fprintf(stdout, "Pipeline cache loaded from %s: %zu bytes\n", _Path.c_str(), data.size());
+    }
+}
+
+bool PipelineCache::isCompatible(const std::vector<char>& data) const {
+    // header of VK_PIPELINE_CACHE_HEADER_VERSION_ONE: size, version, vendor, device and uuid
+    const size_t headerSize = 4*sizeof(uint32_t) + VK_UUID_SIZE;
+    if(data.size() < headerSize) return false;
+    uint32_t header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(_VulkanApp->getPhysicalDevice(), &properties);
+    return header[0] >= headerSize
+        && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header[2] == properties.vendorID
+        && header[3] == properties.deviceID
+        && std::memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save() const {
+    if(_Cache == VK_NULL_HANDLE) return;
+    VkDevice device = _VulkanApp->getDevice();
+    size_t size = 0;
+    VkResult result = vkGetPipelineCacheData(device, _Cache, &size, nullptr);
+    if(result != VK_SUCCESS || size == 0) return;
+    std::vector<char> data(size);
+    result = vkGetPipelineCacheData(device, _Cache, &size, data.data());
+    if(result != VK_SUCCESS) return;
+    data.resize(size);
+
+    std::error_code error{};
+    std::filesystem::path target(_Path);
+    if(target.has_parent_path()){
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+    std::string temporaryPath = _Path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if(!file){
+            fprintf(stderr, "Failed to write the pipeline cache %s!\n", temporaryPath.c_str());
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, _Path, error);
+    if(error){
+        fprintf(stderr, "Failed to write the pipeline cache %s!\n", _Path.c_str());
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
+void PipelineCache::cleanUp(){
+    if(_Cache != VK_NULL_HANDLE){
+        vkDestroyPipelineCache(_VulkanApp->getDevice(), _Cache, nullptr);
+        _Cache = VK_NULL_HANDLE;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <BigoudiEngine.hpp>
+
+class PipelineCache;
+using PipelineCachePtr = std::shared_ptr<PipelineCache>;
+
+// VkPipelineCache kept on disk between two runs
+// the data of another driver or another device is ignored and the cache starts empty
+class PipelineCache{
+    public:
+        static const std::string DEFAULT_PATH;
+
+    private:
+        be::VulkanAppPtr _VulkanApp = nullptr;
+        VkPipelineCache _Cache = VK_NULL_HANDLE;
+        std::string _Path = "";
+
+    public:
+        PipelineCache(be::VulkanAppPtr vulkanApp, const std::string& path = DEFAULT_PATH);
+
+        VkPipelineCache getCache() const {return _Cache;}
+
+        // written next to the path and renamed, the directory is created if needed
+        void save() const;
+        void cleanUp();
+
+    private:
+        // return false if the data was written by another driver or for another device
+        bool isCompatible(const std::vector<char>& data) const;
+};
\ No newline at end of file
@@ -1,11 +1,12 @@
 #include "raytracingRenderSubSystem.hpp"
 
 #include <cstdint>
+#include <vector>
 #include "data.hpp"
 
 
-RaytracingRenderSubSystem::RaytracingRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool)
-    : IRenderSubSystem(vulkanApp, renderPass), _GlobalPool(globalPool){
+RaytracingRenderSubSystem::RaytracingRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool, DeviceMemoryPoolPtr memoryPool)
+    : IRenderSubSystem(vulkanApp, renderPass), _GlobalPool(globalPool), _MemoryPool(memoryPool){
     _RenderPass = renderPass;
 }
 
@@ -14,8 +15,10 @@ void RaytracingRenderSubSystem::cleanUp() {
     if(_IsInit){
         IRenderSubSystem::cleanUp();
         _TextureSetLayout->cleanUp();
-        for(auto& image : _TextureImage)
-            image.cleanUp();
+        cleanUpTexture();
+        vkDestroySampler(_VulkanApp->getDevice(), _TextureSampler, nullptr);
+        _TextureSampler = VK_NULL_HANDLE;
+        _IsInit = false;
     }
 }
 
@@ -29,10 +32,8 @@ void RaytracingRenderSubSystem::renderingFunction(be::GameObject object){
 
 void RaytracingRenderSubSystem::renderGameObjects(be::FrameInfo& frameInfo){    
     _FrameInfo = frameInfo;
-    uint32_t frameIndex = frameInfo._FrameIndex;
-
     _DescriptorSets = {
-        _TextureDescriptorSets[frameIndex],
+        _TextureDescriptorSet,
     };
 
     be::RenderSystem::renderGameObjects(
@@ -112,43 +113,236 @@ void RaytracingRenderSubSystem::cleanUpPipelineLayout(){
     );
 }
 
-void RaytracingRenderSubSystem::updateImage(be::ImagePtr image){
-    if(_IsInit){
-        cleanUpPipelineLayout();
-        _TextureSetLayout->cleanUp();    
+void RaytracingRenderSubSystem::resize(uint32_t width, uint32_t height){
+    if(width == 0 || height == 0) return;
+    _SourceImage = nullptr;
+    _DirtyRegions.clear();
+    _IsClearPending = true;
+    if(_IsInit && width == _Width && height == _Height && _RenderPass == _PipelineRenderPass) return;
+
+    // the texture may still be read by the frames in flight
+    vkDeviceWaitIdle(_VulkanApp->getDevice());
+    if(!_IsInit || width != _Width || height != _Height){
+        cleanUpTexture();
+        initTexture(width, height);
+        initStagingBuffer();
         _GlobalPool->resetPool(); // need to free sets
+        initDescriptors();
+    }
+    if(_PipelineLayout == nullptr){
+        initPipelineLayout();
+    }
+    if(_PipelineRenderPass != _RenderPass){
+        initPipeline(_RenderPass);
+        _PipelineRenderPass = _RenderPass;
     }
-    initImage(image);
-    initDescriptors();
-    initPipelineLayout();
-    initPipeline(_RenderPass);
     _IsInit = true;
 }
 
+void RaytracingRenderSubSystem::updateRegions(CpuImagePtr image, const std::vector<CpuTile>& regions){
+    if(image->getWidth() != _Width || image->getHeight() != _Height) return;
+    _SourceImage = image;
+    _DirtyRegions.insert(_DirtyRegions.end(), regions.begin(), regions.end());
+}
+
+void RaytracingRenderSubSystem::recordUploads(VkCommandBuffer commandBuffer, uint32_t frameIndex){
+    if(!_IsInit || (!_IsClearPending && _DirtyRegions.empty())) return;
+    transitionTexture(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
+    if(_IsClearPending){
+        VkClearColorValue clearColor{};
+        VkImageSubresourceRange range{};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.levelCount = 1;
+        range.layerCount = 1;
+        vkCmdClearColorImage(commandBuffer, _TextureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+        _IsClearPending = false;
+    }
 
-void RaytracingRenderSubSystem::initImage(be::ImagePtr image){
-    for(uint32_t i=0; i<be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT; i++){
-        if(_TextureImage[i]._TexChannels != 0){// TODO: change this, != 0 just to check if not null
-            _TextureImage[i].cleanUp();
+    // the fence of this frame was waited on, its slice of the staging buffer is free
+    VkDeviceSize sliceOffset = frameIndex * _StagingSliceSize;
+    VkDeviceSize offset = 0;
+    std::vector<VkBufferImageCopy> copies{};
+    copies.reserve(_DirtyRegions.size());
+    for(const auto& region : _DirtyRegions){
+        VkDeviceSize regionSize = static_cast<VkDeviceSize>(region._Width) * region._Height * _TEXEL_SIZE;
+        // the slice is full, the remaining regions go out with the next frame
+        if(offset + regionSize > _StagingSliceSize) break;
+        float* texels = reinterpret_cast<float*>(_StagingData + sliceOffset + offset);
+        for(uint32_t y=region._Y; y<region._Y+region._Height; y++){
+            for(uint32_t x=region._X; x<region._X+region._Width; x++){
+                const Vec3& color = _SourceImage->getPixel(x, y);
+                *texels++ = color.x;
+                *texels++ = color.y;
+                *texels++ = color.z;
+                *texels++ = 1.f;
+            }
         }
-        _TextureImage[i] = be::TextureImage::load(_VulkanApp, image);
-        // _TextureImage[i] = be::TextureImage::load(_VulkanApp, "./tmp/ray_tracer.png");
+
+        VkBufferImageCopy copy{};
+        copy.bufferOffset = sliceOffset + offset;
+        copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.imageSubresource.layerCount = 1;
+        copy.imageOffset = {static_cast<int32_t>(region._X), static_cast<int32_t>(region._Y), 0};
+        copy.imageExtent = {region._Width, region._Height, 1};
+        copies.push_back(copy);
+        offset += regionSize;
+    }
+    if(!copies.empty()){
+        vkCmdCopyBufferToImage(
+            commandBuffer, 
+            _StagingBuffer, 
+            _TextureImage, 
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+            static_cast<uint32_t>(copies.size()), 
+            copies.data()
+        );
     }
+    _DirtyRegions.erase(_DirtyRegions.begin(), _DirtyRegions.begin() + copies.size());
+
+    transitionTexture(commandBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
-void RaytracingRenderSubSystem::initDescriptors(){
-    _TextureSetLayout = be::DescriptorSetLayoutPtr( 
-        be::DescriptorSetLayout::Builder(_VulkanApp)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-            .build()
+void RaytracingRenderSubSystem::transitionTexture(VkCommandBuffer commandBuffer, VkImageLayout newLayout){
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = _TextureLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = _TextureImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    switch(_TextureLayout){
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        default:
+            barrier.srcAccessMask = 0;
+            break;
+    }
+    switch(newLayout){
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            break;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            break;
+        default:
+            break;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    _TextureLayout = newLayout;
+}
+
+void RaytracingRenderSubSystem::initTexture(uint32_t width, uint32_t height){
+    VkDevice device = _VulkanApp->getDevice();
+    _Width = width;
+    _Height = height;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = _TEXTURE_FORMAT;
+    imageInfo.extent = {width, height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult result = vkCreateImage(device, &imageInfo, nullptr, &_TextureImage);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create the ray tracing texture!\n");
+    _TextureLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkMemoryRequirements memoryRequirements{};
+    vkGetImageMemoryRequirements(device, _TextureImage, &memoryRequirements);
+    _TextureMemory = _MemoryPool->allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+    result = vkBindImageMemory(device, _TextureImage, _TextureMemory._Memory, _TextureMemory._Offset);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to bind the ray tracing texture memory!\n");
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _TextureImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = _TEXTURE_FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    result = vkCreateImageView(device, &viewInfo, nullptr, &_TextureImageView);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create the ray tracing texture view!\n");
+
+    if(_TextureSampler == VK_NULL_HANDLE){
+        // one texel per pixel, float formats are not required to support linear filtering
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.f;
+        result = vkCreateSampler(device, &samplerInfo, nullptr, &_TextureSampler);
+        be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create the ray tracing texture sampler!\n");
+    }
+}
+
+void RaytracingRenderSubSystem::initStagingBuffer(){
+    _StagingSliceSize = static_cast<VkDeviceSize>(_Width) * _Height * _TEXEL_SIZE;
+    createBuffer(
+        _MemoryPool, 
+        _StagingSliceSize * be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT, 
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        _StagingBuffer, 
+        _StagingMemory
     );
+    // host visible blocks of the pool stay mapped
+    _StagingData = _StagingMemory._MappedData;
+}
+
+void RaytracingRenderSubSystem::cleanUpTexture(){
+    VkDevice device = _VulkanApp->getDevice();
+    destroyBuffer(_MemoryPool, _StagingBuffer, _StagingMemory);
+    _StagingData = nullptr;
+    if(_TextureImage != VK_NULL_HANDLE){
+        vkDestroyImageView(device, _TextureImageView, nullptr);
+        vkDestroyImage(device, _TextureImage, nullptr);
+        _MemoryPool->free(_TextureMemory);
+        _TextureImageView = VK_NULL_HANDLE;
+        _TextureImage = VK_NULL_HANDLE;
+    }
+}
 
-    for(int i=0; i < be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT; i++){
-        auto textureBufferInfo = _TextureImage[i].getDescriptorInfo();
-        
-        be::DescriptorWriter(*_TextureSetLayout, *_GlobalPool)
-            .writeImage(0, &textureBufferInfo)
-            .build(_TextureDescriptorSets[i]);
+void RaytracingRenderSubSystem::initDescriptors(){
+    if(_TextureSetLayout == nullptr){
+        _TextureSetLayout = be::DescriptorSetLayoutPtr( 
+            be::DescriptorSetLayout::Builder(_VulkanApp)
+                .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                .build()
+        );
     }
+
+    // a single texture is shared by every frame in flight, uploads are ordered by barriers
+    VkDescriptorImageInfo textureInfo{};
+    textureInfo.sampler = _TextureSampler;
+    textureInfo.imageView = _TextureImageView;
+    textureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    be::DescriptorWriter(*_TextureSetLayout, *_GlobalPool)
+        .writeImage(0, &textureInfo)
+        .build(_TextureDescriptorSet);
 }
\ No newline at end of file
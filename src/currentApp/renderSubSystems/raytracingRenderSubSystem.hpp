@@ -1,34 +1,71 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <BigoudiEngine.hpp>
 
+#include "cpuImage.hpp"
+#include "cpuTileScheduler.hpp"
+#include "vulkanMemory.hpp"
+
 class RaytracingRenderSubSystem;
 using RaytracingRenderSubSystemPtr = std::shared_ptr<RaytracingRenderSubSystem>;
 
 class RaytracingRenderSubSystem : public be::IRenderSubSystem {
     public:
         static const uint32_t _NB_SETS = 1;
+        // linear float colors straight from the cpu framebuffer
+        static const VkFormat _TEXTURE_FORMAT = VK_FORMAT_R32G32B32A32_SFLOAT;
+        static const uint32_t _TEXEL_SIZE = 4*sizeof(float);
 
     protected:
-        std::vector<be::TextureImage> _TextureImage{be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT};
-        std::vector<VkDescriptorSet> _TextureDescriptorSets{be::SwapChain::VULKAN_MAX_FRAMES_IN_FLIGHT};
+        // device texture, created once per resolution
+        VkImage _TextureImage = VK_NULL_HANDLE;
+        DeviceAllocation _TextureMemory{};
+        VkImageView _TextureImageView = VK_NULL_HANDLE;
+        VkSampler _TextureSampler = VK_NULL_HANDLE;
+        VkImageLayout _TextureLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        uint32_t _Width = 0;
+        uint32_t _Height = 0;
+
+        // persistently mapped staging buffer, one full image slice per frame in flight
+        VkBuffer _StagingBuffer = VK_NULL_HANDLE;
+        DeviceAllocation _StagingMemory{};
+        uint8_t* _StagingData = nullptr;
+        VkDeviceSize _StagingSliceSize = 0;
+
+        // regions waiting for the next upload
+        CpuImagePtr _SourceImage = nullptr;
+        std::vector<CpuTile> _DirtyRegions{};
+        bool _IsClearPending = false;
+
+        VkDescriptorSet _TextureDescriptorSet = VK_NULL_HANDLE;
         be::DescriptorSetLayoutPtr _TextureSetLayout = nullptr;
-        
+
         be::DescriptorPoolPtr _GlobalPool = nullptr;
+        DeviceMemoryPoolPtr _MemoryPool = nullptr;
 
         be::FrameInfo _FrameInfo{};
 
         VkRenderPass _RenderPass = nullptr;
+        VkRenderPass _PipelineRenderPass = nullptr;
         bool _IsInit = false;
 
     public:
-        RaytracingRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool);
+        RaytracingRenderSubSystem(be::VulkanAppPtr vulkanApp, VkRenderPass renderPass, be::DescriptorPoolPtr globalPool, DeviceMemoryPoolPtr memoryPool);
         virtual void renderGameObjects(be::FrameInfo& frameInfo) override;
         virtual void cleanUp() override;
 
-        void updateImage(be::ImagePtr image);
+        // (re)create the texture if the resolution changed and clear it
+        // the pipeline is only rebuilt if the render pass changed
+        void resize(uint32_t width, uint32_t height);
+        // the regions of the image are copied at the next recordUploads
+        // the image must keep the same resolution as the texture
+        void updateRegions(CpuImagePtr image, const std::vector<CpuTile>& regions);
+        // copy the dirty regions, must be recorded outside of a render pass
+        void recordUploads(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
         bool isInit() const {return _IsInit;}
 
         void setRenderPass(VkRenderPass renderPass){
@@ -40,8 +77,13 @@ class RaytracingRenderSubSystem : public be::IRenderSubSystem {
         virtual void initPipelineLayout() override;
         virtual void initPipeline(VkRenderPass renderPass) override;
         virtual void cleanUpPipelineLayout() override;
-        virtual void initImage(be::ImagePtr image);
+        virtual void initTexture(uint32_t width, uint32_t height);
+        virtual void initStagingBuffer();
         virtual void initDescriptors();
+        virtual void cleanUpTexture();
 
         virtual void renderingFunction(be::GameObject object) override;
+
+    private:
+        void transitionTexture(VkCommandBuffer commandBuffer, VkImageLayout newLayout);
 };
\ No newline at end of file
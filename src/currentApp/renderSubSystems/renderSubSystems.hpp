@@ -2,4 +2,5 @@
 
 #include "frameRenderSubSystem.hpp" // IWYU pragma: keep
 #include "brdfRenderSubSystem.hpp" // IWYU pragma: keep
-#include "raytracingRenderSubSystem.hpp" // IWYU pragma: keep
\ No newline at end of file
+#include "raytracingRenderSubSystem.hpp" // IWYU pragma: keep
+#include "pipelineCache.hpp" // IWYU pragma: keep
\ No newline at end of file
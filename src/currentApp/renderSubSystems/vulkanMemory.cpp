@@ -0,0 +1,243 @@
+#include "vulkanMemory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+namespace{
+    float toMegabytes(VkDeviceSize size){
+        return static_cast<float>(size) / (1 << 20);
+    }
+}
+
+/*******************************************************************/
+/*************************** MEMORY POOL ***************************/
+/*******************************************************************/
+DeviceMemoryPool::DeviceMemoryPool(be::VulkanAppPtr vulkanApp, VkDeviceSize blockSize)
+    : _VulkanApp(vulkanApp), _BlockSize(blockSize){
+    vkGetPhysicalDeviceMemoryProperties(_VulkanApp->getPhysicalDevice(), &_MemoryProperties);
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(_VulkanApp->getPhysicalDevice(), &properties);
+    _MaxNbAllocations = properties.limits.maxMemoryAllocationCount;
+}
+
+DeviceAllocation DeviceMemoryPool::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool isImage){
+    uint32_t memoryType = findMemoryType(_VulkanApp, requirements.memoryTypeBits, properties);
+    DeviceAllocation allocation{};
+    if(requirements.size > _BlockSize / 2){
+        allocateInBlock(createBlock(memoryType, requirements.size, isImage, true), requirements, allocation);
+        return allocation;
+    }
+    for(uint32_t i=0; i<_Blocks.size(); i++){
+        const Block& block = _Blocks[i];
+        if(block._Memory == VK_NULL_HANDLE || block._IsDedicated 
+            || block._MemoryType != memoryType || block._IsImage != isImage){
+            continue;
+        }
+        if(allocateInBlock(i, requirements, allocation)) return allocation;
+    }
+    allocateInBlock(createBlock(memoryType, _BlockSize, isImage, false), requirements, allocation);
+    return allocation;
+}
+
+bool DeviceMemoryPool::allocateInBlock(uint32_t blockIndex, const VkMemoryRequirements& requirements, DeviceAllocation& allocation){
+    Block& block = _Blocks[blockIndex];
+    VkDeviceSize alignment = std::max(requirements.alignment, VkDeviceSize(1));
+
+    // smallest free range that still fits once its start is aligned
+    auto best = block._FreeRanges.end();
+    VkDeviceSize bestOffset = 0;
+    for(auto range = block._FreeRanges.begin(); range != block._FreeRanges.end(); range++){
+        VkDeviceSize offset = (range->first + alignment - 1) / alignment * alignment;
+        if(offset + requirements.size > range->first + range->second) continue;
+        if(best == block._FreeRanges.end() || range->second < best->second){
+            best = range;
+            bestOffset = offset;
+        }
+    }
+    if(best == block._FreeRanges.end()) return false;
+
+    // the padding before the range and the rest after it stay free
+    VkDeviceSize rangeStart = best->first;
+    VkDeviceSize rangeEnd = best->first + best->second;
+    VkDeviceSize end = bestOffset + requirements.size;
+    block._FreeRanges.erase(best);
+    if(bestOffset > rangeStart) block._FreeRanges[rangeStart] = bestOffset - rangeStart;
+    if(end < rangeEnd) block._FreeRanges[end] = rangeEnd - end;
+    block._UsedSize += requirements.size;
+    block._NbAllocations++;
+
+    allocation._Memory = block._Memory;
+    allocation._Offset = bestOffset;
+    allocation._Size = requirements.size;
+    allocation._MappedData = block._MappedData == nullptr ? nullptr : block._MappedData + bestOffset;
+    allocation._Block = blockIndex;
+    return true;
+}
+
+void DeviceMemoryPool::free(DeviceAllocation& allocation){
+    if(allocation._Memory == VK_NULL_HANDLE) return;
+    Block& block = _Blocks[allocation._Block];
+    VkDeviceSize offset = allocation._Offset;
+    VkDeviceSize size = allocation._Size;
+
+    // merge with the free ranges right after and right before
+    auto next = block._FreeRanges.lower_bound(offset);
+    if(next != block._FreeRanges.end() && offset + size == next->first){
+        size += next->second;
+        next = block._FreeRanges.erase(next);
+    }
+    auto previous = next == block._FreeRanges.begin() ? block._FreeRanges.end() : std::prev(next);
+    if(previous != block._FreeRanges.end() && previous->first + previous->second == offset){
+        previous->second += size;
+    } else {
+        block._FreeRanges[offset] = size;
+    }
+    block._UsedSize -= allocation._Size;
+    block._NbAllocations--;
+    allocation = DeviceAllocation{};
+
+    if(block._NbAllocations > 0) return;
+    // an empty block is kept for the next resources unless another one of the same kind is empty too
+    bool isSpare = !block._IsDedicated;
+    for(const auto& other : _Blocks){
+        if(&other != &block && other._Memory != VK_NULL_HANDLE && other._NbAllocations == 0 && !other._IsDedicated
+            && other._MemoryType == block._MemoryType && other._IsImage == block._IsImage){
+            isSpare = false;
+        }
+    }
+    if(!isSpare) releaseBlock(block);
+}
+
+uint32_t DeviceMemoryPool::createBlock(uint32_t memoryType, VkDeviceSize size, bool isImage, bool isDedicated){
+    uint32_t index = 0;
+    while(index < _Blocks.size() && _Blocks[index]._Memory != VK_NULL_HANDLE) index++;
+    if(index == _Blocks.size()) _Blocks.emplace_back();
+    Block& block = _Blocks[index];
+
+    VkDevice device = _VulkanApp->getDevice();
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+    VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &block._Memory);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to allocate a block of device memory!\n");
+    if(_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+        void* data = nullptr;
+        result = vkMapMemory(device, block._Memory, 0, VK_WHOLE_SIZE, 0, &data);
+        be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to map a block of device memory!\n");
+        block._MappedData = static_cast<uint8_t*>(data);
+    }
+    block._Size = size;
+    block._MemoryType = memoryType;
+    block._IsImage = isImage;
+    block._IsDedicated = isDedicated;
+    block._FreeRanges[0] = size;
+    return index;
+}
+
+void DeviceMemoryPool::releaseBlock(Block& block){
+    VkDevice device = _VulkanApp->getDevice();
+    if(block._MappedData != nullptr){
+        vkUnmapMemory(device, block._Memory);
+    }
+    vkFreeMemory(device, block._Memory, nullptr);
+    block = Block{};
+}
+
+void DeviceMemoryPool::printStats() const {
+    uint32_t nbBlocks = 0;
+    uint32_t nbAllocations = 0;
+    VkDeviceSize usedSize = 0;
+    VkDeviceSize totalSize = 0;
+    for(const auto& block : _Blocks){
+        if(block._Memory == VK_NULL_HANDLE) continue;
+        nbBlocks++;
+        nbAllocations += block._NbAllocations;
+        usedSize += block._UsedSize;
+        totalSize += block._Size;
+    }
+    fprintf(stdout, "Device memory: %u resources in %u blocks out of %u allocations allowed, %.2fMB used out of %.2fMB\n",
+        nbAllocations, nbBlocks, _MaxNbAllocations, toMegabytes(usedSize), toMegabytes(totalSize)
+    );
+    for(uint32_t i=0; i<_Blocks.size(); i++){
+        const Block& block = _Blocks[i];
+        if(block._Memory == VK_NULL_HANDLE) continue;
+        VkDeviceSize freeSize = block._Size - block._UsedSize;
+        VkDeviceSize largestFreeRange = 0;
+        for(const auto& range : block._FreeRanges){
+            largestFreeRange = std::max(largestFreeRange, range.second);
+        }
+        // share of the free space that is not part of the largest free range
+        float fragmentation = freeSize == 0 ? 0.f : 1.f - static_cast<float>(largestFreeRange) / freeSize;
+        fprintf(stdout, "  block %u: type %u, %s%s, %.2fMB used out of %.2fMB by %u resources, %zu free ranges, largest %.2fMB, fragmentation %.1f%%\n",
+            i, block._MemoryType,
+            block._IsImage ? "images" : "buffers",
+            block._IsDedicated ? " (dedicated)" : "",
+            toMegabytes(block._UsedSize), toMegabytes(block._Size), block._NbAllocations,
+            block._FreeRanges.size(), toMegabytes(largestFreeRange), fragmentation * 100.f
+        );
+    }
+}
+
+void DeviceMemoryPool::cleanUp(){
+    for(auto& block : _Blocks){
+        if(block._Memory == VK_NULL_HANDLE) continue;
+        if(block._NbAllocations > 0){
+            fprintf(stderr, "%u resources still use a block of device memory being released!\n", block._NbAllocations);
+        }
+        releaseBlock(block);
+    }
+    _Blocks.clear();
+}
+
+
+/*******************************************************************/
+/***************************** BUFFERS *****************************/
+/*******************************************************************/
+uint32_t findMemoryType(be::VulkanAppPtr vulkanApp, uint32_t typeFilter, VkMemoryPropertyFlags properties){
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    vkGetPhysicalDeviceMemoryProperties(vulkanApp->getPhysicalDevice(), &memoryProperties);
+    for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++){
+        if((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties){
+            return i;
+        }
+    }
+    be::ErrorHandler::handle(__FILE__, __LINE__, 
+        be::ErrorCode::VULKAN_ERROR, 
+        "Failed to find a suitable memory type!\n"
+    );
+    return 0;
+}
+
+void createBuffer(
+    DeviceMemoryPoolPtr memoryPool, 
+    VkDeviceSize size, 
+    VkBufferUsageFlags usage, 
+    VkMemoryPropertyFlags properties, 
+    VkBuffer& buffer, 
+    DeviceAllocation& allocation){
+    VkDevice device = memoryPool->getVulkanApp()->getDevice();
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult result = vkCreateBuffer(device, &bufferInfo, nullptr, &buffer);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to create a buffer!\n");
+
+    VkMemoryRequirements memoryRequirements{};
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+    allocation = memoryPool->allocate(memoryRequirements, properties, false);
+    result = vkBindBufferMemory(device, buffer, allocation._Memory, allocation._Offset);
+    be::ErrorHandler::vulkanError(__FILE__, __LINE__, result, "Failed to bind the memory of a buffer!\n");
+}
+
+void destroyBuffer(DeviceMemoryPoolPtr memoryPool, VkBuffer& buffer, DeviceAllocation& allocation){
+    if(buffer != VK_NULL_HANDLE){
+        vkDestroyBuffer(memoryPool->getVulkanApp()->getDevice(), buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+    }
+    memoryPool->free(allocation);
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <BigoudiEngine.hpp>
+
+// raw vulkan buffers for the data the engine has no container for
+
+class DeviceMemoryPool;
+using DeviceMemoryPoolPtr = std::shared_ptr<DeviceMemoryPool>;
+
+// range of a block of the pool
+struct DeviceAllocation{
+    VkDeviceMemory _Memory = VK_NULL_HANDLE;
+    VkDeviceSize _Offset = 0;
+    VkDeviceSize _Size = 0;
+    // start of the range if the memory is host visible, null otherwise
+    uint8_t* _MappedData = nullptr;
+    uint32_t _Block = 0;
+};
+
+// a few large allocations per memory type, every resource is bound to a range of one of them
+// the free ranges of a block are sorted by offset and merged with their neighbours when released
+class DeviceMemoryPool{
+    public:
+        static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull << 20;
+
+    private:
+        struct Block{
+            VkDeviceMemory _Memory = VK_NULL_HANDLE;
+            VkDeviceSize _Size = 0;
+            uint32_t _MemoryType = 0;
+            // buffers and images never share a block so bufferImageGranularity can be ignored
+            bool _IsImage = false;
+            // created for a single resource larger than half a block, released with it
+            bool _IsDedicated = false;
+            // host visible blocks are mapped for their whole lifetime and expected to be coherent
+            uint8_t* _MappedData = nullptr;
+            // offset to size
+            std::map<VkDeviceSize, VkDeviceSize> _FreeRanges{};
+            VkDeviceSize _UsedSize = 0;
+            uint32_t _NbAllocations = 0;
+        };
+
+        be::VulkanAppPtr _VulkanApp = nullptr;
+        VkDeviceSize _BlockSize = DEFAULT_BLOCK_SIZE;
+        // released blocks keep their slot with a null memory
+        std::vector<Block> _Blocks{};
+        VkPhysicalDeviceMemoryProperties _MemoryProperties{};
+        uint32_t _MaxNbAllocations = 0;
+
+    public:
+        DeviceMemoryPool(be::VulkanAppPtr vulkanApp, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+
+        be::VulkanAppPtr getVulkanApp() const {return _VulkanApp;}
+
+        // best fit among the blocks of the memory type, a new block is allocated if none has room
+        DeviceAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool isImage);
+        // the allocation is reset
+        void free(DeviceAllocation& allocation);
+
+        // usage of every block and how fragmented its free space is
+        void printStats() const;
+        void cleanUp();
+
+    private:
+        uint32_t createBlock(uint32_t memoryType, VkDeviceSize size, bool isImage, bool isDedicated);
+        void releaseBlock(Block& block);
+        // return false if no free range of the block is large enough
+        bool allocateInBlock(uint32_t blockIndex, const VkMemoryRequirements& requirements, DeviceAllocation& allocation);
+};
+
+// index of a memory type accepted by typeFilter and having every property
+uint32_t findMemoryType(be::VulkanAppPtr vulkanApp, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// buffer bound to a range of the pool, the range is mapped if the memory is host visible
+void createBuffer(
+    DeviceMemoryPoolPtr memoryPool, 
+    VkDeviceSize size, 
+    VkBufferUsageFlags usage, 
+    VkMemoryPropertyFlags properties, 
+    VkBuffer& buffer, 
+    DeviceAllocation& allocation
+);
+
+// buffer and allocation are reset
+void destroyBuffer(DeviceMemoryPoolPtr memoryPool, VkBuffer& buffer, DeviceAllocation& allocation);
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include "sceneDescription.hpp"
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+const std::array<std::string, MaterialDescription::NB_PARAMETERS> MaterialDescription::PARAMETER_NAMES = {
+    "metallic",
+    "subsurface",
+    "specular",
+    "roughness",
+    "specular-tint",
+    "anisotropic",
+    "sheen",
+    "sheen-tint",
+    "clearcoat",
+    "clearcoat-gloss",
+};
+
+uint32_t SceneDescription::getNbPointLights() const {
+    uint32_t nbLights = static_cast<uint32_t>(_PointLights.size());
+    for(const auto& cube : _LightCubes){
+        nbLights += cube.getNbLights();
+    }
+    return nbLights;
+}
+
+std::string SceneDescription::resolvePath(const std::string& nameOrPath){
+    if(nameOrPath.find('/') != std::string::npos || nameOrPath.find('.') != std::string::npos){
+        return nameOrPath;
+    }
+    return "resources/scenes/" + nameOrPath + ".scene";
+}
+
+
+
+/********************************************************************/
+/****************************** PARSING *****************************/
+/********************************************************************/
+namespace{
+
+// tokens of a single line of the scene file
+class LineParser{
+
+    private:
+        std::vector<std::string> _Tokens{};
+        size_t _Cursor = 0;
+        const std::string& _Path;
+        uint32_t _LineNumber = 0;
+
+    public:
+        LineParser(const std::string& line, const std::string& path, uint32_t lineNumber)
+            : _Path(path), _LineNumber(lineNumber){
+            std::istringstream stream(line.substr(0, line.find('#')));
+            std::string token;
+            while(stream >> token){
+                _Tokens.push_back(token);
+            }
+        }
+
+        bool isEmpty() const {return _Tokens.empty();}
+        bool hasNext() const {return _Cursor < _Tokens.size();}
+        const std::string& next(){return _Tokens[_Cursor++];}
+
+        bool error(const std::string& msg) const {
+            fprintf(stderr, "%s:%u: %s\n", _Path.c_str(), _LineNumber, msg.c_str());
+            return false;
+        }
+
+        bool isNumber() const {
+            if(!hasNext()) return false;
+            const std::string& token = _Tokens[_Cursor];
+            char* end = nullptr;
+            std::strtof(token.c_str(), &end);
+            return end != token.c_str() && *end == '\0';
+        }
+
+        bool readFloat(const std::string& key, float& value){
+            if(!isNumber()) return error("Expected a number after " + key);
+            value = std::strtof(next().c_str(), nullptr);
+            return true;
+        }
+
+        // whole number fitting in 32 bits, at least minValue
+        bool readUint(const std::string& key, uint32_t& value, uint32_t minValue = 0){
+            if(!hasNext()) return error("Expected a whole number after " + key);
+            const std::string& token = _Tokens[_Cursor];
+            char* end = nullptr;
+            unsigned long long parsed = std::strtoull(token.c_str(), &end, 10);
+            if(!std::isdigit(static_cast<unsigned char>(token[0])) || *end != '\0'){
+                return error("Expected a whole number after " + key);
+            }
+            if(parsed > UINT32_MAX) return error("Value too large for " + key);
+            if(parsed < minValue) return error(key + " must be at least " + std::to_string(minValue));
+            value = static_cast<uint32_t>(parsed);
+            _Cursor++;
+            return true;
+        }
+
+        // either one value used for the three components or three values
+        bool readVec3(const std::string& key, Vec3& value){
+            float values[3];
+            uint32_t nbValues = 0;
+            while(nbValues < 3 && isNumber()){
+                values[nbValues++] = std::strtof(next().c_str(), nullptr);
+            }
+            if(nbValues == 1){
+                value = Vec3(values[0]);
+                return true;
+            }
+            if(nbValues == 3){
+                value = Vec3(values[0], values[1], values[2]);
+                return true;
+            }
+            return error("Expected one or three numbers after " + key);
+        }
+
+        bool readAngles(const std::string& key, Vec3& value){
+            Vec3 degrees{};
+            if(!readVec3(key, degrees)) return false;
+            value = {radians(degrees.x), radians(degrees.y), radians(degrees.z)};
+            return true;
+        }
+};
+
+bool parseCamera(LineParser& parser, CameraDescription& camera){
+    while(parser.hasNext()){
+        std::string key = parser.next();
+        bool isValid = false;
+        if(key == "eye") isValid = parser.readVec3(key, camera._Eye);
+        else if(key == "at") isValid = parser.readVec3(key, camera._At);
+        else if(key == "up") isValid = parser.readVec3(key, camera._Up);
+        else if(key == "fov") isValid = parser.readFloat(key, camera._Fov);
+        else return parser.error("Unknown camera parameter " + key);
+        if(!isValid) return false;
+    }
+    if(length2(camera._At - camera._Eye) == 0.f) return parser.error("The camera must look at a point other than its eye");
+    if(length2(camera._Up) == 0.f) return parser.error("The camera up vector must not be null");
+    if(camera._Fov <= 0.f || camera._Fov >= 180.f) return parser.error("The camera fov must be between 0 and 180 degrees");
+    return true;
+}
+
+bool parseRayTracer(LineParser& parser, RayTracerDescription& rayTracer){
+    while(parser.hasNext()){
+        std::string key = parser.next();
+        bool isValid = false;
+        if(key == "spp") isValid = parser.readUint(key, rayTracer._SamplesPerPixels, 1);
+        else if(key == "bounces") isValid = parser.readUint(key, rayTracer._MaxBounces);
+        else if(key == "bounce-samples") isValid = parser.readUint(key, rayTracer._SamplesPerBounces, 1);
+        else if(key == "shading-factor") isValid = parser.readFloat(key, rayTracer._ShadingFactor);
+        else if(key == "error") isValid = parser.readFloat(key, rayTracer._LightcutsErrorThreshold);
+        else if(key == "max-cut") isValid = parser.readUint(key, rayTracer._LightcutsMaxClusters, 1);
+        else if(key == "lightcuts"){
+            uint32_t useLightcuts = 0;
+            isValid = parser.readUint(key, useLightcuts);
+            rayTracer._UseLightCuts = (useLightcuts != 0);
+        }
+        else return parser.error("Unknown raytracer parameter " + key);
+        if(!isValid) return false;
+    }
+    return true;
+}
+
+bool parseMesh(LineParser& parser, MeshDescription& mesh){
+    if(!parser.hasNext()) return parser.error("Expected rectangle, sphere or model after mesh");
+    std::string type = parser.next();
+    if(type == "rectangle") mesh._Type = MESH_RECTANGLE;
+    else if(type == "sphere") mesh._Type = MESH_SPHERE;
+    else if(type == "model"){
+        if(!parser.hasNext()) return parser.error("Expected a path after model");
+        mesh._Type = MESH_MODEL;
+        mesh._Path = parser.next();
+    }
+    else return parser.error("Unknown mesh type " + type);
+
+    while(parser.hasNext()){
+        std::string key = parser.next();
+        bool isValid = false;
+        if(key == "width") isValid = parser.readFloat(key, mesh._Width);
+        else if(key == "height") isValid = parser.readFloat(key, mesh._Height);
+        else if(key == "segments") isValid = parser.readUint(key, mesh._NbSegments, 3);
+        else if(key == "position") isValid = parser.readVec3(key, mesh._Transform._Position);
+        else if(key == "rotation") isValid = parser.readAngles(key, mesh._Transform._Rotation);
+        else if(key == "scale") isValid = parser.readVec3(key, mesh._Transform._Scale);
+        else if(key == "color") isValid = parser.readVec3(key, mesh._Color);
+        else if(key == "material"){
+            // default material
+            mesh._Material._IsDefined = true;
+            isValid = true;
+        }
+        else {
+            uint32_t id = 0;
+            while(id < MaterialDescription::NB_PARAMETERS && MaterialDescription::PARAMETER_NAMES[id] != key){
+                id++;
+            }
+            if(id == MaterialDescription::NB_PARAMETERS){
+                return parser.error("Unknown mesh parameter " + key);
+            }
+            mesh._Material._IsDefined = true;
+            mesh._Material._IsSet[id] = true;
+            isValid = parser.readFloat(key, mesh._Material._Parameters[id]);
+        }
+        if(!isValid) return false;
+    }
+    return true;
+}
+
+bool parsePointLight(LineParser& parser, PointLightDescription& light){
+    while(parser.hasNext()){
+        std::string key = parser.next();
+        bool isValid = false;
+        if(key == "position") isValid = parser.readVec3(key, light._Position);
+        else if(key == "color") isValid = parser.readVec3(key, light._Color);
+        else if(key == "intensity") isValid = parser.readFloat(key, light._Intensity);
+        else return parser.error("Unknown point light parameter " + key);
+        if(!isValid) return false;
+    }
+    return true;
+}
+
+bool parseDirectionalLight(LineParser& parser, DirectionalLightDescription& light){
+    while(parser.hasNext()){
+        std::string key = parser.next();
+        bool isValid = false;
+        if(key == "direction") isValid = parser.readVec3(key, light._Direction);
+        else if(key == "color") isValid = parser.readVec3(key, light._Color);
+        else if(key == "intensity") isValid = parser.readFloat(key, light._Intensity);
+        else return parser.error("Unknown directional light parameter " + key);
+        if(!isValid) return false;
+    }
+    if(length2(light._Direction) == 0.f) return parser.error("The direction of a directional light must not be null");
+    light._Direction = normalize(light._Direction);
+    return true;
+}
+
+bool parseLightCube(LineParser& parser, LightCubeDescription& cube){
+    while(parser.hasNext()){
+        std::string key = parser.next();
+        bool isValid = false;
+        if(key == "center") isValid = parser.readVec3(key, cube._Center);
+        else if(key == "scale") isValid = parser.readVec3(key, cube._Scale);
+        else if(key == "color") isValid = parser.readVec3(key, cube._Color);
+        else if(key == "intensity") isValid = parser.readFloat(key, cube._Intensity);
+        else if(key == "rotation") isValid = parser.readAngles(key, cube._Rotation);
+        else if(key == "steps") isValid = parser.readVec3(key, cube._Steps);
+        else return parser.error("Unknown light cube parameter " + key);
+        if(!isValid) return false;
+    }
+    if(cube._Steps.x <= 0.f || cube._Steps.y <= 0.f || cube._Steps.z <= 0.f){
+        return parser.error("Light cube steps must be positive");
+    }
+    return true;
+}
+
+// circle of point lights, expanded right away since random colors
+// must be drawn in file order to be the same for every renderer
+bool parseLightCircle(LineParser& parser, std::vector<PointLightDescription>& lights){
+    Vec3 center{0.f};
+    float radius = 1.f;
+    uint32_t nbLights = 1;
+    Vec3 color{1.f};
+    bool isRandomColor = false;
+    float intensity = 1.f;
+    while(parser.hasNext()){
+        std::string key = parser.next();
+        bool isValid = false;
+        if(key == "center") isValid = parser.readVec3(key, center);
+        else if(key == "radius") isValid = parser.readFloat(key, radius);
+        else if(key == "count") isValid = parser.readUint(key, nbLights, 1);
+        else if(key == "intensity") isValid = parser.readFloat(key, intensity);
+        else if(key == "color"){
+            if(parser.hasNext() && !parser.isNumber()){
+                isRandomColor = (parser.next() == "random");
+                isValid = isRandomColor || parser.error("Expected a color or random after color");
+            } else {
+                isValid = parser.readVec3(key, color);
+            }
+        }
+        else return parser.error("Unknown light circle parameter " + key);
+        if(!isValid) return false;
+    }
+
+    float step = radians(360.f / nbLights);
+    for(uint32_t i=0; i<nbLights; i++){
+        float angle = step * i;
+        Vec3 lightColor = color;
+        if(isRandomColor){
+            // same generator as be::Vector3::random
+            lightColor = {
+                static_cast<float>(rand()) / RAND_MAX,
+                static_cast<float>(rand()) / RAND_MAX,
+                static_cast<float>(rand()) / RAND_MAX,
+            };
+        }
+        lights.push_back({
+            ._Position = center + Vec3(radius*std::cos(angle), 0.f, radius*std::sin(angle)),
+            ._Color = lightColor,
+            ._Intensity = intensity
+        });
+    }
+    return true;
+}
+
+}
+
+bool SceneDescription::load(const std::string& path, SceneDescription& scene){
+    std::ifstream file(path);
+    if(!file.is_open()){
+        fprintf(stderr, "Failed to open the scene %s!\n", path.c_str());
+        return false;
+    }
+
+    scene = SceneDescription{};
+    scene._Path = path;
+    std::string line;
+    uint32_t lineNumber = 0;
+    while(std::getline(file, line)){
+        lineNumber++;
+        LineParser parser(line, path, lineNumber);
+        if(parser.isEmpty()) continue;
+
+        std::string directive = parser.next();
+        bool isValid = false;
+        if(directive == "camera"){
+            isValid = parseCamera(parser, scene._Camera);
+        } else if(directive == "raytracer"){
+            isValid = parseRayTracer(parser, scene._RayTracer);
+        } else if(directive == "mesh"){
+            scene._Meshes.push_back({});
+            isValid = parseMesh(parser, scene._Meshes.back());
+        } else if(directive == "pointlight"){
+            scene._PointLights.push_back({});
+            isValid = parsePointLight(parser, scene._PointLights.back());
+        } else if(directive == "directionallight"){
+            scene._DirectionalLights.push_back({});
+            isValid = parseDirectionalLight(parser, scene._DirectionalLights.back());
+        } else if(directive == "lightcube"){
+            scene._LightCubes.push_back({});
+            isValid = parseLightCube(parser, scene._LightCubes.back());
+        } else if(directive == "lightcircle"){
+            isValid = parseLightCircle(parser, scene._PointLights);
+        } else {
+            isValid = parser.error("Unknown directive " + directive);
+        }
+        if(!isValid) return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cpuMath.hpp"
+
+enum MeshType{
+    MESH_RECTANGLE,
+    MESH_SPHERE,
+    MESH_MODEL,
+};
+
+// same parameters and order as be::Material, unset parameters keep the be::Material defaults
+struct MaterialDescription{
+    static const uint32_t NB_PARAMETERS = 10;
+    static const std::array<std::string, NB_PARAMETERS> PARAMETER_NAMES;
+    // parameters read by the cpu ray tracer
+    static const uint32_t METALLIC = 0;
+    static const uint32_t SPECULAR = 2;
+    static const uint32_t ROUGHNESS = 3;
+
+    bool _IsDefined = false;
+    std::array<float, NB_PARAMETERS> _Parameters{};
+    std::array<bool, NB_PARAMETERS> _IsSet{};
+};
+
+struct MeshDescription{
+    MeshType _Type = MESH_RECTANGLE;
+    std::string _Path = "";
+    float _Width = 1.f;
+    float _Height = 1.f;
+    uint32_t _NbSegments = 16;
+
+    // rotation is stored in radians
+    CpuTransform _Transform{};
+    Vec3 _Color{1.f};
+    MaterialDescription _Material{};
+};
+
+struct PointLightDescription{
+    Vec3 _Position{};
+    Vec3 _Color{1.f};
+    float _Intensity = 1.f;
+};
+
+struct DirectionalLightDescription{
+    Vec3 _Direction{0.f, -1.f, 0.f};
+    Vec3 _Color{1.f};
+    float _Intensity = 1.f;
+};
+
+// grid of point lights on the faces of a cube, see be::Scene::addCubeOfLight
+struct LightCubeDescription{
+    Vec3 _Center{};
+    Vec3 _Scale{1.f};
+    Vec3 _Color{1.f};
+    float _Intensity = 1.f;
+    // rotation is stored in radians
+    Vec3 _Rotation{0.f};
+    Vec3 _Steps{0.5f};
+
+    uint32_t getNbSteps(uint32_t axis) const {
+        return static_cast<uint32_t>(std::max(1.f, std::round(_Scale[axis] / _Steps[axis])));
+    }
+    uint32_t getNbLights() const {
+        uint32_t nx = getNbSteps(0), ny = getNbSteps(1), nz = getNbSteps(2);
+        uint32_t nbPoints = (nx+1) * (ny+1) * (nz+1);
+        uint32_t nbInnerPoints = (nx-1) * (ny-1) * (nz-1);
+        return nbPoints - nbInnerPoints;
+    }
+};
+
+struct CameraDescription{
+    Vec3 _Eye{0.f, 0.f, 20.f};
+    Vec3 _At{0.f, 0.f, 0.f};
+    Vec3 _Up{0.f, 1.f, 0.f};
+    float _Fov = 45.f;
+};
+
+struct RayTracerDescription{
+    uint32_t _SamplesPerPixels = 1;
+    uint32_t _MaxBounces = 0;
+    uint32_t _SamplesPerBounces = 1;
+    float _ShadingFactor = 1.f;
+    bool _UseLightCuts = false;
+    float _LightcutsErrorThreshold = 0.02f;
+    uint32_t _LightcutsMaxClusters = 100;
+};
+
+// content of a .scene file, shared by the rasterizer and the cpu ray tracer
+struct SceneDescription{
+    std::string _Path = "";
+    std::vector<MeshDescription> _Meshes{};
+    std::vector<PointLightDescription> _PointLights{};
+    std::vector<DirectionalLightDescription> _DirectionalLights{};
+    std::vector<LightCubeDescription> _LightCubes{};
+    CameraDescription _Camera{};
+    RayTracerDescription _RayTracer{};
+
+    // point lights once every light grid is expanded
+    uint32_t getNbPointLights() const;
+
+    // return false and print the faulty line if the file is invalid
+    static bool load(const std::string& path, SceneDescription& scene);
+    // resolve a scene name like "spheres" to resources/scenes/spheres.scene
+    static std::string resolvePath(const std::string& nameOrPath);
+};
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "startupTimeline.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+StartupTimeline::StartupTimeline(){
+    _Origin = std::chrono::high_resolution_clock::now();
+}
+
+void StartupTimeline::run(const std::string& name, const std::string& thread, const std::function<void()>& stage, const std::vector<std::string>& dependencies){
+    auto start = std::chrono::high_resolution_clock::now();
+    stage();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::lock_guard<std::mutex> lock(_Mutex);
+    _Stages.push_back({
+        ._Name = name,
+        ._Thread = thread,
+        ._Start = std::chrono::duration<float, std::chrono::seconds::period>(start - _Origin).count(),
+        ._End = std::chrono::duration<float, std::chrono::seconds::period>(end - _Origin).count(),
+        ._Dependencies = dependencies
+    });
+}
+
+void StartupTimeline::print(){
+    std::lock_guard<std::mutex> lock(_Mutex);
+    if(_Stages.empty()) return;
+    std::vector<Stage> stages = _Stages;
+    std::stable_sort(stages.begin(), stages.end(), [](const Stage& a, const Stage& b){
+        return a._Start < b._Start;
+    });
+
+    std::vector<bool> isCritical(stages.size(), false);
+    size_t current = 0;
+    for(size_t i=1; i<stages.size(); i++){
+        if(stages[i]._End > stages[current]._End) current = i;
+    }
+    while(true){
+        isCritical[current] = true;
+        // the previous stage of the thread or one of the dependencies
+        size_t next = stages.size();
+        for(size_t i=0; i<stages.size(); i++){
+            if(i == current || stages[i]._End > stages[current]._Start) continue;
+            const auto& dependencies = stages[current]._Dependencies;
+            bool isPredecessor = stages[i]._Thread == stages[current]._Thread
+                || std::find(dependencies.begin(), dependencies.end(), stages[i]._Name) != dependencies.end();
+            if(isPredecessor && (next == stages.size() || stages[i]._End > stages[next]._End)){
+                next = i;
+            }
+        }
+        if(next == stages.size()) break;
+        current = next;
+    }
+
+    float total = 0.f;
+    for(const auto& stage : stages){
+        total = std::max(total, stage._End);
+    }
+    fprintf(stdout, "Startup in %fs, * marks the critical path:\n", total);
+    for(size_t i=0; i<stages.size(); i++){
+        fprintf(stdout, "  %c %8.1fms -> %8.1fms  %-8s %s\n",
+            isCritical[i] ? '*' : ' ',
+            stages[i]._Start * 1e3f,
+            stages[i]._End * 1e3f,
+            stages[i]._Thread.c_str(),
+            stages[i]._Name.c_str()
+        );
+    }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// stages of the startup and the thread that ran them
+// a stage waits for the previous stage of its thread and for its dependencies
+class StartupTimeline{
+
+    private:
+        struct Stage{
+            std::string _Name = "";
+            std::string _Thread = "";
+            // seconds since the creation of the timeline
+            float _Start = 0.f;
+            float _End = 0.f;
+            std::vector<std::string> _Dependencies{};
+        };
+
+        std::chrono::high_resolution_clock::time_point _Origin{};
+        std::vector<Stage> _Stages{};
+        std::mutex _Mutex{};
+
+    public:
+        StartupTimeline();
+
+        // run the stage on the calling thread, stages can be run from several threads at once
+        void run(const std::string& name, const std::string& thread, const std::function<void()>& stage, const std::vector<std::string>& dependencies = {});
+        // the critical path goes back from the last stage through the predecessor that finished last
+        void print();
+};
\ No newline at end of file